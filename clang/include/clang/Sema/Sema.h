@@ -649,6 +649,13 @@ public:
   /// optimizations are currently "on", this is set to an invalid location.
   SourceLocation OptimizeOffPragmaLocation;
 
+  /// This represents the last location of a "#pragma clang randezvous"
+  /// directive that lists options, and the options it lists, if such a
+  /// directive has not been closed by a "default" yet. Otherwise the location
+  /// is invalid.
+  SourceLocation RandezvousPragmaLocation;
+  SmallVector<RandezvousAttr::RandezvousOption, 4> RandezvousPragmaOptions;
+
   /// Flag indicating if Sema is building a recovery call expression.
   ///
   /// This flag is used to avoid building recovery call expressions
@@ -9789,6 +9796,16 @@ public:
   /// attribute to be added (usually because of a pragma).
   void AddOptnoneAttributeIfNoConflicts(FunctionDecl *FD, SourceLocation Loc);
 
+  /// Called on well formed \#pragma clang randezvous. An empty list of
+  /// options stands for "default".
+  void ActOnPragmaRandezvous(ArrayRef<RandezvousAttr::RandezvousOption> Options,
+                             SourceLocation PragmaLoc);
+
+  /// Only called on function definitions; if there is a
+  /// "\#pragma clang randezvous" in scope, consider marking the function with
+  /// attribute randezvous.
+  void AddRangeBasedRandezvous(FunctionDecl *FD);
+
   /// AddAlignedAttr - Adds an aligned attribute to a particular declaration.
   void AddAlignedAttr(Decl *D, const AttributeCommonInfo &CI, Expr *E,
                       bool IsPackExpansion);
@@ -695,6 +695,9 @@ public:
 
       /// Record code for \#pragma float_control options.
       FLOAT_CONTROL_PRAGMA_OPTIONS = 65,
+
+      /// Record code for \#pragma clang randezvous options.
+      RANDEZVOUS_PRAGMA_OPTIONS = 66,
     };
 
     /// Record types used within a source manager block.
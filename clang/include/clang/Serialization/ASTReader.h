@@ -850,6 +850,10 @@ private:
   /// The pragma clang optimize location (if the pragma state is "off").
   SourceLocation OptimizeOffPragmaLocation;
 
+  /// The pragma clang randezvous location and options (if any are in effect).
+  SourceLocation RandezvousPragmaLocation;
+  SmallVector<uint64_t, 4> RandezvousPragmaOptions;
+
   /// The PragmaMSStructKind pragma ms_struct state if set, or -1.
   int PragmaMSStructState = -1;
 
@@ -6221,6 +6221,21 @@ public:
     if (!FD)
       return;
 
+    llvm::Function *Fn = cast<llvm::Function>(GV);
+
+    // Lower Randezvous options to a comma-separated list for the backend.
+    llvm::SmallString<64> RandezvousOptions;
+    for (const auto *RA : FD->specific_attrs<RandezvousAttr>()) {
+      for (RandezvousAttr::RandezvousOption Option : RA->options()) {
+        if (!RandezvousOptions.empty())
+          RandezvousOptions += ',';
+        RandezvousOptions +=
+            RandezvousAttr::ConvertRandezvousOptionToStr(Option);
+      }
+    }
+    if (!RandezvousOptions.empty())
+      Fn->addFnAttr("randezvous", RandezvousOptions);
+
     const ARMInterruptAttr *Attr = FD->getAttr<ARMInterruptAttr>();
     if (!Attr)
       return;
@@ -6235,8 +6250,6 @@ public:
     case ARMInterruptAttr::UNDEF:   Kind = "UNDEF"; break;
     }
 
-    llvm::Function *Fn = cast<llvm::Function>(GV);
-
     Fn->addFnAttr("interrupt", Kind);
 
     ARMABIInfo::ABIKind ABI = cast<ARMABIInfo>(getABIInfo()).getABIKind();
@@ -221,6 +221,17 @@ private:
   Sema &Actions;
 };
 
+/// PragmaRandezvousHandler - "\#pragma clang randezvous (...)/default".
+struct PragmaRandezvousHandler : public PragmaHandler {
+  PragmaRandezvousHandler(Sema &S)
+    : PragmaHandler("randezvous"), Actions(S) {}
+  void HandlePragma(Preprocessor &PP, PragmaIntroducer Introducer,
+                    Token &FirstToken) override;
+
+private:
+  Sema &Actions;
+};
+
 struct PragmaLoopHintHandler : public PragmaHandler {
   PragmaLoopHintHandler() : PragmaHandler("loop") {}
   void HandlePragma(Preprocessor &PP, PragmaIntroducer Introducer,
@@ -381,6 +392,12 @@ void Parser::initializePragmaHandlers() {
   OptimizeHandler = std::make_unique<PragmaOptimizeHandler>(Actions);
   PP.AddPragmaHandler("clang", OptimizeHandler.get());
 
+  if (getTargetInfo().getTriple().isARM() ||
+      getTargetInfo().getTriple().isThumb()) {
+    RandezvousHandler = std::make_unique<PragmaRandezvousHandler>(Actions);
+    PP.AddPragmaHandler("clang", RandezvousHandler.get());
+  }
+
   LoopHintHandler = std::make_unique<PragmaLoopHintHandler>();
   PP.AddPragmaHandler("clang", LoopHintHandler.get());
 
@@ -497,6 +514,12 @@ void Parser::resetPragmaHandlers() {
   PP.RemovePragmaHandler("clang", OptimizeHandler.get());
   OptimizeHandler.reset();
 
+  if (getTargetInfo().getTriple().isARM() ||
+      getTargetInfo().getTriple().isThumb()) {
+    PP.RemovePragmaHandler("clang", RandezvousHandler.get());
+    RandezvousHandler.reset();
+  }
+
   PP.RemovePragmaHandler("clang", LoopHintHandler.get());
   LoopHintHandler.reset();
 
@@ -2825,6 +2848,67 @@ void PragmaOptimizeHandler::HandlePragma(Preprocessor &PP,
   Actions.ActOnPragmaOptimize(IsOn, FirstToken.getLocation());
 }
 
+// #pragma clang randezvous("option", ...)
+// #pragma clang randezvous default
+void PragmaRandezvousHandler::HandlePragma(Preprocessor &PP,
+                                           PragmaIntroducer Introducer,
+                                           Token &FirstToken) {
+  SmallVector<RandezvousAttr::RandezvousOption, 4> Options;
+  Token Tok;
+  PP.Lex(Tok);
+  if (Tok.is(tok::identifier) && Tok.getIdentifierInfo()->isStr("default")) {
+    PP.Lex(Tok);
+  } else {
+    if (Tok.isNot(tok::l_paren)) {
+      PP.Diag(Tok.getLocation(), diag::warn_pragma_expected_lparen)
+          << "clang randezvous";
+      return;
+    }
+    PP.Lex(Tok);
+
+    while (true) {
+      if (Tok.isNot(tok::string_literal)) {
+        PP.Diag(Tok.getLocation(), diag::warn_pragma_expected_string)
+            << "clang randezvous";
+        return;
+      }
+      SourceLocation OptionLoc = Tok.getLocation();
+      std::string Str;
+      if (!PP.FinishLexStringLiteral(Tok, Str, "pragma clang randezvous",
+                                     /*AllowMacroExpansion=*/false))
+        return;
+
+      RandezvousAttr::RandezvousOption Option;
+      if (!RandezvousAttr::ConvertStrToRandezvousOption(Str, Option)) {
+        PP.Diag(OptionLoc, diag::warn_pragma_invalid_argument)
+            << Str << "clang randezvous" << /*Expected=*/true
+            << "'no-layout', 'no-shadow-stack', 'no-icall-limiter' or 'full'";
+        return;
+      }
+      if (!llvm::is_contained(Options, Option))
+        Options.push_back(Option);
+
+      if (Tok.is(tok::r_paren))
+        break;
+      if (Tok.isNot(tok::comma)) {
+        PP.Diag(Tok.getLocation(), diag::warn_pragma_expected_punc)
+            << "clang randezvous";
+        return;
+      }
+      PP.Lex(Tok);
+    }
+    PP.Lex(Tok);
+  }
+
+  if (Tok.isNot(tok::eod)) {
+    PP.Diag(Tok.getLocation(), diag::warn_pragma_extra_tokens_at_eol)
+        << "clang randezvous";
+    return;
+  }
+
+  Actions.ActOnPragmaRandezvous(Options, FirstToken.getLocation());
+}
+
 namespace {
 /// Used as the annotation value for tok::annot_pragma_fp.
 struct TokFPAnnotValue {
@@ -914,6 +914,26 @@ void Sema::AddOptnoneAttributeIfNoConflicts(FunctionDecl *FD,
     FD->addAttr(NoInlineAttr::CreateImplicit(Context, Loc));
 }
 
+void Sema::ActOnPragmaRandezvous(
+    ArrayRef<RandezvousAttr::RandezvousOption> Options,
+    SourceLocation PragmaLoc) {
+  RandezvousPragmaOptions.assign(Options.begin(), Options.end());
+  if (Options.empty())
+    RandezvousPragmaLocation = SourceLocation();
+  else
+    RandezvousPragmaLocation = PragmaLoc;
+}
+
+void Sema::AddRangeBasedRandezvous(FunctionDecl *FD) {
+  // An explicit attribute overrides the pragma.
+  if (RandezvousPragmaLocation.isInvalid() || FD->hasAttr<RandezvousAttr>())
+    return;
+
+  FD->addAttr(RandezvousAttr::CreateImplicit(
+      Context, RandezvousPragmaOptions.data(), RandezvousPragmaOptions.size(),
+      RandezvousPragmaLocation));
+}
+
 typedef std::vector<std::pair<unsigned, SourceLocation> > VisStack;
 enum : unsigned { NoVisibility = ~0U };
 
@@ -5658,6 +5658,32 @@ static void handleARMInterruptAttr(Sema &S, Decl *D, const ParsedAttr &AL) {
   D->addAttr(::new (S.Context) ARMInterruptAttr(S.Context, AL, Kind));
 }
 
+static void handleRandezvousAttr(Sema &S, Decl *D, const ParsedAttr &AL) {
+  if (!checkAttributeAtLeastNumArgs(S, AL, 1))
+    return;
+
+  SmallVector<RandezvousAttr::RandezvousOption, 4> Options;
+  for (unsigned ArgIndex = 0; ArgIndex < AL.getNumArgs(); ++ArgIndex) {
+    StringRef Str;
+    SourceLocation ArgLoc;
+    if (!S.checkStringLiteralArgumentAttr(AL, ArgIndex, Str, &ArgLoc))
+      return;
+
+    RandezvousAttr::RandezvousOption Option;
+    if (!RandezvousAttr::ConvertStrToRandezvousOption(Str, Option)) {
+      S.Diag(ArgLoc, diag::warn_attribute_type_not_supported) << AL << Str
+                                                              << ArgLoc;
+      return;
+    }
+
+    if (!llvm::is_contained(Options, Option))
+      Options.push_back(Option);
+  }
+
+  D->addAttr(::new (S.Context) RandezvousAttr(S.Context, AL, Options.data(),
+                                              Options.size()));
+}
+
 static void handleMSP430InterruptAttr(Sema &S, Decl *D, const ParsedAttr &AL) {
   // MSP430 'interrupt' attribute is applied to
   // a function with no parameters and void return type.
@@ -7439,6 +7465,10 @@ static void ProcessDeclAttribute(Sema &S, Scope *scope, Decl *D,
     handleArmBuiltinAliasAttr(S, D, AL);
     break;
 
+  case ParsedAttr::AT_Randezvous:
+    handleRandezvousAttr(S, D, AL);
+    break;
+
   case ParsedAttr::AT_AcquireHandle:
     handleAcquireHandleAttr(S, D, AL);
     break;
@@ -3725,6 +3725,15 @@ ASTReader::ReadASTBlock(ModuleFile &F, unsigned ClientLoadCapabilities) {
       OptimizeOffPragmaLocation = ReadSourceLocation(F, Record[0]);
       break;
 
+    case RANDEZVOUS_PRAGMA_OPTIONS:
+      if (Record.empty()) {
+        Error("invalid pragma randezvous record");
+        return Failure;
+      }
+      RandezvousPragmaLocation = ReadSourceLocation(F, Record[0]);
+      RandezvousPragmaOptions.assign(Record.begin() + 1, Record.end());
+      break;
+
     case MSSTRUCT_PRAGMA_OPTIONS:
       if (Record.size() != 1) {
         Error("invalid pragma ms_struct record");
@@ -7870,6 +7879,12 @@ void ASTReader::UpdateSema() {
   // pragma in the source.
   if(OptimizeOffPragmaLocation.isValid())
     SemaObj->ActOnPragmaOptimize(/* On = */ false, OptimizeOffPragmaLocation);
+  if (RandezvousPragmaLocation.isValid()) {
+    SmallVector<RandezvousAttr::RandezvousOption, 4> Options;
+    for (uint64_t Option : RandezvousPragmaOptions)
+      Options.push_back((RandezvousAttr::RandezvousOption)Option);
+    SemaObj->ActOnPragmaRandezvous(Options, RandezvousPragmaLocation);
+  }
   if (PragmaMSStructState != -1)
     SemaObj->ActOnPragmaMSStruct((PragmaMSStructKind)PragmaMSStructState);
   if (PointersToMembersPragmaLocation.isValid()) {
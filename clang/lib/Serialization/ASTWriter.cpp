@@ -781,6 +781,7 @@ void ASTWriter::WriteBlockInfoBlock() {
   RECORD(UNDEFINED_BUT_USED);
   RECORD(LATE_PARSED_TEMPLATE);
   RECORD(OPTIMIZE_PRAGMA_OPTIONS);
+  RECORD(RANDEZVOUS_PRAGMA_OPTIONS);
   RECORD(MSSTRUCT_PRAGMA_OPTIONS);
   RECORD(POINTERS_TO_MEMBERS_PRAGMA_OPTIONS);
   RECORD(UNUSED_LOCAL_TYPEDEF_NAME_CANDIDATES);
@@ -4134,6 +4135,16 @@ void ASTWriter::WriteOptimizePragmaOptions(Sema &SemaRef) {
   Stream.EmitRecord(OPTIMIZE_PRAGMA_OPTIONS, Record);
 }
 
+/// Write the state of 'pragma clang randezvous' at the end of the module.
+void ASTWriter::WriteRandezvousPragmaOptions(Sema &SemaRef) {
+  RecordData Record;
+  AddSourceLocation(SemaRef.RandezvousPragmaLocation, Record);
+  for (RandezvousAttr::RandezvousOption Option :
+       SemaRef.RandezvousPragmaOptions)
+    Record.push_back(Option);
+  Stream.EmitRecord(RANDEZVOUS_PRAGMA_OPTIONS, Record);
+}
+
 /// Write the state of 'pragma ms_struct' at the end of the module.
 void ASTWriter::WriteMSStructPragmaOptions(Sema &SemaRef) {
   RecordData Record;
@@ -4915,6 +4926,7 @@ ASTFileSignature ASTWriter::WriteASTCore(Sema &SemaRef, StringRef isysroot,
   WriteObjCCategories();
   if(!WritingModule) {
     WriteOptimizePragmaOptions(SemaRef);
+    WriteRandezvousPragmaOptions(SemaRef);
     WriteMSStructPragmaOptions(SemaRef);
     WriteMSPointersToMembersPragmaOptions(SemaRef);
   }
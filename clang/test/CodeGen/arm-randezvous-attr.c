@@ -0,0 +1,28 @@
+// RUN: %clang_cc1 -triple thumbv7em-none-eabi -emit-llvm -o - %s | FileCheck %s
+
+// CHECK: define{{.*}} void @attr_fn() [[ATTR:#[0-9]+]]
+__attribute__((randezvous("no-shadow-stack", "no-layout", "no-shadow-stack")))
+void attr_fn(void) {}
+
+// The pragma applies to later function definitions
+#pragma clang randezvous("full")
+
+// CHECK: define{{.*}} void @pragma_fn() [[PRAGMA:#[0-9]+]]
+void pragma_fn(void) {}
+
+// An explicit attribute overrides the pragma
+// CHECK: define{{.*}} void @attr_over_pragma_fn() [[OVERRIDE:#[0-9]+]]
+__attribute__((randezvous("no-icall-limiter")))
+void attr_over_pragma_fn(void) {}
+
+#pragma clang randezvous default
+
+// CHECK: define{{.*}} void @plain_fn() [[PLAIN:#[0-9]+]]
+void plain_fn(void) {}
+
+// CHECK: attributes [[ATTR]] = { {{.*}}"randezvous"="no-shadow-stack,no-layout"{{.*}} }
+// CHECK: attributes [[PRAGMA]] = { {{.*}}"randezvous"="full"{{.*}} }
+// CHECK: attributes [[OVERRIDE]] = { {{.*}}"randezvous"="no-icall-limiter"{{.*}} }
+// CHECK: attributes [[PLAIN]] = {
+// CHECK-NOT: randezvous
+// CHECK-SAME: }
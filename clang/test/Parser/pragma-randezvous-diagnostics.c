@@ -0,0 +1,30 @@
+// RUN: %clang_cc1 -triple thumbv7em-none-eabi -fsyntax-only -verify %s
+
+#pragma clang randezvous("no-layout")
+#pragma clang randezvous("no-shadow-stack", "no-icall-limiter", "full")
+#pragma clang randezvous default
+
+// No argument
+#pragma clang randezvous // expected-warning {{missing '(' after '#pragma clang randezvous' - ignoring}}
+
+// Wrong arguments
+#pragma clang randezvous full // expected-warning {{missing '(' after '#pragma clang randezvous' - ignoring}}
+#pragma clang randezvous() // expected-warning {{expected string literal in '#pragma clang randezvous' - ignoring}}
+#pragma clang randezvous(full) // expected-warning {{expected string literal in '#pragma clang randezvous' - ignoring}}
+#pragma clang randezvous("full", 1) // expected-warning {{expected string literal in '#pragma clang randezvous' - ignoring}}
+#pragma clang randezvous("no-stack") // expected-warning {{unexpected argument 'no-stack' to '#pragma clang randezvous'; expected 'no-layout', 'no-shadow-stack', 'no-icall-limiter' or 'full'}}
+
+// Missing punctuation
+#pragma clang randezvous("full" // expected-warning {{expected ')' or ',' in '#pragma clang randezvous'}}
+#pragma clang randezvous("full"; "no-layout") // expected-warning {{expected ')' or ',' in '#pragma clang randezvous'}}
+
+// Extra arguments
+#pragma clang randezvous("full") "no-layout" // expected-warning {{extra tokens at end of '#pragma clang randezvous' - ignored}}
+#pragma clang randezvous default on // expected-warning {{extra tokens at end of '#pragma clang randezvous' - ignored}}
+
+// Check that _Pragma can also be used to define macros that control
+// Randezvous for a region of code
+#define RANDEZVOUS_NO_SHADOW_STACK _Pragma("clang randezvous(\"no-shadow-stack\")")
+#define RANDEZVOUS_DEFAULT _Pragma("clang randezvous default")
+RANDEZVOUS_NO_SHADOW_STACK
+RANDEZVOUS_DEFAULT
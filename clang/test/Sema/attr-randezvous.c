@@ -0,0 +1,38 @@
+// RUN: %clang_cc1 %s -triple thumbv7em-none-eabi -verify -fsyntax-only
+// RUN: %clang_cc1 %s -triple armv7-none-eabi -verify -fsyntax-only
+// RUN: %clang_cc1 %s -triple x86_64-unknown-linux -Wunknown-pragmas -DNON_ARM -verify -fsyntax-only
+
+#ifdef NON_ARM
+
+__attribute__((randezvous("no-layout"))) void foo0(void) {} // expected-warning {{unknown attribute 'randezvous' ignored}}
+
+#pragma clang randezvous("no-shadow-stack") // expected-warning {{unknown pragma ignored}}
+#pragma clang randezvous default // expected-warning {{unknown pragma ignored}}
+
+#else
+
+__attribute__((randezvous)) void foo1(void) {} // expected-error {{'randezvous' attribute takes at least 1 argument}}
+__attribute__((randezvous())) void foo2(void) {} // expected-error {{'randezvous' attribute takes at least 1 argument}}
+__attribute__((randezvous(no_layout))) void foo3(void) {} // expected-error {{'randezvous' attribute requires a string}}
+__attribute__((randezvous("no-layout", 1))) void foo4(void) {} // expected-error {{'randezvous' attribute requires a string}}
+__attribute__((randezvous("no-stack"))) void foo5(void) {} // expected-warning {{'randezvous' attribute argument not supported: no-stack}}
+
+__attribute__((randezvous("no-layout"))) void foo6(void) {}
+__attribute__((randezvous("no-shadow-stack"))) void foo7(void) {}
+__attribute__((randezvous("no-icall-limiter"))) void foo8(void) {}
+__attribute__((randezvous("full"))) void foo9(void) {}
+__attribute__((randezvous("no-layout", "no-shadow-stack", "no-layout"))) void foo10(void) {}
+
+// The attribute can be placed on declarations as well as definitions
+__attribute__((randezvous("full"))) void foo11(void);
+void foo11(void) {}
+
+int var __attribute__((randezvous("full"))); // expected-warning {{'randezvous' attribute only applies to functions}}
+
+struct __attribute__((randezvous("full"))) S { int x; }; // expected-warning {{'randezvous' attribute only applies to functions}}
+
+void foo12(void) {
+  int local __attribute__((randezvous("full"))); // expected-warning {{'randezvous' attribute only applies to functions}}
+}
+
+#endif
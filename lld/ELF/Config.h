@@ -187,6 +187,12 @@ struct Configuration {
   bool pie;
   bool printGcSections;
   bool printIcfSections;
+  bool randezvousFill;
+  llvm::Optional<uint32_t> randezvousSeed;
+  uint64_t randezvousMaxTextSize;
+  uint64_t randezvousMaxRodataSize;
+  uint64_t randezvousMaxDataSize;
+  uint64_t randezvousMaxBssSize;
   bool relocatable;
   bool relrPackDynRelocs;
   bool saveTemps;
@@ -306,6 +306,23 @@ static void checkOptions() {
   if (config->fixCortexA8 && config->emachine != EM_ARM)
     error("--fix-cortex-a8 is only supported on ARM targets");
 
+  if (config->randezvousSeed) {
+    if (config->emachine != EM_ARM)
+      error("--randezvous-seed is only supported on ARM targets");
+    // Garbage words in the padding are absolute addresses of trap
+    // instructions, written without dynamic relocations.
+    if (config->isPic)
+      error("--randezvous-seed may not be used with -pie or -shared");
+    if (config->shuffleSectionSeed)
+      error("--randezvous-seed and --shuffle-sections may not be used "
+            "together");
+  } else if (config->randezvousFill) {
+    if (config->emachine != EM_ARM)
+      error("--randezvous-fill is only supported on ARM targets");
+    if (config->isPic)
+      error("--randezvous-fill may not be used with -pie or -shared");
+  }
+
   if (config->tocOptimize && config->emachine != EM_PPC64)
     error("--toc-optimize is only supported on the PowerPC64 target");
 
@@ -340,6 +357,10 @@ static void checkOptions() {
       error("-r and -pie may not be used together");
     if (config->exportDynamic)
       error("-r and --export-dynamic may not be used together");
+    if (config->randezvousSeed)
+      error("-r and --randezvous-seed may not be used together");
+    if (config->randezvousFill)
+      error("-r and --randezvous-fill may not be used together");
   }
 
   if (config->executeOnly) {
@@ -674,6 +695,40 @@ static StripPolicy getStrip(opt::InputArgList &args) {
   return StripPolicy::Debug;
 }
 
+// Parses a maximum section size for --randezvous-seed and --randezvous-fill,
+// which may be given in decimal or in hexadecimal with the 0x prefix.
+static uint64_t getRandezvousMaxSize(opt::InputArgList &args, unsigned id,
+                                     uint64_t defaultValue) {
+  auto *arg = args.getLastArg(id);
+  if (!arg)
+    return defaultValue;
+
+  uint64_t v;
+  if (!to_integer(arg->getValue(), v, 0)) {
+    StringRef spelling = args.getArgString(arg->getIndex());
+    error(spelling + ": number expected, but got '" + arg->getValue() + "'");
+    return defaultValue;
+  }
+  return v;
+}
+
+// Parses the seed for --randezvous-seed, which must be a nonzero 32-bit
+// integer so that every link with the same seed produces the same layout.
+static Optional<uint32_t> getRandezvousSeed(opt::InputArgList &args) {
+  auto *arg = args.getLastArg(OPT_randezvous_seed);
+  if (!arg)
+    return None;
+
+  uint32_t v;
+  if (!to_integer(arg->getValue(), v, 0) || v == 0) {
+    StringRef spelling = args.getArgString(arg->getIndex());
+    error(spelling + ": nonzero 32-bit seed expected, but got '" +
+          arg->getValue() + "'");
+    return None;
+  }
+  return v;
+}
+
 static uint64_t parseSectionAddress(StringRef s, opt::InputArgList &args,
                                     const opt::Arg &arg) {
   uint64_t va = 0;
@@ -994,6 +1049,16 @@ static void readConfigs(opt::InputArgList &args) {
   config->printArchiveStats = args.getLastArgValue(OPT_print_archive_stats);
   config->printSymbolOrder =
       args.getLastArgValue(OPT_print_symbol_order);
+  config->randezvousFill = args.hasArg(OPT_randezvous_fill);
+  config->randezvousSeed = getRandezvousSeed(args);
+  config->randezvousMaxTextSize =
+      getRandezvousMaxSize(args, OPT_randezvous_max_text_size, 0x1e0000);
+  config->randezvousMaxRodataSize =
+      getRandezvousMaxSize(args, OPT_randezvous_max_rodata_size, 0x10000);
+  config->randezvousMaxDataSize =
+      getRandezvousMaxSize(args, OPT_randezvous_max_data_size, 0x10000);
+  config->randezvousMaxBssSize =
+      getRandezvousMaxSize(args, OPT_randezvous_max_bss_size, 0x10000);
   config->rpath = getRpath(args);
   config->relocatable = args.hasArg(OPT_relocatable);
   config->saveTemps = args.hasArg(OPT_save_temps);
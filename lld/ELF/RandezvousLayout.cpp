@@ -0,0 +1,356 @@
+//===- RandezvousLayout.cpp -----------------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements link-time layout randomization for programs protected
+// by Randezvous. The Randezvous compiler passes randomize the layout of a
+// program and fill up each section to a fixed maximum size, so producing a
+// new variant requires running code generation again. With
+// --randezvous-seed=<seed>, the same can be done at link time instead: the
+// objects are compiled once with -ffunction-sections and -fdata-sections, and
+// each link with a different seed produces a different variant.
+//
+// For each of .text, .rodata, .data and .bss, we
+//
+// * shuffle the input sections within each input section description, leaving
+//   in place the sections that are sorted (by SORT() or --sort-section),
+//   ordered (by --symbol-ordering-file or a call graph profile), or not named
+//   .text.*, .rodata.*, .data.* or .bss.*;
+//
+// * insert padding sections after randomly chosen input sections, which take
+//   up half of the free space of the output section in total; and
+//
+// * append one more padding section whose size is adjusted after thunks are
+//   created so that the output section exactly fills its maximum size.
+//
+// With --randezvous-fill instead, the layout is left alone and only the last
+// padding section is appended to each of them. This tops up programs that the
+// Randezvous compiler passes already filled up: each module fills up only its
+// share of a section in units of 4 bytes, and the linker inserts alignment
+// padding between modules, so the sections usually fall a bit short of their
+// maximum sizes.
+//
+// Padding in .text consists of UDF.W trap instructions, and so do the gaps
+// that alignment leaves between input sections (UDF in 2-byte gaps). Padding in .rodata and
+// .data consists of garbage words which, if there is any text padding, are
+// Thumb addresses of trap instructions, so that a leaked garbage word looks
+// like a code pointer. Padding in .bss is zero-filled.
+//
+// An output section that a linker script symbol assignment refers to is left
+// alone, as the symbols may delimit a table (e.g. a linker set or an
+// .init_array-style array) whose entries would be broken up by padding.
+//
+// Garbage words are absolute addresses written without relocations, so this
+// is not supported for position-independent output. The seed must be nonzero;
+// the layout is a function of the seed and the inputs only, so links are
+// reproducible.
+//
+//===----------------------------------------------------------------------===//
+
+#include "RandezvousLayout.h"
+#include "Config.h"
+#include "LinkerScript.h"
+#include "OutputSections.h"
+#include "Symbols.h"
+#include "SyntheticSections.h"
+#include "Target.h"
+#include "lld/Common/ErrorHandler.h"
+#include "lld/Common/Memory.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/MathExtras.h"
+#include <random>
+
+using namespace llvm;
+using namespace llvm::ELF;
+using namespace lld;
+using namespace lld::elf;
+
+namespace lld {
+namespace elf {
+// Padding in a randomized .text, .rodata or .data.
+class RandezvousPaddingSection final : public SyntheticSection {
+public:
+  RandezvousPaddingSection(const RandezvousLayout &layout, OutputSection *os,
+                           uint64_t size, uint32_t seed);
+  void writeTo(uint8_t *buf) override;
+  size_t getSize() const override { return size; }
+
+  static bool classof(const SectionBase *d) {
+    return d->kind() == InputSectionBase::Synthetic && !d->bss &&
+           d->name == ".randezvous.padding";
+  }
+
+  uint64_t size;
+  // Sections are written in parallel, so each padding section generates its
+  // garbage words from its own seed.
+  uint32_t seed;
+
+private:
+  const RandezvousLayout &layout;
+};
+} // namespace elf
+} // namespace lld
+
+uint32_t RandezvousLayout::getTrapAddress(std::mt19937 &g) const {
+  uint64_t idx = g() % trapEnds.back();
+  size_t i = llvm::upper_bound(trapEnds, idx) - trapEnds.begin();
+  uint64_t begin = i == 0 ? 0 : trapEnds[i - 1];
+  return trapPaddings[i]->getVA((idx - begin) * 4) | 1;
+}
+
+RandezvousPaddingSection::RandezvousPaddingSection(
+    const RandezvousLayout &layout, OutputSection *os, uint64_t size,
+    uint32_t seed)
+    : SyntheticSection(os->flags, SHT_PROGBITS, 4, ".randezvous.padding"),
+      size(size), seed(seed), layout(layout) {
+  parent = os;
+  addSyntheticLocal((flags & SHF_EXECINSTR) ? "$t" : "$d", STT_NOTYPE, 0, 0,
+                    *this);
+}
+
+void RandezvousPaddingSection::writeTo(uint8_t *buf) {
+  if (flags & SHF_EXECINSTR) {
+    // UDF.W #0, and UDF #0 for a trailing halfword.
+    uint64_t off = 0;
+    for (; off + 4 <= size; off += 4) {
+      write16(buf + off, 0xf7f0);
+      write16(buf + off + 2, 0xa000);
+    }
+    if (off + 2 <= size)
+      write16(buf + off, 0xde00);
+    return;
+  }
+
+  std::mt19937 g(seed);
+  for (uint64_t off = 0; off + 4 <= size; off += 4)
+    write32(buf + off, layout.hasTraps() ? layout.getTrapAddress(g) : g());
+}
+
+InputSection *RandezvousLayout::createPadding(OutputSection *os, uint64_t size,
+                                             std::mt19937 &g) {
+  InputSection *pad;
+  if (os->type == SHT_NOBITS) {
+    pad = make<BssSection>(".randezvous.padding", size, 4);
+  } else {
+    auto *sec = make<RandezvousPaddingSection>(*this, os, size, g());
+    if (sec->flags & SHF_EXECINSTR)
+      trapPaddings.push_back(sec);
+    pad = sec;
+  }
+  os->commitSection(pad);
+  return pad;
+}
+
+static uint64_t getPaddingSize(InputSection *pad) {
+  if (auto *bss = dyn_cast<BssSection>(pad))
+    return bss->size;
+  return cast<RandezvousPaddingSection>(pad)->size;
+}
+
+static void setPaddingSize(InputSection *pad, uint64_t size) {
+  if (auto *bss = dyn_cast<BssSection>(pad))
+    bss->size = size;
+  else
+    cast<RandezvousPaddingSection>(pad)->size = size;
+}
+
+// Returns true if a symbol assignment, either within the output section or
+// at the top level of the linker script, refers to the output section.
+static bool isReferencedByAssignment(OutputSection *os) {
+  for (BaseCommand *base : os->sectionCommands)
+    if (isa<SymbolAssignment>(base))
+      return true;
+
+  // Expressions are not kept in source form, but the tokens of an assignment
+  // are, e.g. "end = ADDR ( .data ) + SIZEOF ( .data )".
+  for (BaseCommand *base : script->sectionCommands) {
+    auto *cmd = dyn_cast<SymbolAssignment>(base);
+    if (!cmd)
+      continue;
+    SmallVector<StringRef, 8> tokens;
+    StringRef(cmd->commandString).split(tokens, ' ');
+    if (llvm::is_contained(tokens, os->name))
+      return true;
+  }
+  return false;
+}
+
+// Returns true if the input sections of an input section description are
+// sorted by SORT() or --sort-section.
+static bool isSorted(const InputSectionDescription *isd) {
+  for (const SectionPattern &pat : isd->sectionPatterns) {
+    if (pat.sortOuter == SortSectionPolicy::None)
+      continue;
+    if (pat.sortOuter != SortSectionPolicy::Default ||
+        pat.sortInner != SortSectionPolicy::Default ||
+        config->sortSection != SortSectionPolicy::Default)
+      return true;
+  }
+  return false;
+}
+
+// Inserts the padding section that takes up whatever space is left in an
+// output section before the given position.
+void RandezvousLayout::addTailPadding(
+    OutputSection *os, uint64_t maxSize, InputSectionDescription *isd,
+    std::vector<InputSection *>::iterator pos, std::mt19937 &g) {
+  InputSection *tail = createPadding(os, 0, g);
+  tail->alignment = 1;
+  isd->sections.insert(pos, tail);
+  randomizedSections.push_back({os, maxSize, tail});
+
+  // Padding sections are only 4-aligned, so input sections with a larger
+  // alignment can still leave gaps, which the default filler (0xd4d4, a
+  // conditional branch in Thumb) would fill. Fill them with UDF #0 instead,
+  // which traps whichever halfword a gap starts at.
+  if ((os->flags & SHF_EXECINSTR) && !os->filler)
+    os->filler = {0x00, 0xde, 0x00, 0xde};
+}
+
+void RandezvousLayout::randomizeSection(
+    OutputSection *os, uint64_t maxSize,
+    const DenseMap<const InputSectionBase *, int> &order, bool shuffle,
+    std::mt19937 &g) {
+  if (isReferencedByAssignment(os))
+    return;
+
+  std::vector<InputSectionDescription *> isds;
+  for (BaseCommand *base : os->sectionCommands)
+    if (auto *isd = dyn_cast<InputSectionDescription>(base))
+      isds.push_back(isd);
+  if (isds.empty())
+    return;
+
+  // With --randezvous-fill, only top up the output section at its end.
+  if (!shuffle) {
+    InputSectionDescription *last = isds.back();
+    addTailPadding(os, maxSize, last, last->sections.end(), g);
+    return;
+  }
+
+  // Only plain .text.*, .rodata.*, .data.* and .bss.* sections that are
+  // neither sorted nor ordered are moved, and padding only goes after them.
+  std::string prefix = (os->name + ".").str();
+  auto isMovable = [&](InputSection *isec) {
+    return isec->name.startswith(prefix) && !order.count(isec);
+  };
+
+  // Shuffle movable input sections among their own slots and estimate how
+  // much space all input sections take up. Thunks are not created yet; the
+  // tail padding section accounts for them later.
+  uint64_t used = 0;
+  size_t numGaps = 0;
+  std::vector<InputSectionDescription *> movableIsds;
+  for (InputSectionDescription *isd : isds) {
+    for (InputSection *isec : isd->sections)
+      used = alignTo(used, isec->alignment) + isec->getSize();
+    if (isSorted(isd))
+      continue;
+
+    std::vector<InputSection *> movable;
+    for (InputSection *isec : isd->sections)
+      if (isMovable(isec))
+        movable.push_back(isec);
+    if (movable.empty())
+      continue;
+    llvm::shuffle(movable.begin(), movable.end(), g);
+    auto it = movable.begin();
+    for (InputSection *&isec : isd->sections)
+      if (isMovable(isec))
+        isec = *it++;
+    numGaps += movable.size();
+    movableIsds.push_back(isd);
+  }
+  if (movableIsds.empty())
+    return;
+
+  // Scatter half of the free space after input sections in units of 4 bytes.
+  std::vector<uint64_t> shares(numGaps);
+  uint64_t freeSize = used < maxSize ? maxSize - used : 0;
+  if (numGaps != 0)
+    for (uint64_t i = 0; i < freeSize / 8; ++i)
+      shares[g() % numGaps] += 4;
+
+  size_t gap = 0;
+  for (InputSectionDescription *isd : movableIsds) {
+    std::vector<InputSection *> sections;
+    for (InputSection *isec : isd->sections) {
+      sections.push_back(isec);
+      if (!isMovable(isec))
+        continue;
+      if (shares[gap] != 0)
+        sections.push_back(createPadding(os, shares[gap], g));
+      ++gap;
+    }
+    isd->sections = std::move(sections);
+  }
+
+  // The tail padding goes after the last movable input section, so that it
+  // does not separate sections that were left in place from each other.
+  InputSectionDescription *last = movableIsds.back();
+  auto it = llvm::find_if(llvm::reverse(last->sections), isMovable);
+  addTailPadding(os, maxSize, last, it.base(), g);
+}
+
+void RandezvousLayout::randomize(
+    const DenseMap<const InputSectionBase *, int> &order) {
+  if (!config->randezvousSeed && !config->randezvousFill)
+    return;
+
+  // With --randezvous-fill only, garbage words are generated from the default
+  // seed of std::mt19937.
+  std::mt19937 g;
+  if (config->randezvousSeed)
+    g.seed(*config->randezvousSeed);
+  for (BaseCommand *base : script->sectionCommands) {
+    auto *os = dyn_cast<OutputSection>(base);
+    if (!os)
+      continue;
+    Optional<uint64_t> maxSize =
+        StringSwitch<Optional<uint64_t>>(os->name)
+            .Case(".text", config->randezvousMaxTextSize)
+            .Case(".rodata", config->randezvousMaxRodataSize)
+            .Case(".data", config->randezvousMaxDataSize)
+            .Case(".bss", config->randezvousMaxBssSize)
+            .Default(None);
+    if (maxSize)
+      randomizeSection(os, *maxSize, order, config->randezvousSeed.hasValue(),
+                       g);
+  }
+}
+
+bool RandezvousLayout::updatePadding() {
+  bool changed = false;
+  for (RandomizedSection &rs : randomizedSections) {
+    uint64_t oldSize = getPaddingSize(rs.tail);
+    uint64_t used = rs.sec->size - oldSize;
+    uint64_t newSize = used < rs.maxSize ? rs.maxSize - used : 0;
+    if (newSize != oldSize) {
+      setPaddingSize(rs.tail, newSize);
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+void RandezvousLayout::check() {
+  for (RandomizedSection &rs : randomizedSections)
+    if (rs.sec->size > rs.maxSize)
+      error("section " + rs.sec->name + " (0x" + utohexstr(rs.sec->size) +
+            " bytes) exceeds its Randezvous maximum size (0x" +
+            utohexstr(rs.maxSize) + " bytes)");
+
+  // Now that sizes are final, index the trap instructions for garbage words.
+  uint64_t numTraps = 0;
+  for (RandezvousPaddingSection *sec : trapPaddings) {
+    numTraps += sec->size / 4;
+    trapEnds.push_back(numTraps);
+  }
+  if (numTraps == 0)
+    trapEnds.clear();
+}
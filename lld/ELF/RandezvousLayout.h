@@ -0,0 +1,82 @@
+//===- RandezvousLayout.h ---------------------------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLD_ELF_RANDEZVOUS_LAYOUT_H
+#define LLD_ELF_RANDEZVOUS_LAYOUT_H
+
+#include "lld/Common/LLVM.h"
+#include "llvm/ADT/DenseMap.h"
+#include <random>
+#include <vector>
+
+namespace lld {
+namespace elf {
+
+class InputSection;
+class InputSectionBase;
+struct InputSectionDescription;
+class OutputSection;
+class RandezvousPaddingSection;
+
+// The state of Randezvous layout randomization for one link. The Writer owns
+// the instance, and padding sections refer to it to find trap instructions.
+class RandezvousLayout {
+public:
+  // Shuffles the input sections of .text, .rodata, .data and .bss and inserts
+  // padding sections between them, or with --randezvous-fill, only appends a
+  // padding section to each of them. Called once input sections are sorted;
+  // sections with a priority in the given order stay in place.
+  void randomize(const llvm::DenseMap<const InputSectionBase *, int> &order);
+
+  // Resizes the last padding section of each randomized output section so
+  // that the output section exactly fills its maximum size. Returns true if
+  // any padding section changed size.
+  bool updatePadding();
+
+  // Reports an error for each randomized output section whose contents exceed
+  // its maximum size, and indexes the trap instructions in text padding.
+  void check();
+
+  // Returns true if there is any trap instruction in text padding.
+  bool hasTraps() const { return !trapEnds.empty(); }
+
+  // Returns the Thumb address of a random trap instruction.
+  uint32_t getTrapAddress(std::mt19937 &g) const;
+
+private:
+  // An output section whose layout is randomized.
+  struct RandomizedSection {
+    OutputSection *sec;
+    uint64_t maxSize;
+    // The padding section that takes up whatever space is left.
+    InputSection *tail;
+  };
+
+  void
+  randomizeSection(OutputSection *os, uint64_t maxSize,
+                   const llvm::DenseMap<const InputSectionBase *, int> &order,
+                   bool shuffle, std::mt19937 &g);
+  InputSection *createPadding(OutputSection *os, uint64_t size,
+                              std::mt19937 &g);
+  void addTailPadding(OutputSection *os, uint64_t maxSize,
+                      InputSectionDescription *isd,
+                      std::vector<InputSection *>::iterator pos,
+                      std::mt19937 &g);
+
+  std::vector<RandomizedSection> randomizedSections;
+
+  // Text padding sections and, for each of them, the total number of trap
+  // instructions in it and all the text padding sections before it.
+  std::vector<RandezvousPaddingSection *> trapPaddings;
+  std::vector<uint64_t> trapEnds;
+};
+
+} // namespace elf
+} // namespace lld
+
+#endif
@@ -14,6 +14,7 @@
 #include "LinkerScript.h"
 #include "MapFile.h"
 #include "OutputSections.h"
+#include "RandezvousLayout.h"
 #include "Relocations.h"
 #include "SymbolTable.h"
 #include "Symbols.h"
@@ -88,6 +89,8 @@ private:
 
   uint64_t fileSize;
   uint64_t sectionHeaderOff;
+
+  RandezvousLayout randezvous;
 };
 } // anonymous namespace
 
@@ -1483,6 +1486,7 @@ template <class ELFT> void Writer<ELFT>::sortInputSections() {
   for (BaseCommand *base : script->sectionCommands)
     if (auto *sec = dyn_cast<OutputSection>(base))
       sortSection(sec, order);
+  randezvous.randomize(order);
 }
 
 template <class ELFT> void Writer<ELFT>::sortSections() {
@@ -1723,6 +1727,8 @@ template <class ELFT> void Writer<ELFT>::finalizeAddressDependentContent() {
         changed |= part.relrDyn->updateAllocSize();
     }
 
+    changed |= randezvous.updatePadding();
+
     const Defined *changedSym = script->assignAddresses();
     if (!changed) {
       // Some symbols may be dependent on section addresses. When we break the
@@ -1738,6 +1744,8 @@ template <class ELFT> void Writer<ELFT>::finalizeAddressDependentContent() {
     }
   }
 
+  randezvous.check();
+
   // If addrExpr is set, the address may not be a multiple of the alignment.
   // Warn because this is error-prone.
   for (BaseCommand *cmd : script->sectionCommands)
@@ -0,0 +1,56 @@
+// REQUIRES: arm
+// RUN: llvm-mc -filetype=obj -triple=thumbv7m-none-eabi %s -o %t.o
+// RUN: echo "SECTIONS { \
+// RUN:   . = 0x10000000; \
+// RUN:   .text : { *(.text*) } \
+// RUN:   .rodata : { *(.rodata*) } \
+// RUN: }" > %t.script
+// RUN: ld.lld --randezvous-fill --randezvous-max-text-size=0x100 \
+// RUN:   --randezvous-max-rodata-size=0x40 -T %t.script %t.o -o %t
+// RUN: llvm-readelf -S %t | FileCheck --check-prefix=SEC %s
+// RUN: llvm-nm -n %t | FileCheck %s
+// RUN: llvm-objdump -d --no-show-raw-insn %t | FileCheck --check-prefix=DIS %s
+
+/// The sections are topped up to their maximum sizes.
+// SEC: .text   PROGBITS 10000000 {{[0-9a-f]+}} 000100
+// SEC: .rodata PROGBITS 10000100 {{[0-9a-f]+}} 000040
+
+/// The layout is left alone.
+// CHECK:      10000000 T _start
+// CHECK-NEXT: 10000004 T a
+// CHECK-NEXT: 10000008 T b
+
+/// The tail padding consists of trap instructions.
+// DIS:      1000000c: udf.w #0
+// DIS:      100000fc: udf.w #0
+
+/// -r and position-independent output are not supported.
+// RUN: not ld.lld --randezvous-fill -r %t.o -o /dev/null 2>&1 | \
+// RUN:   FileCheck --check-prefix=RELOCATABLE %s
+// RELOCATABLE: error: -r and --randezvous-fill may not be used together
+// RUN: not ld.lld --randezvous-fill -pie %t.o -o /dev/null 2>&1 | \
+// RUN:   FileCheck --check-prefix=PIC %s
+// PIC: error: --randezvous-fill may not be used with -pie or -shared
+
+  .syntax unified
+  .thumb
+
+  .text
+  .globl _start
+  .type _start,%function
+_start:
+  bx lr
+  nop
+
+  .globl a
+  .type a,%function
+a:
+  nop.w
+
+  .globl b
+  .type b,%function
+b:
+  nop.w
+
+  .section .rodata,"a",%progbits
+  .word 1
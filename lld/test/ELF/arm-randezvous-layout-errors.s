@@ -0,0 +1,44 @@
+// REQUIRES: arm
+// RUN: llvm-mc -filetype=obj -triple=thumbv7m-none-eabi %s -o %t.o
+
+/// Garbage words are absolute addresses without dynamic relocations.
+// RUN: not ld.lld --randezvous-seed=1 -pie %t.o -o /dev/null 2>&1 | \
+// RUN:   FileCheck --check-prefix=PIC %s
+// RUN: not ld.lld --randezvous-seed=1 -shared %t.o -o /dev/null 2>&1 | \
+// RUN:   FileCheck --check-prefix=PIC %s
+// PIC: error: --randezvous-seed may not be used with -pie or -shared
+
+// RUN: not ld.lld --randezvous-seed=1 -r %t.o -o /dev/null 2>&1 | \
+// RUN:   FileCheck --check-prefix=RELOCATABLE %s
+// RELOCATABLE: error: -r and --randezvous-seed may not be used together
+
+// RUN: not ld.lld --randezvous-seed=1 --shuffle-sections=1 %t.o \
+// RUN:   -o /dev/null 2>&1 | FileCheck --check-prefix=SHUFFLE %s
+// SHUFFLE: error: --randezvous-seed and --shuffle-sections may not be used together
+
+/// The contents must fit in the maximum size.
+// RUN: not ld.lld --randezvous-seed=1 --randezvous-max-text-size=2 %t.o \
+// RUN:   -o /dev/null 2>&1 | FileCheck --check-prefix=SIZE %s
+// SIZE: error: section .text (0x4 bytes) exceeds its Randezvous maximum size (0x2 bytes)
+
+// RUN: not ld.lld --randezvous-max-text-size=foo %t.o -o /dev/null 2>&1 | \
+// RUN:   FileCheck --check-prefix=NUMBER %s
+// NUMBER: error: --randezvous-max-text-size={{.*}}: number expected, but got 'foo'
+
+/// The seed must be a nonzero 32-bit integer.
+// RUN: not ld.lld --randezvous-seed=0 %t.o -o /dev/null 2>&1 | \
+// RUN:   FileCheck --check-prefix=SEED0 %s
+// SEED0: error: --randezvous-seed=0: nonzero 32-bit seed expected, but got '0'
+// RUN: not ld.lld --randezvous-seed=0x100000000 %t.o -o /dev/null 2>&1 | \
+// RUN:   FileCheck --check-prefix=SEED33 %s
+// SEED33: error: --randezvous-seed=0x100000000: nonzero 32-bit seed expected, but got '0x100000000'
+// RUN: ld.lld --randezvous-seed=0xffffffff %t.o -o /dev/null
+
+  .syntax unified
+  .thumb
+
+  .section .text._start,"ax",%progbits
+  .globl _start
+  .type _start,%function
+_start:
+  nop.w
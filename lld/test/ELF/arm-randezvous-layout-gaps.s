@@ -0,0 +1,51 @@
+// REQUIRES: arm
+// RUN: llvm-mc -filetype=obj -triple=thumbv7m-none-eabi %s -o %t.o
+// RUN: echo "SECTIONS { \
+// RUN:   . = 0x10000000; \
+// RUN:   .text : { *(.text) *(.text.*) } \
+// RUN: }" > %t.script
+// RUN: ld.lld --randezvous-seed=1 --randezvous-max-text-size=0x20 \
+// RUN:   -T %t.script %t.o -o %t
+// RUN: llvm-objdump -d --no-show-raw-insn %t | FileCheck %s
+// RUN: ld.lld --randezvous-fill --randezvous-max-text-size=0x20 \
+// RUN:   -T %t.script %t.o -o %t.fill
+// RUN: llvm-objdump -d --no-show-raw-insn %t.fill | \
+// RUN:   FileCheck --check-prefix=FILL %s
+
+/// The alignment gap before the 16-byte aligned section is filled with trap
+/// instructions rather than the default filler, and so is the padding.
+// CHECK:      10000000: bx lr
+// CHECK-NEXT: 10000002: udf #0
+// CHECK-NEXT: 10000004: udf #0
+// CHECK-NEXT: 10000006: udf #0
+// CHECK-NEXT: 10000008: udf #0
+// CHECK-NEXT: 1000000a: udf #0
+// CHECK-NEXT: 1000000c: udf #0
+// CHECK-NEXT: 1000000e: udf #0
+// CHECK:      10000010: nop.w
+// CHECK-NEXT: 10000014: udf.w #0
+// CHECK-NEXT: 10000018: udf.w #0
+// CHECK-NEXT: 1000001c: udf.w #0
+
+// FILL:      10000000: bx lr
+// FILL-NEXT: 10000002: udf #0
+// FILL:      1000000e: udf #0
+// FILL:      10000010: nop.w
+// FILL-NEXT: 10000014: udf.w #0
+// FILL:      1000001c: udf.w #0
+
+  .syntax unified
+  .thumb
+
+  .text
+  .globl _start
+  .type _start,%function
+_start:
+  bx lr
+
+  .section .text.aligned,"ax",%progbits
+  .p2align 4
+  .globl aligned
+  .type aligned,%function
+aligned:
+  nop.w
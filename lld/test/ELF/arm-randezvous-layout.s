@@ -0,0 +1,105 @@
+// REQUIRES: arm
+// RUN: llvm-mc -filetype=obj -triple=thumbv7m-none-eabi %s -o %t.o
+// RUN: echo "SECTIONS { \
+// RUN:   . = 0x10000000; \
+// RUN:   .text : { *(SORT(.text.sorted.*)) *(.text.*) } \
+// RUN:   .rodata : { *(.rodata.*) } \
+// RUN:   .data : { \
+// RUN:     __init_array_start = .; KEEP(*(.init_array)) __init_array_end = .; \
+// RUN:     *(.data.*) \
+// RUN:   } \
+// RUN: }" > %t.script
+// RUN: echo ordered_b > %t.order
+// RUN: echo ordered_a >> %t.order
+// RUN: ld.lld --randezvous-seed=1 --randezvous-max-text-size=0x1000 \
+// RUN:   --randezvous-max-rodata-size=0x100 --randezvous-max-data-size=0x100 \
+// RUN:   --symbol-ordering-file %t.order -T %t.script %t.o -o %t
+// RUN: llvm-readelf -S %t | FileCheck --check-prefix=SEC %s
+// RUN: llvm-nm -n %t | FileCheck %s
+
+/// .text and .rodata are filled up to their maximum sizes. .data is left
+/// alone, as the linker script defines symbols in it.
+// SEC: .text   PROGBITS 10000000 {{[0-9a-f]+}} 001000
+// SEC: .rodata PROGBITS 10001000 {{[0-9a-f]+}} 000100
+// SEC: .data   PROGBITS 10001100 {{[0-9a-f]+}} 000010
+
+/// Sorted sections stay in order, with no padding between them.
+// CHECK:     [[#%x,SORTED:]] T sorted_a
+// CHECK:     [[#%x,SORTED+4]] T sorted_b
+// CHECK:     [[#%x,SORTED+8]] T sorted_c
+
+/// Sections ordered by --symbol-ordering-file stay together.
+// CHECK:     [[#%x,ORDERED:]] T ordered_b
+// CHECK:     [[#%x,ORDERED+4]] T ordered_a
+
+/// The init array and the data after it are neither moved nor padded.
+// CHECK:     10001100 {{.}} __init_array_start
+// CHECK:     10001108 {{.}} __init_array_end
+// CHECK:     10001108 D data_a
+// CHECK:     1000110c D data_b
+
+  .syntax unified
+  .thumb
+
+  .section .text.start,"ax",%progbits
+  .globl _start
+  .type _start,%function
+_start:
+  bx lr
+  nop
+
+  .section .text.sorted.c,"ax",%progbits
+  .globl sorted_c
+  .type sorted_c,%function
+sorted_c:
+  nop.w
+
+  .section .text.sorted.a,"ax",%progbits
+  .globl sorted_a
+  .type sorted_a,%function
+sorted_a:
+  nop.w
+
+  .section .text.sorted.b,"ax",%progbits
+  .globl sorted_b
+  .type sorted_b,%function
+sorted_b:
+  nop.w
+
+  .section .text.ordered_a,"ax",%progbits
+  .globl ordered_a
+  .type ordered_a,%function
+ordered_a:
+  nop.w
+
+  .section .text.ordered_b,"ax",%progbits
+  .globl ordered_b
+  .type ordered_b,%function
+ordered_b:
+  nop.w
+
+  .section .text.other,"ax",%progbits
+  .globl other
+  .type other,%function
+other:
+  nop.w
+
+  .section .rodata.a,"a",%progbits
+  .word 1
+
+  .section .rodata.b,"a",%progbits
+  .word 2
+
+  .section .init_array,"aw",%init_array
+  .word _start
+  .word other
+
+  .section .data.a,"aw",%progbits
+  .globl data_a
+data_a:
+  .word 3
+
+  .section .data.b,"aw",%progbits
+  .globl data_b
+data_b:
+  .word 4
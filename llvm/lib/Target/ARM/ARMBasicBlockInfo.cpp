@@ -88,18 +88,19 @@ unsigned ARMBasicBlockUtils::getOffsetOf(MachineInstr *MI) const {
   return Offset;
 }
 
-/// isBBInRange - Returns true if the distance between specific MI and
-/// specific BB can fit in MI's displacement field.
-bool ARMBasicBlockUtils::isBBInRange(MachineInstr *MI,
+/// isBBInRange - Returns true if the distance between specific MI, whose
+/// offset from the start of the function is MIOffset, and specific BB can fit
+/// in MI's displacement field.
+bool ARMBasicBlockUtils::isBBInRange(MachineInstr *MI, unsigned MIOffset,
                                      MachineBasicBlock *DestBB,
                                      unsigned MaxDisp) const {
   unsigned PCAdj      = isThumb ? 4 : 8;
-  unsigned BrOffset   = getOffsetOf(MI) + PCAdj;
+  unsigned BrOffset   = MIOffset + PCAdj;
   unsigned DestOffset = BBInfo[DestBB->getNumber()].Offset;
 
   LLVM_DEBUG(dbgs() << "Branch of destination " << printMBBReference(*DestBB)
                     << " from " << printMBBReference(*MI->getParent())
-                    << " max delta=" << MaxDisp << " from " << getOffsetOf(MI)
+                    << " max delta=" << MaxDisp << " from " << MIOffset
                     << " to " << DestOffset << " offset "
                     << int(DestOffset - BrOffset) << "\t" << *MI);
 
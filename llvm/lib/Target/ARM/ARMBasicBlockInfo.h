@@ -142,7 +142,12 @@ public:
   }
 
   bool isBBInRange(MachineInstr *MI, MachineBasicBlock *DestBB,
-                   unsigned MaxDisp) const;
+                   unsigned MaxDisp) const {
+    return isBBInRange(MI, getOffsetOf(MI), DestBB, MaxDisp);
+  }
+
+  bool isBBInRange(MachineInstr *MI, unsigned MIOffset,
+                   MachineBasicBlock *DestBB, unsigned MaxDisp) const;
 
   void insert(unsigned BBNum, BasicBlockInfo BBI) {
     BBInfo.insert(BBInfo.begin() + BBNum, BBI);
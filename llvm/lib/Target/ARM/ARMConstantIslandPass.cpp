@@ -81,6 +81,11 @@ static cl::opt<unsigned>
 CPMaxIteration("arm-constant-island-max-iteration", cl::Hidden, cl::init(30),
           cl::desc("The max number of iteration for converge"));
 
+static cl::opt<bool>
+CPCacheOffsets("arm-constant-island-cache-offsets", cl::Hidden, cl::init(true),
+          cl::desc("Check if constant pool users and branches are in range "
+                   "using cached offsets before fixing them up"));
+
 static cl::opt<bool> SynthesizeThumb1TBB(
     "arm-synthesize-thumb-1-tbb", cl::Hidden, cl::init(true),
     cl::desc("Use compressed jump tables in Thumb-1 by synthesizing an "
@@ -113,6 +118,21 @@ namespace {
 
     using water_iterator = std::vector<MachineBasicBlock *>::iterator;
 
+    /// InstrPosition - The offset of an instruction from the start of its
+    /// basic block, along with the block and its size when the offset was
+    /// computed.  While the instruction stays in that block and the block
+    /// keeps its size, the offset of the instruction from the start of the
+    /// function can be computed from the offset of the block without walking
+    /// the block: every change this pass makes inside an existing block
+    /// either changes its size or moves the instructions after the change
+    /// into a new block.
+    struct InstrPosition {
+      MachineInstr *MI = nullptr;
+      MachineBasicBlock *MBB = nullptr;
+      unsigned BBSize = 0;
+      unsigned Offset = 0;
+    };
+
     /// CPUser - One user of a constant pool, keeping the machine instruction
     /// pointer, the constant pool being referenced, and the max displacement
     /// allowed from the instruction to the CP.  The HighWaterMark records the
@@ -133,6 +153,8 @@ namespace {
       bool NegOk;
       bool IsSoImm;
       bool KnownAlignment = false;
+      InstrPosition UserPos;
+      InstrPosition CPEPos;
 
       CPUser(MachineInstr *mi, MachineInstr *cpemi, unsigned maxdisp,
              bool neg, bool soimm)
@@ -192,6 +214,7 @@ namespace {
       unsigned MaxDisp : 31;
       bool isCond : 1;
       unsigned UncondBr;
+      InstrPosition Pos;
 
       ImmBranch(MachineInstr *mi, unsigned maxdisp, bool cond, unsigned ubr)
         : MI(mi), MaxDisp(maxdisp), isCond(cond), UncondBr(ubr) {}
@@ -263,6 +286,8 @@ namespace {
                           bool DoDump = false);
     bool isWaterInRange(unsigned UserOffset, MachineBasicBlock *Water,
                         CPUser &U, unsigned &Growth);
+    bool isCPUserInRange(CPUser &U);
+    bool isImmBranchInRange(ImmBranch &Br);
     bool fixupImmediateBr(ImmBranch &Br);
     bool fixupConditionalBr(ImmBranch &Br);
     bool fixupUnconditionalBr(ImmBranch &Br);
@@ -276,7 +301,9 @@ namespace {
     MachineBasicBlock *adjustJTTargetBlockForward(MachineBasicBlock *BB,
                                                   MachineBasicBlock *JTBB);
 
+    unsigned getOffsetOf(MachineInstr *MI, InstrPosition &Pos) const;
     unsigned getUserOffset(CPUser&) const;
+    unsigned getUserOffset(CPUser&, unsigned UserOffset) const;
     void dumpBBs();
     void verify();
 
@@ -409,11 +436,16 @@ bool ARMConstantIslands::runOnMachineFunction(MachineFunction &mf) {
   while (true) {
     LLVM_DEBUG(dbgs() << "Beginning CP iteration #" << NoCPIters << '\n');
     bool CPChange = false;
-    for (unsigned i = 0, e = CPUsers.size(); i != e; ++i)
+    for (unsigned i = 0, e = CPUsers.size(); i != e; ++i) {
+      // Most users stay in range of their entries between iterations, and
+      // checking that with cached offsets avoids walking their blocks.
+      if (CPCacheOffsets && isCPUserInRange(CPUsers[i]))
+        continue;
       // For most inputs, it converges in no more than 5 iterations.
       // If it doesn't end in 10, the input may have huge BB or many CPEs.
       // In this case, we will try different heuristics.
       CPChange |= handleConstantPoolUser(i, NoCPIters >= CPMaxIteration / 2);
+    }
     if (CPChange && ++NoCPIters > CPMaxIteration)
       report_fatal_error("Constant Island pass failed to converge!");
     LLVM_DEBUG(dumpBBs());
@@ -424,8 +456,11 @@ bool ARMConstantIslands::runOnMachineFunction(MachineFunction &mf) {
 
     LLVM_DEBUG(dbgs() << "Beginning BR iteration #" << NoBRIters << '\n');
     bool BRChange = false;
-    for (unsigned i = 0, e = ImmBranches.size(); i != e; ++i)
+    for (unsigned i = 0, e = ImmBranches.size(); i != e; ++i) {
+      if (CPCacheOffsets && isImmBranchInRange(ImmBranches[i]))
+        continue;
       BRChange |= fixupImmediateBr(ImmBranches[i]);
+    }
     if (BRChange && ++NoBRIters > 30)
       report_fatal_error("Branch Fix Up pass failed to converge!");
     LLVM_DEBUG(dumpBBs());
@@ -957,8 +992,13 @@ MachineBasicBlock *ARMConstantIslands::splitBlockBeforeInstr(MachineInstr *MI) {
 /// displacement computation.  Update U.KnownAlignment to match its current
 /// basic block location.
 unsigned ARMConstantIslands::getUserOffset(CPUser &U) const {
-  unsigned UserOffset = BBUtils->getOffsetOf(U.MI);
+  return getUserOffset(U, BBUtils->getOffsetOf(U.MI));
+}
 
+/// getUserOffset - Compute the offset of U.MI as seen by the hardware given
+/// the offset of U.MI from the start of the function.
+unsigned ARMConstantIslands::getUserOffset(CPUser &U,
+                                           unsigned UserOffset) const {
   SmallVectorImpl<BasicBlockInfo> &BBInfo = BBUtils->getBBInfo();
   const BasicBlockInfo &BBI = BBInfo[U.MI->getParent()->getNumber()];
   unsigned KnownBits = BBI.internalKnownBits();
@@ -979,6 +1019,26 @@ unsigned ARMConstantIslands::getUserOffset(CPUser &U) const {
   return UserOffset;
 }
 
+/// getOffsetOf - Return the offset of MI from the start of the function like
+/// BBUtils->getOffsetOf, but reuse the offset of MI within its block recorded
+/// in Pos if it is still valid, and record it otherwise.
+unsigned ARMConstantIslands::getOffsetOf(MachineInstr *MI,
+                                         InstrPosition &Pos) const {
+  MachineBasicBlock *MBB = MI->getParent();
+  const BasicBlockInfo &BBI = BBUtils->getBBInfo()[MBB->getNumber()];
+  if (Pos.MI != MI || Pos.MBB != MBB || Pos.BBSize != BBI.Size) {
+    Pos.MI = MI;
+    Pos.MBB = MBB;
+    Pos.BBSize = BBI.Size;
+    Pos.Offset = BBUtils->getOffsetOf(MI) - BBI.Offset;
+  }
+#ifdef EXPENSIVE_CHECKS
+  assert(BBI.Offset + Pos.Offset == BBUtils->getOffsetOf(MI) &&
+         "Stale instruction position!");
+#endif
+  return BBI.Offset + Pos.Offset;
+}
+
 /// isOffsetInRange - Checks whether UserOffset (the location of a constant pool
 /// reference) is within MaxDisp of TrialOffset (a proposed location of a
 /// constant pool entry).
@@ -1586,6 +1646,26 @@ bool ARMConstantIslands::removeUnusedCPEntries() {
 }
 
 
+/// isCPUserInRange - Returns true if the constant pool entry currently used by
+/// U is in range.  This is the first check handleConstantPoolUser does, but
+/// using cached instruction positions, so that the blocks of U.MI and
+/// U.CPEMI are walked only if they have changed since the last check.
+bool ARMConstantIslands::isCPUserInRange(CPUser &U) {
+  unsigned UserOffset = getUserOffset(U, getOffsetOf(U.MI, U.UserPos));
+  unsigned CPEOffset = getOffsetOf(U.CPEMI, U.CPEPos);
+  return isOffsetInRange(UserOffset, CPEOffset, U.getMaxDisp(), U.NegOk);
+}
+
+/// isImmBranchInRange - Returns true if the destination of Br is in range.
+/// This is the first check fixupImmediateBr does, but using the cached
+/// position of Br.MI.
+bool ARMConstantIslands::isImmBranchInRange(ImmBranch &Br) {
+  MachineInstr *MI = Br.MI;
+  MachineBasicBlock *DestBB = MI->getOperand(0).getMBB();
+  return BBUtils->isBBInRange(MI, getOffsetOf(MI, Br.Pos), DestBB,
+                              Br.MaxDisp);
+}
+
 /// fixupImmediateBr - Fix up an immediate branch whose destination is too far
 /// away to fit in its displacement field.
 bool ARMConstantIslands::fixupImmediateBr(ImmBranch &Br) {
@@ -1704,6 +1784,7 @@ ARMConstantIslands::fixupConditionalBr(ImmBranch &Br) {
   BuildMI(MBB, DebugLoc(), TII->get(MI->getOpcode()))
     .addMBB(NextBB).addImm(CC).addReg(CCReg);
   Br.MI = &MBB->back();
+  Br.Pos = InstrPosition();
   BBUtils->adjustBBSize(MBB, TII->getInstSizeInBytes(MBB->back()));
   if (isThumb)
     BuildMI(MBB, DebugLoc(), TII->get(Br.UncondBr))
@@ -24,6 +24,7 @@
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/CodeGen/MachineBasicBlock.h"
 #include "llvm/CodeGen/MachineConstantPool.h"
 #include "llvm/CodeGen/MachineFrameInfo.h"
@@ -68,6 +69,9 @@
 
 using namespace llvm;
 
+STATISTIC(NumRandezvousLRSpillsElided,
+          "Number of LR spills elided for ARM Randezvous Shadow Stack");
+
 static cl::opt<bool>
 SpillAlignedNEONRegs("align-neon-spills", cl::Hidden, cl::init(true),
                      cl::desc("Align ARM NEON spills in prolog and epilog"));
@@ -187,9 +191,10 @@ static int sizeOfSPAdjustment(const MachineInstr &MI) {
   // ARM and Thumb2 push/pop insts have explicit "sp, sp" operands (+
   // pred) so the list starts at 4.
   for (int i = MI.getNumOperands() - 1; i >= 4; --i) {
-    // Don't count LR if the shadow stack pass is enabled; see the comment in
+    // Don't count LR if it goes to the shadow stack; see the comment in
     // ARMFrameLowering::assignCalleeSavedSpillSlots()
-    if (EnableRandezvousShadowStack && MI.getOperand(i).getReg() == ARM::LR) {
+    if (MI.getMF()->getInfo<ARMFunctionInfo>()->usesRandezvousShadowStack() &&
+        MI.getOperand(i).getReg() == ARM::LR) {
       continue;
     }
     count += RegSize;
@@ -402,9 +407,9 @@ void ARMFrameLowering::emitPrologue(MachineFunction &MF,
   // Determine spill area sizes.
   for (unsigned i = 0, e = CSI.size(); i != e; ++i) {
     unsigned Reg = CSI[i].getReg();
-    if (Reg == ARM::LR && EnableRandezvousShadowStack) {
-      // Don't count LR if the shadow stack pass is enabled; see the comment
-      // in ARMFrameLowering::assignCalleeSavedSpillSlots()
+    if (Reg == ARM::LR && AFI->usesRandezvousShadowStack()) {
+      // Don't count LR if it goes to the shadow stack; see the comment in
+      // ARMFrameLowering::assignCalleeSavedSpillSlots()
       continue;
     }
     int FI = CSI[i].getFrameIdx();
@@ -629,9 +634,9 @@ void ARMFrameLowering::emitPrologue(MachineFunction &MF,
     int CFIIndex;
     for (const auto &Entry : CSI) {
       unsigned Reg = Entry.getReg();
-      if (Reg == ARM::LR && EnableRandezvousShadowStack) {
-        // Don't count LR if the shadow stack pass is enabled; see the comment
-        // in ARMFrameLowering::assignCalleeSavedSpillSlots()
+      if (Reg == ARM::LR && AFI->usesRandezvousShadowStack()) {
+        // Don't count LR if it goes to the shadow stack; see the comment in
+        // ARMFrameLowering::assignCalleeSavedSpillSlots()
         continue;
       }
       int FI = Entry.getFrameIdx();
@@ -2069,9 +2074,17 @@ void ARMFrameLowering::determineCalleeSaves(MachineFunction &MF,
     // restore LR in that case.
     bool ExpensiveLRRestore = AFI->isThumb1OnlyFunction() && MFI.hasTailCall();
 
+    // Don't spill LR just for that if it would go to the Randezvous shadow
+    // stack: LR then never reaches memory, and a BX_RET is cheaper than
+    // saving and restoring LR on the shadow stack.
+    bool ElideLRSpill = EnableRandezvousShadowStackOpt &&
+                        AFI->usesRandezvousShadowStack();
+
     // If LR is not spilled, but at least one of R4, R5, R6, and R7 is spilled.
     // Spill LR as well so we can fold BX_RET to the registers restore (LDM).
-    if (!LRSpilled && CS1Spilled && !ExpensiveLRRestore) {
+    if (!LRSpilled && CS1Spilled && !ExpensiveLRRestore && ElideLRSpill) {
+      ++NumRandezvousLRSpillsElided;
+    } else if (!LRSpilled && CS1Spilled && !ExpensiveLRRestore) {
       SavedRegs.set(ARM::LR);
       NumGPRSpills++;
       SmallVectorImpl<unsigned>::iterator LRPos;
@@ -2099,7 +2112,7 @@ void ARMFrameLowering::determineCalleeSaves(MachineFunction &MF,
           if (!AFI->isThumbFunction() ||
               (STI.isTargetWindows() && Reg == ARM::R11) ||
               isARMLowRegister(Reg) ||
-              (Reg == ARM::LR && !ExpensiveLRRestore)) {
+              (Reg == ARM::LR && !ExpensiveLRRestore && !ElideLRSpill)) {
             SavedRegs.set(Reg);
             LLVM_DEBUG(dbgs() << "Spilling " << printReg(Reg, TRI)
                               << " to make up alignment\n");
@@ -2196,7 +2209,7 @@ bool ARMFrameLowering::assignCalleeSavedSpillSlots(
     CSI.back().setRestored(false);
   }
 
-  if (EnableRandezvousShadowStack) {
+  if (MF.getInfo<ARMFunctionInfo>()->usesRandezvousShadowStack()) {
     // If spilling LR, mark LR as spilled to a register (PC here just for
     // convenience).  NOTE: This is a hack to keep LR in the callee-saved
     // registers without actually reserving a spill slot for LR.  In this way,
@@ -106,7 +106,7 @@ private:
     unsigned ADDrr;
     unsigned ADDri;
 
-    // Used for G_ICMP
+    // Used for G_ICMP (and MOVi for null pointer G_CONSTANT)
     unsigned CMPrr;
     unsigned MOVi;
     unsigned MOVCCi;
@@ -805,7 +805,29 @@ bool ARMInstructionSelector::selectSelect(MachineInstrBuilder &MIB,
 
 bool ARMInstructionSelector::selectShift(unsigned ShiftOpc,
                                          MachineInstrBuilder &MIB) const {
-  assert(!STI.isThumb() && "Unsupported subtarget");
+  if (STI.isThumb()) {
+    // Thumb2 has no MOV with a register-shifted register operand, but it has
+    // dedicated instructions for shifting by a register.
+    unsigned NewOpc;
+    switch (ShiftOpc) {
+    case ARM_AM::ShiftOpc::lsl:
+      NewOpc = ARM::t2LSLrr;
+      break;
+    case ARM_AM::ShiftOpc::lsr:
+      NewOpc = ARM::t2LSRrr;
+      break;
+    case ARM_AM::ShiftOpc::asr:
+      NewOpc = ARM::t2ASRrr;
+      break;
+    default:
+      LLVM_DEBUG(dbgs() << "Unsupported shift opcode\n");
+      return false;
+    }
+    MIB->setDesc(TII.get(NewOpc));
+    MIB.add(predOps(ARMCC::AL)).add(condCodeOp());
+    return constrainSelectedInstRegOperands(*MIB, TII, TRI, RBI);
+  }
+
   MIB->setDesc(TII.get(ARM::MOVsr));
   MIB.addImm(ShiftOpc);
   MIB.add(predOps(ARMCC::AL)).add(condCodeOp());
@@ -982,8 +1004,7 @@ bool ARMInstructionSelector::select(MachineInstr &I) {
       }
     }
 
-    assert(!STI.isThumb() && "Unsupported subtarget");
-    I.setDesc(TII.get(ARM::MOVi));
+    I.setDesc(TII.get(Opcodes.MOVi));
     MIB.add(predOps(ARMCC::AL)).add(condCodeOp());
     break;
   }
@@ -43,21 +43,27 @@ MCOperand ARMAsmPrinter::GetSymbolRef(const MachineOperand &MO,
 
   const MCExpr *Expr =
       MCSymbolRefExpr::create(Symbol, SymbolVariant, OutContext);
+
   switch (MO.getTargetFlags() & ARMII::MO_OPTION_MASK) {
   default:
     llvm_unreachable("Unknown target flag on symbol operand");
   case ARMII::MO_NO_FLAG:
     break;
   case ARMII::MO_LO16:
-    Expr =
-        MCSymbolRefExpr::create(Symbol, SymbolVariant, OutContext);
-    Expr = ARMMCExpr::createLower16(Expr, OutContext);
-    break;
   case ARMII::MO_HI16:
-    Expr =
-        MCSymbolRefExpr::create(Symbol, SymbolVariant, OutContext);
-    Expr = ARMMCExpr::createUpper16(Expr, OutContext);
-    break;
+    // The offset is part of the address, so it must be applied before
+    // extracting the lower/upper 16 bits; an offset outside :lower16: or
+    // :upper16: cannot be encoded in MOVW/MOVT.
+    if (!MO.isJTI() && MO.getOffset())
+      Expr = MCBinaryExpr::createAdd(Expr,
+                                     MCConstantExpr::create(MO.getOffset(),
+                                                            OutContext),
+                                     OutContext);
+    if ((MO.getTargetFlags() & ARMII::MO_OPTION_MASK) == ARMII::MO_LO16)
+      Expr = ARMMCExpr::createLower16(Expr, OutContext);
+    else
+      Expr = ARMMCExpr::createUpper16(Expr, OutContext);
+    return MCOperand::createExpr(Expr);
   }
 
   if (!MO.isJTI() && MO.getOffset())
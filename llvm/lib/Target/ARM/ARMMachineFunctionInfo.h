@@ -136,6 +136,11 @@ class ARMFunctionInfo : public MachineFunctionInfo {
   /// con/destructors).
   bool PreservesR0 = false;
 
+  /// RandezvousShadowStack - True if the return address of this function is
+  /// saved to the Randezvous shadow stack instead of to the stack.  Set by
+  /// the Randezvous shadow stack selector before frame lowering.
+  bool RandezvousShadowStack = false;
+
 public:
   ARMFunctionInfo() = default;
 
@@ -166,6 +171,9 @@ public:
   bool isLRSpilled() const { return LRSpilled; }
   void setLRIsSpilled(bool s) { LRSpilled = s; }
 
+  bool usesRandezvousShadowStack() const { return RandezvousShadowStack; }
+  void setUsesRandezvousShadowStack(bool s) { RandezvousShadowStack = s; }
+
   unsigned getFramePtrSpillOffset() const { return FramePtrSpillOffset; }
   void setFramePtrSpillOffset(unsigned o) { FramePtrSpillOffset = o; }
 
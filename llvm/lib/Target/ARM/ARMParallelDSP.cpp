@@ -16,12 +16,14 @@
 
 #include "ARM.h"
 #include "ARMSubtarget.h"
+#include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/AssumptionCache.h"
 #include "llvm/Analysis/GlobalsModRef.h"
 #include "llvm/Analysis/LoopAccessAnalysis.h"
+#include "llvm/Analysis/ValueTracking.h"
 #include "llvm/CodeGen/TargetPassConfig.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IntrinsicsARM.h"
@@ -39,13 +41,14 @@ using namespace PatternMatch;
 #define DEBUG_TYPE "arm-parallel-dsp"
 
 STATISTIC(NumSMLAD , "Number of smlad instructions generated");
+STATISTIC(NumSMLSD , "Number of smlsd instructions generated");
 
 static cl::opt<bool>
 DisableParallelDSP("disable-arm-parallel-dsp", cl::Hidden, cl::init(false),
                    cl::desc("Disable the ARM Parallel DSP pass"));
 
 static cl::opt<unsigned>
-NumLoadLimit("arm-parallel-dsp-load-limit", cl::Hidden, cl::init(16),
+NumLoadLimit("arm-parallel-dsp-load-limit", cl::Hidden, cl::init(64),
              cl::desc("Limit the number of loads analysed"));
 
 namespace {
@@ -65,10 +68,11 @@ namespace {
     bool          Exchange = false;
     bool          ReadOnly = true;
     bool          Paired = false;
+    bool          Negated = false;      // Subtracted from the reduction.
     SmallVector<LoadInst*, 2> VecLd;    // Container for loads to widen.
 
-    MulCandidate(Instruction *I, Value *lhs, Value *rhs) :
-      Root(I), LHS(lhs), RHS(rhs) { }
+    MulCandidate(Instruction *I, Value *lhs, Value *rhs, bool negated) :
+      Root(I), LHS(lhs), RHS(rhs), Negated(negated) { }
 
     bool HasTwoLoadInputs() const {
       return isa<LoadInst>(LHS) && isa<LoadInst>(RHS);
@@ -87,17 +91,28 @@ namespace {
     MulCandList     Muls;
     MulPairList        MulPairs;
     SetVector<Instruction*> Adds;
+    SmallPtrSet<Instruction*, 4> NegatedAdds;
 
   public:
     Reduction() = delete;
 
     Reduction (Instruction *Add) : Root(Add) { }
 
-    /// Record an Add instruction that is a part of the this reduction.
-    void InsertAdd(Instruction *I) { Adds.insert(I); }
+    /// Record an Add or Sub instruction that is a part of the this reduction,
+    /// and whether its value is subtracted from the reduction. Returns false
+    /// if it had already been recorded, as its muls would then need to be
+    /// accumulated more than once.
+    bool InsertAdd(Instruction *I, bool Negated) {
+      if (!Adds.insert(I))
+        return false;
+      if (Negated)
+        NegatedAdds.insert(I);
+      return true;
+    }
 
     /// Create MulCandidates, each rooted at a Mul instruction, that is a part
-    /// of this reduction.
+    /// of this reduction. A mul is negated if it is subtracted from the
+    /// reduction, i.e. an odd number of Subs have it in their RHS.
     void InsertMuls() {
       auto GetMulOperand = [](Value *V) -> Instruction* {
         if (auto *SExt = dyn_cast<SExtInst>(V)) {
@@ -111,19 +126,21 @@ namespace {
         return nullptr;
       };
 
-      auto InsertMul = [this](Instruction *I) {
+      auto InsertMul = [this](Instruction *I, bool Negated) {
         Value *LHS = cast<Instruction>(I->getOperand(0))->getOperand(0);
         Value *RHS = cast<Instruction>(I->getOperand(1))->getOperand(0);
-        Muls.push_back(std::make_unique<MulCandidate>(I, LHS, RHS));
+        Muls.push_back(std::make_unique<MulCandidate>(I, LHS, RHS, Negated));
       };
 
       for (auto *Add : Adds) {
         if (Add == Acc)
           continue;
+        bool Negated = NegatedAdds.count(Add);
+        bool IsSub = Add->getOpcode() == Instruction::Sub;
         if (auto *Mul = GetMulOperand(Add->getOperand(0)))
-          InsertMul(Mul);
+          InsertMul(Mul, Negated);
         if (auto *Mul = GetMulOperand(Add->getOperand(1)))
-          InsertMul(Mul);
+          InsertMul(Mul, Negated != IsSub);
       }
     }
 
@@ -155,7 +172,7 @@ namespace {
     /// parallel.
     bool CreateParallelPairs();
 
-    /// Return the add instruction which is the root of the reduction.
+    /// Return the add or sub instruction which is the root of the reduction.
     Instruction *getRoot() { return Root; }
 
     bool is64Bit() const { return Root->getType()->isIntegerTy(64); }
@@ -222,7 +239,7 @@ namespace {
 
     template<unsigned>
     bool IsNarrowSequence(Value *V);
-    bool Search(Value *V, BasicBlock *BB, Reduction &R);
+    bool Search(Value *V, BasicBlock *BB, Reduction &R, bool Negated = false);
     bool RecordMemoryOps(BasicBlock *BB);
     void InsertParallelMACs(Reduction &Reduction);
     bool AreSequentialLoads(LoadInst *Ld0, LoadInst *Ld1, MemInstList &VecMem);
@@ -233,7 +250,8 @@ namespace {
     /// Dual performs two signed 16x16-bit multiplications. It adds the
     /// products to a 32-bit accumulate operand. Optionally, the instruction can
     /// exchange the halfwords of the second operand before performing the
-    /// arithmetic.
+    /// arithmetic. SMLSD and SMLSDX add the difference of the two products
+    /// instead, and SMLALD(X) and SMLSLD(X) use a 64-bit accumulator.
     bool MatchSMLAD(Function &F);
 
   public:
@@ -408,17 +426,27 @@ bool ARMParallelDSP::RecordMemoryOps(BasicBlock *BB) {
     return true;
   };
 
+  // Only loads from the same underlying object can be consecutive, so bucket
+  // the loads by their object to avoid comparing every pair of loads in large,
+  // unrolled, blocks.
+  MapVector<const Value*, SmallVector<LoadInst*, 8>> LoadsByObject;
+  for (auto *Ld : Loads)
+    LoadsByObject[GetUnderlyingObject(Ld->getPointerOperand(), *DL)]
+      .push_back(Ld);
+
   // Record base, offset load pairs.
-  for (auto *Base : Loads) {
-    for (auto *Offset : Loads) {
-      if (Base == Offset || OffsetLoads.count(Offset))
-        continue;
+  for (auto &Entry : LoadsByObject) {
+    for (auto *Base : Entry.second) {
+      for (auto *Offset : Entry.second) {
+        if (Base == Offset || OffsetLoads.count(Offset))
+          continue;
 
-      if (AreSequentialAccesses<LoadInst>(Base, Offset, *DL, *SE) &&
-          SafeToPair(Base, Offset)) {
-        LoadPairs[Base] = Offset;
-        OffsetLoads.insert(Offset);
-        break;
+        if (AreSequentialAccesses<LoadInst>(Base, Offset, *DL, *SE) &&
+            SafeToPair(Base, Offset)) {
+          LoadPairs[Base] = Offset;
+          OffsetLoads.insert(Offset);
+          break;
+        }
       }
     }
   }
@@ -434,16 +462,19 @@ bool ARMParallelDSP::RecordMemoryOps(BasicBlock *BB) {
 }
 
 // Search recursively back through the operands to find a tree of values that
-// form a multiply-accumulate chain. The search records the Add and Mul
+// form a multiply-accumulate chain. The search records the Add, Sub and Mul
 // instructions that form the reduction and allows us to find a single value
-// to be used as the initial input to the accumlator.
-bool ARMParallelDSP::Search(Value *V, BasicBlock *BB, Reduction &R) {
+// to be used as the initial input to the accumlator. Negated is set when V is
+// subtracted from the reduction.
+bool ARMParallelDSP::Search(Value *V, BasicBlock *BB, Reduction &R,
+                            bool Negated) {
   // If we find a non-instruction, try to use it as the initial accumulator
   // value. This may have already been found during the search in which case
-  // this function will return false, signaling a search fail.
+  // this function will return false, signaling a search fail. The accumulator
+  // is added to the result, so it can't be negated.
   auto *I = dyn_cast<Instruction>(V);
   if (!I)
-    return R.InsertAcc(V);
+    return !Negated && R.InsertAcc(V);
 
   if (I->getParent() != BB)
     return false;
@@ -453,21 +484,25 @@ bool ARMParallelDSP::Search(Value *V, BasicBlock *BB, Reduction &R) {
     break;
   case Instruction::PHI:
     // Could be the accumulator value.
-    return R.InsertAcc(V);
-  case Instruction::Add: {
+    return !Negated && R.InsertAcc(V);
+  case Instruction::Add:
+  case Instruction::Sub: {
     // Adds should be adding together two muls, or another add and a mul to
     // be within the mac chain. One of the operands may also be the
-    // accumulator value at which point we should stop searching.
-    R.InsertAdd(I);
+    // accumulator value at which point we should stop searching. Subs are
+    // the same, except that they negate everything found in their RHS.
+    if (!R.InsertAdd(I, Negated))
+      return false;
     Value *LHS = I->getOperand(0);
     Value *RHS = I->getOperand(1);
-    bool ValidLHS = Search(LHS, BB, R);
-    bool ValidRHS = Search(RHS, BB, R);
+    bool IsSub = I->getOpcode() == Instruction::Sub;
+    bool ValidLHS = Search(LHS, BB, R, Negated);
+    bool ValidRHS = Search(RHS, BB, R, Negated != IsSub);
 
     if (ValidLHS && ValidRHS)
       return true;
 
-    return R.InsertAcc(I);
+    return !Negated && R.InsertAcc(I);
   }
   case Instruction::Mul: {
     Value *MulOp0 = I->getOperand(0);
@@ -475,7 +510,7 @@ bool ARMParallelDSP::Search(Value *V, BasicBlock *BB, Reduction &R) {
     return IsNarrowSequence<16>(MulOp0) && IsNarrowSequence<16>(MulOp1);
   }
   case Instruction::SExt:
-    return Search(I->getOperand(0), BB, R);
+    return Search(I->getOperand(0), BB, R, Negated);
   }
   return false;
 }
@@ -483,7 +518,7 @@ bool ARMParallelDSP::Search(Value *V, BasicBlock *BB, Reduction &R) {
 // The pass needs to identify integer add/sub reductions of 16-bit vector
 // multiplications.
 // To use SMLAD:
-// 1) we first need to find integer add then look for this pattern:
+// 1) we first need to find integer add (or sub) then look for this pattern:
 //
 // acc0 = ...
 // ld0 = load i16
@@ -511,6 +546,9 @@ bool ARMParallelDSP::Search(Value *V, BasicBlock *BB, Reduction &R) {
 // If loop invariants are used instead of loads, these need to be packed
 // before the loop begins.
 //
+// If mul1 is subtracted instead, i.e. acc1 = sub i32 %add0, %mul1, then
+// SMLSD is selected instead of SMLAD.
+//
 bool ARMParallelDSP::MatchSMLAD(Function &F) {
   bool Changed = false;
 
@@ -520,7 +558,8 @@ bool ARMParallelDSP::MatchSMLAD(Function &F) {
       continue;
 
     for (Instruction &I : reverse(BB)) {
-      if (I.getOpcode() != Instruction::Add)
+      if (I.getOpcode() != Instruction::Add &&
+          I.getOpcode() != Instruction::Sub)
         continue;
 
       if (AllAdds.count(&I))
@@ -575,16 +614,31 @@ bool ARMParallelDSP::CreateParallelPairs(Reduction &R) {
     if (Ld0 == Ld2 || Ld1 == Ld3)
       return false;
 
+    // There is no instruction to subtract both products.
+    if (PMul0->Negated && PMul1->Negated)
+      return false;
+
+    // SMLSD subtracts the product of the top halfwords, i.e. the second mul,
+    // so the first mul of a pair that isn't exchanged must not be negated.
+    // Either product can be subtracted with SMLSDX, by swapping its operands.
+    auto TryPair = [&](MulCandidate *Mul0, MulCandidate *Mul1,
+                       bool Exchange) {
+      if (Mul0->Negated && !Exchange) {
+        LLVM_DEBUG(dbgs() << "    but can't subtract the bottom product\n");
+        return false;
+      }
+      R.AddMulPair(Mul0, Mul1, Exchange);
+      return true;
+    };
+
     if (AreSequentialLoads(Ld0, Ld1, PMul0->VecLd)) {
       if (AreSequentialLoads(Ld2, Ld3, PMul1->VecLd)) {
         LLVM_DEBUG(dbgs() << "OK: found two pairs of parallel loads!\n");
-        R.AddMulPair(PMul0, PMul1);
-        return true;
+        return TryPair(PMul0, PMul1, false);
       } else if (AreSequentialLoads(Ld3, Ld2, PMul1->VecLd)) {
         LLVM_DEBUG(dbgs() << "OK: found two pairs of parallel loads!\n");
         LLVM_DEBUG(dbgs() << "    exchanging Ld2 and Ld3\n");
-        R.AddMulPair(PMul0, PMul1, true);
-        return true;
+        return TryPair(PMul0, PMul1, true);
       }
     } else if (AreSequentialLoads(Ld1, Ld0, PMul0->VecLd) &&
                AreSequentialLoads(Ld2, Ld3, PMul1->VecLd)) {
@@ -592,8 +646,7 @@ bool ARMParallelDSP::CreateParallelPairs(Reduction &R) {
       LLVM_DEBUG(dbgs() << "    exchanging Ld0 and Ld1\n");
       LLVM_DEBUG(dbgs() << "    and swapping muls\n");
       // Only the second operand can be exchanged, so swap the muls.
-      R.AddMulPair(PMul1, PMul0, true);
-      return true;
+      return TryPair(PMul1, PMul0, true);
     }
     return false;
   };
@@ -630,13 +683,22 @@ bool ARMParallelDSP::CreateParallelPairs(Reduction &R) {
 void ARMParallelDSP::InsertParallelMACs(Reduction &R) {
 
   auto CreateSMLAD = [&](LoadInst* WideLd0, LoadInst *WideLd1,
-                         Value *Acc, bool Exchange,
+                         Value *Acc, bool Exchange, bool Subtract,
                          Instruction *InsertAfter) {
     // Replace the reduction chain with an intrinsic call
 
     Value* Args[] = { WideLd0, WideLd1, Acc };
     Function *SMLAD = nullptr;
-    if (Exchange)
+    if (Subtract) {
+      if (Exchange)
+        SMLAD = Acc->getType()->isIntegerTy(32) ?
+          Intrinsic::getDeclaration(M, Intrinsic::arm_smlsdx) :
+          Intrinsic::getDeclaration(M, Intrinsic::arm_smlsldx);
+      else
+        SMLAD = Acc->getType()->isIntegerTy(32) ?
+          Intrinsic::getDeclaration(M, Intrinsic::arm_smlsd) :
+          Intrinsic::getDeclaration(M, Intrinsic::arm_smlsld);
+    } else if (Exchange)
       SMLAD = Acc->getType()->isIntegerTy(32) ?
         Intrinsic::getDeclaration(M, Intrinsic::arm_smladx) :
         Intrinsic::getDeclaration(M, Intrinsic::arm_smlaldx);
@@ -648,7 +710,10 @@ void ARMParallelDSP::InsertParallelMACs(Reduction &R) {
     IRBuilder<NoFolder> Builder(InsertAfter->getParent(),
                                 BasicBlock::iterator(InsertAfter));
     Instruction *Call = Builder.CreateCall(SMLAD, Args);
-    NumSMLAD++;
+    if (Subtract)
+      NumSMLSD++;
+    else
+      NumSMLAD++;
     return Call;
   };
 
@@ -689,6 +754,10 @@ void ARMParallelDSP::InsertParallelMACs(Reduction &R) {
 
     if (!Acc) {
       Acc = Mul;
+      if (MulCand->Negated) {
+        Builder.SetInsertPoint(&*++BasicBlock::iterator(Mul));
+        Acc = Builder.CreateNeg(Mul);
+      }
       continue;
     }
 
@@ -696,7 +765,8 @@ void ARMParallelDSP::InsertParallelMACs(Reduction &R) {
     // phi. But the phi will dominate Mul, meaning that Mul will be the
     // insertion point.
     Builder.SetInsertPoint(GetInsertPoint(Mul, Acc));
-    Acc = Builder.CreateAdd(Mul, Acc);
+    Acc = MulCand->Negated ? Builder.CreateSub(Acc, Mul) :
+                             Builder.CreateAdd(Mul, Acc);
   }
 
   if (!Acc) {
@@ -726,9 +796,23 @@ void ARMParallelDSP::InsertParallelMACs(Reduction &R) {
     LoadInst *WideRHS = WideLoads.count(BaseRHS) ?
       WideLoads[BaseRHS]->getLoad() : CreateWideLoad(RHSMul->VecLd, Ty);
 
+    // SMLSD(X) subtracts the product that doesn't use the bottom halfword of
+    // its first operand. If the other product of an exchanged pair is the one
+    // to be subtracted, swap the operands.
+    bool Subtract = LHSMul->Negated != RHSMul->Negated;
+    if (Subtract) {
+      MulCandidate *BottomMul =
+        LHSMul->LHS == BaseLHS || LHSMul->RHS == BaseLHS ? LHSMul : RHSMul;
+      if (BottomMul->Negated) {
+        assert(RHSMul->Exchange && "expected exchanged operands");
+        std::swap(WideLHS, WideRHS);
+      }
+    }
+
     Instruction *InsertAfter = GetInsertPoint(WideLHS, WideRHS);
     InsertAfter = GetInsertPoint(InsertAfter, Acc);
-    Acc = CreateSMLAD(WideLHS, WideRHS, Acc, RHSMul->Exchange, InsertAfter);
+    Acc = CreateSMLAD(WideLHS, WideRHS, Acc, RHSMul->Exchange, Subtract,
+                      InsertAfter);
   }
   R.UpdateRoot(cast<Instruction>(Acc));
 }
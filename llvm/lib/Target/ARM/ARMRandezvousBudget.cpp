@@ -0,0 +1,260 @@
+//===- ARMRandezvousBudget.cpp - ARM Randezvous Section Size Budgeting ----===//
+//
+// Copyright (c) 2021-2022, University of Rochester
+//
+// Part of the Randezvous Project, under the Apache License v2.0 with
+// LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+// information.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains the implementation of the functions that determine how
+// much of each section a module can fill up.
+//
+// By default, every module is allowed to fill up each section to its maximum
+// size.  When a program is built from multiple modules (e.g., multiple
+// translation units or ThinLTO backends), each module can instead be given a
+// share of the maximum size using a two-phase build:
+//
+// * First, every module is compiled with a report file (see
+//   ARMRandezvousReport.cpp); the size of each section used by the module
+//   (before any filler is inserted) is added to the report as a "size"
+//   record.
+//
+// * Then the reports of all modules are concatenated into a budget manifest,
+//   and every module is compiled again with the manifest; the free space of
+//   each section is distributed to the modules in proportion to how much
+//   they use, so that the budgets of all modules add up to the maximum size
+//   of each section.
+//
+// * Lastly, the program is linked with ld.lld --randezvous-fill and the same
+//   maximum sizes.  The modules alone can fall a few bytes short of the
+//   maximum sizes, as each module is padded only as finely as its filler
+//   allows and the linker may insert alignment padding between modules; the
+//   linker appends a padding section of trap instructions (or garbage words)
+//   that tops up each section, so that the final image exactly fills it.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ARMRandezvousBudget.h"
+#include "ARMRandezvousOptions.h"
+#include "ARMRandezvousReport.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <map>
+
+using namespace llvm;
+
+//
+// Function: getRandezvousSectionName()
+//
+// Description:
+//   This function returns the name of a section as used in reports and
+//   budget manifests.
+//
+StringRef
+llvm::getRandezvousSectionName(RandezvousSection Section) {
+  switch (Section) {
+  case RandezvousSection::Text:   return "text";
+  case RandezvousSection::Rodata: return "rodata";
+  case RandezvousSection::Data:   return "data";
+  case RandezvousSection::Bss:    return "bss";
+  }
+  llvm_unreachable("Invalid section!");
+}
+
+//
+// Function: getMaxSectionSize()
+//
+// Description:
+//   This function returns the maximum size of a section of the whole program.
+//
+static uint64_t
+getMaxSectionSize(RandezvousSection Section) {
+  switch (Section) {
+  case RandezvousSection::Text:   return RandezvousMaxTextSize;
+  case RandezvousSection::Rodata: return RandezvousMaxRodataSize;
+  case RandezvousSection::Data:   return RandezvousMaxDataSize;
+  case RandezvousSection::Bss:    return RandezvousMaxBssSize;
+  }
+  llvm_unreachable("Invalid section!");
+}
+
+// Sizes of each section used by each module, as recorded in a budget manifest
+typedef std::map<RandezvousSection, std::map<std::string, uint64_t> >
+BudgetManifest;
+
+//
+// Function: readBudgetManifest()
+//
+// Description:
+//   This function reads the budget manifest and collects the size of each
+//   section used by each module from its "size" records; records of other
+//   kinds are skipped.  If a module shows up more than once for the same
+//   section, the last record wins.
+//
+// Return value:
+//   The sizes of each section (even an unused one) used by each module.
+//
+static BudgetManifest
+readBudgetManifest(void) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
+    MemoryBuffer::getFile(RandezvousBudgetManifest);
+  if (!Buffer) {
+    report_fatal_error(Twine("[Budget] Cannot read ") +
+                       RandezvousBudgetManifest + ": " +
+                       Buffer.getError().message());
+  }
+
+  const RandezvousSection Sections[] = {
+    RandezvousSection::Text,
+    RandezvousSection::Rodata,
+    RandezvousSection::Data,
+    RandezvousSection::Bss,
+  };
+  BudgetManifest Manifest;
+  for (RandezvousSection Section : Sections) {
+    Manifest[Section].clear();
+  }
+
+  SmallVector<StringRef, 64> Lines;
+  (*Buffer)->getBuffer().split(Lines, '\n', -1, false);
+  for (unsigned i = 0; i < Lines.size(); ++i) {
+    StringRef Line = Lines[i].trim();
+    if (Line.empty()) {
+      continue;
+    }
+
+    Expected<json::Value> Record = json::parse(Line);
+    if (!Record) {
+      report_fatal_error(Twine("[Budget] ") + RandezvousBudgetManifest + ":" +
+                         Twine(i + 1) + ": " + toString(Record.takeError()));
+    }
+    const json::Object * Obj = Record->getAsObject();
+    if (Obj && Obj->getString("kind") != StringRef("size")) {
+      continue;
+    }
+    Optional<StringRef> ModuleID = Obj ? Obj->getString("module") : None;
+    Optional<StringRef> Name = Obj ? Obj->getString("section") : None;
+    Optional<int64_t> Size = Obj ? Obj->getInteger("size") : None;
+    if (!ModuleID || !Name || !Size || *Size < 0) {
+      report_fatal_error(Twine("[Budget] ") + RandezvousBudgetManifest + ":" +
+                         Twine(i + 1) + ": Malformed record");
+    }
+
+    for (RandezvousSection Section : Sections) {
+      if (*Name == getRandezvousSectionName(Section)) {
+        Manifest[Section][ModuleID->str()] = *Size;
+      }
+    }
+  }
+
+  return Manifest;
+}
+
+//
+// Function: getBudgetManifestSizes()
+//
+// Description:
+//   This function returns the size of a given section used by each module
+//   listed in the budget manifest.  The budget manifest is read only once, as
+//   passes query it for every module and every section.
+//
+// Input:
+//   Section - The section of interest.
+//
+// Return value:
+//   A const reference to a map from module identifiers to section sizes.
+//
+static const std::map<std::string, uint64_t> &
+getBudgetManifestSizes(RandezvousSection Section) {
+  static const BudgetManifest Manifest = readBudgetManifest();
+  return Manifest.at(Section);
+}
+
+//
+// Function: getRandezvousBudget()
+//
+// Description:
+//   This function computes how many bytes of a section a module is allowed to
+//   fill up, including what the module already uses.  Without a budget
+//   manifest, this is the maximum size of the section.  With a budget
+//   manifest, the free space of the section is distributed to all modules
+//   listed in the manifest in proportion to their used sizes, in units of 4
+//   bytes; the module that comes first in the manifest's sorted order also
+//   takes the remainder so that the budgets add up to the maximum size.
+//
+// Inputs:
+//   M       - A const reference to the Module.
+//   Section - The section of interest.
+//
+// Return value:
+//   The budget (in bytes) of the section for the Module.
+//
+uint64_t
+llvm::getRandezvousBudget(const Module & M, RandezvousSection Section) {
+  uint64_t MaxSize = getMaxSectionSize(Section);
+  if (RandezvousBudgetManifest.empty()) {
+    return MaxSize;
+  }
+
+  const std::map<std::string, uint64_t> & Sizes =
+    getBudgetManifestSizes(Section);
+  if (Sizes.count(M.getModuleIdentifier()) == 0) {
+    report_fatal_error(Twine("[Budget] No ") + getRandezvousSectionName(Section) +
+                       " size recorded for " + M.getModuleIdentifier());
+  }
+
+  uint64_t TotalSize = 0;
+  for (const auto & ModuleSize : Sizes) {
+    TotalSize += ModuleSize.second;
+  }
+  if (TotalSize > MaxSize) {
+    report_fatal_error(Twine("[Budget] Total ") + getRandezvousSectionName(Section) +
+                       " size exceeds the limit");
+  }
+
+  // Distribute the free space; if no module uses the section at all,
+  // distribute it evenly
+  uint64_t FreeSize = MaxSize - TotalSize;
+  uint64_t Distributed = 0;
+  uint64_t Budget = 0;
+  for (const auto & ModuleSize : Sizes) {
+    uint64_t Share = TotalSize == 0 ? FreeSize / Sizes.size() :
+                                      FreeSize * ModuleSize.second / TotalSize;
+    Share = alignDown(Share, 4);
+    Distributed += Share;
+    if (ModuleSize.first == M.getModuleIdentifier()) {
+      Budget = ModuleSize.second + Share;
+    }
+  }
+  if (Sizes.begin()->first == M.getModuleIdentifier()) {
+    Budget += FreeSize - Distributed;
+  }
+
+  return Budget;
+}
+
+//
+// Function: recordRandezvousSectionSize()
+//
+// Description:
+//   This function adds the size of a section used by a module to the report
+//   of a pass, if a report file is requested.
+//
+// Inputs:
+//   Report  - A reference to the report of the pass.
+//   Section - The section of interest.
+//   Size    - The size (in bytes) of the section used by the Module.
+//
+void
+llvm::recordRandezvousSectionSize(RandezvousPassReport & Report,
+                                  RandezvousSection Section, uint64_t Size) {
+  Report.addRecord("size", json::Object {
+    { "section", getRandezvousSectionName(Section) },
+    { "size", static_cast<int64_t>(Size) },
+  });
+}
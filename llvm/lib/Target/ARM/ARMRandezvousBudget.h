@@ -0,0 +1,40 @@
+//===- ARMRandezvousBudget.h - ARM Randezvous Section Size Budgeting ------===//
+//
+// Copyright (c) 2021-2022, University of Rochester
+//
+// Part of the Randezvous Project, under the Apache License v2.0 with
+// LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+// information.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the functions that determine how much of each section a
+// module can fill up, either on its own or as one of many modules linked into
+// a single program.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef ARM_RANDEZVOUS_BUDGET
+#define ARM_RANDEZVOUS_BUDGET
+
+#include "llvm/IR/Module.h"
+
+namespace llvm {
+  class RandezvousPassReport;
+
+  enum class RandezvousSection {
+    Text,
+    Rodata,
+    Data,
+    Bss,
+  };
+
+  StringRef getRandezvousSectionName(RandezvousSection Section);
+
+  uint64_t getRandezvousBudget(const Module & M, RandezvousSection Section);
+
+  void recordRandezvousSectionSize(RandezvousPassReport & Report,
+                                   RandezvousSection Section, uint64_t Size);
+}
+
+#endif
@@ -13,22 +13,39 @@
 //
 //===----------------------------------------------------------------------===//
 
-#define DEBUG_TYPE "arm-randezvous-clr"
-
+#include "ARMBasicBlockInfo.h"
+#include "ARMRandezvousBudget.h"
 #include "ARMRandezvousCLR.h"
+#include "ARMRandezvousLeakability.h"
 #include "ARMRandezvousOptions.h"
+#include "ARMRandezvousReport.h"
+#include "ARMRandezvousTiering.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
+#include "llvm/CodeGen/MachineBranchProbabilityInfo.h"
+#include "llvm/CodeGen/MachineDominators.h"
+#include "llvm/CodeGen/MachineJumpTableInfo.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
 #include "llvm/CodeGen/MachineModuleInfo.h"
 #include "llvm/IR/IRBuilder.h"
 
+#define DEBUG_TYPE "arm-randezvous-clr"
+
 using namespace llvm;
 
 char ARMRandezvousCLR::ID = 0;
 
 STATISTIC(NumTraps, "Number of trap instructions inserted");
+STATISTIC(NumTrapBlocks, "Number of trap blocks inserted");
+STATISTIC(NumLongBranchesAvoided, "Number of branches kept in range by limiting trap instructions");
+STATISTIC(NumTrapsMoved, "Number of trap instructions moved away from short branches");
+STATISTIC(NumTrapsAtEnd, "Number of trap instructions moved to function ends to keep branches in range");
 STATISTIC(NumFuncsBBLR, "Number of functions with basic blocks reordered");
 STATISTIC(NumJumps4BBLR, "Number of jump instructions inserted due to BBLR");
 STATISTIC(NumFuncsBBCLR, "Number of functions with basic block clusters reordered");
+STATISTIC(NumFallThrusKept, "Number of hot fall-throughs kept by profile-guided BBLR");
+STATISTIC(NumDynJumps4BBLR, "Estimated number of dynamic jumps added due to BBLR");
+STATISTIC(NumDynJumpsAvoided, "Estimated number of dynamic jumps avoided by profile-guided BBLR");
 
 ARMRandezvousCLR::ARMRandezvousCLR(bool LateStage)
     : ModulePass(ID), LateStage(LateStage) {
@@ -44,6 +61,16 @@ ARMRandezvousCLR::getAnalysisUsage(AnalysisUsage & AU) const {
   // We need this to access MachineFunctions
   AU.addRequired<MachineModuleInfoWrapperPass>();
 
+  // We need this to compute block frequencies for profile-guided BBLR
+  AU.addRequired<MachineBranchProbabilityInfo>();
+
+  // We need this to choose the protection tier of each function
+  AU.addRequired<ProfileSummaryInfoWrapperPass>();
+
+  // Function leakability does not change; block leakability is dropped after
+  // reordering
+  AU.addPreserved<ARMRandezvousLeakability>();
+
   AU.setPreservesCFG();
   ModulePass::getAnalysisUsage(AU);
 }
@@ -100,6 +127,182 @@ ARMRandezvousCLR::shuffleMachineBasicBlocks(MachineFunction & MF) {
   ++NumFuncsBBLR;
 }
 
+//
+// Function: getDynamicEdgeCount()
+//
+// Description:
+//   This function estimates how many times a control-flow edge is taken.  If
+//   the function has profile data, the estimate is for the whole profiled run;
+//   otherwise it is for a single invocation of the function.
+//
+// Inputs:
+//   MBFI - A reference to the block frequency info of the MachineFunction.
+//   MBPI - A reference to the branch probability info.
+//   MBB  - A reference to the source MachineBasicBlock of the edge.
+//   Succ - A reference to the destination MachineBasicBlock of the edge.
+//
+// Return value:
+//   The estimated number of times that the edge is taken.
+//
+static uint64_t
+getDynamicEdgeCount(const MachineBlockFrequencyInfo & MBFI,
+                    const MachineBranchProbabilityInfo & MBPI,
+                    const MachineBasicBlock & MBB,
+                    const MachineBasicBlock & Succ) {
+  BranchProbability Prob = MBPI.getEdgeProbability(&MBB, &Succ);
+  if (Optional<uint64_t> Count = MBFI.getBlockProfileCount(&MBB)) {
+    return Prob.scale(*Count);
+  }
+
+  // Round to the nearest number of times per invocation
+  uint64_t EntryFreq = MBFI.getEntryFreq();
+  uint64_t EdgeFreq = Prob.scale(MBFI.getBlockFreq(&MBB).getFrequency());
+  return EdgeFreq / EntryFreq + (EdgeFreq % EntryFreq >= (EntryFreq + 1) / 2);
+}
+
+//
+// Function: getDynamicFallThroughCount()
+//
+// Description:
+//   This function estimates how many times fall-through edges are taken in a
+//   MachineFunction, i.e., how many dynamic jumps BBLR adds to it.  See
+//   getDynamicEdgeCount() for what the estimate is for.
+//
+// Inputs:
+//   MF   - A reference to the MachineFunction.
+//   MBPI - A reference to the branch probability info.
+//
+// Return value:
+//   The estimated number of times that fall-through edges are taken.
+//
+static uint64_t
+getDynamicFallThroughCount(MachineFunction & MF,
+                           const MachineBranchProbabilityInfo & MBPI) {
+  MachineDominatorTree MDT(MF);
+  MachineLoopInfo MLI(MDT);
+  MachineBlockFrequencyInfo MBFI;
+  MBFI.calculate(MF, MBPI, MLI);
+
+  uint64_t DynCount = 0;
+  for (MachineBasicBlock & MBB : MF) {
+    MachineBasicBlock * FallThruMBB = MBB.getFallThrough();
+    if (FallThruMBB != nullptr) {
+      DynCount += getDynamicEdgeCount(MBFI, MBPI, MBB, *FallThruMBB);
+    }
+  }
+  return DynCount;
+}
+
+//
+// Method: shuffleMachineBasicBlockChains()
+//
+// Description:
+//   This method is a profile-guided variant of shuffleMachineBasicBlocks().
+//   Instead of taking apart every fall-through block, it keeps each hot
+//   fall-through edge (one whose frequency is at least a given percentage of
+//   the entry frequency) so that hot paths do not pay for extra taken
+//   branches.  Basic blocks linked by hot fall-through edges form chains, and
+//   all the chains except the entry chain are shuffled; cold blocks form
+//   chains of their own and are therefore shuffled just as with BBLR.
+//
+//   Block frequencies come from MachineBlockFrequencyInfo, which uses branch
+//   weights from PGO profiles if there are any and static heuristics
+//   otherwise.
+//
+// Input:
+//   MF - A reference to the MachineFunction.
+//
+// Output:
+//   MF - The transformed MachineFunction.
+//
+// Return value:
+//   The estimated number of dynamic jumps added.
+//
+uint64_t
+ARMRandezvousCLR::shuffleMachineBasicBlockChains(MachineFunction & MF) {
+  // Shuffling has no effect on functions with fewer than 3 MachineBasicBlocks
+  // (because we are not reordering the entry block)
+  if (MF.size() < 3) {
+    return 0;
+  }
+
+  // Compute block frequencies; this pass is not a MachineFunctionPass, so we
+  // have to build the analyses on our own
+  const MachineBranchProbabilityInfo & MBPI =
+    getAnalysis<MachineBranchProbabilityInfo>();
+  MachineDominatorTree MDT(MF);
+  MachineLoopInfo MLI(MDT);
+  MachineBlockFrequencyInfo MBFI;
+  MBFI.calculate(MF, MBPI, MLI);
+
+  // Break the MachineFunction into chains at cold fall-through edges, adding
+  // an unconditional branch to each MachineBasicBlock that falls through to a
+  // different chain
+  std::vector<std::vector<MachineBasicBlock *> > Chains;
+  std::vector<MachineBasicBlock *> CurrentChain;
+  uint64_t DynJumps = 0;
+  const TargetInstrInfo * TII = MF.getSubtarget().getInstrInfo();
+  for (MachineBasicBlock & MBB : MF) {
+    CurrentChain.push_back(&MBB);
+
+    MachineBasicBlock * FallThruMBB = MBB.getFallThrough();
+    if (FallThruMBB != nullptr) {
+      // An edge is hot if it is taken at least a given percentage of times
+      // the function is invoked, unless the profile says it is never taken
+      uint64_t DynCount = getDynamicEdgeCount(MBFI, MBPI, MBB, *FallThruMBB);
+      BlockFrequency EdgeFreq = MBFI.getBlockFreq(&MBB) *
+                                MBPI.getEdgeProbability(&MBB, FallThruMBB);
+      double RelFreq = static_cast<double>(EdgeFreq.getFrequency()) /
+                       MBFI.getEntryFreq();
+      Optional<uint64_t> Count = MBFI.getBlockProfileCount(&MBB);
+      bool IsHot = RelFreq * 100 >= RandezvousBBLRHotThreshold &&
+                   EdgeFreq.getFrequency() != 0 && (!Count || *Count != 0);
+      if (IsHot) {
+        ++NumFallThrusKept;
+        NumDynJumpsAvoided += DynCount;
+        continue;
+      }
+
+      BuildMI(MBB, MBB.end(), DebugLoc(), TII->get(ARM::t2B))
+      .addMBB(FallThruMBB)
+      .add(predOps(ARMCC::AL));
+      ++NumJumps4BBLR;
+      NumDynJumps4BBLR += DynCount;
+      DynJumps += DynCount;
+    }
+
+    Chains.push_back(std::move(CurrentChain));
+    CurrentChain.clear();
+  }
+  if (!CurrentChain.empty()) {
+    Chains.push_back(std::move(CurrentChain));
+  }
+
+  // Shuffling has no effect on functions with fewer than 3 chains (because we
+  // are not reordering the entry chain)
+  if (Chains.size() < 3) {
+    return DynJumps;
+  }
+
+  // Now do shuffling; ilist (iplist_impl) does not support iterator
+  // increment/decrement so we have to first do out-of-place shuffling and then
+  // do in-place removal and insertion
+  auto & MBBList = (&MF)->*(MachineFunction::getSublistAccess)(nullptr);
+  llvm::shuffle(Chains.begin() + 1, Chains.end(), *RNG);
+  for (auto & Chain : Chains) {
+    for (MachineBasicBlock * MBB : Chain) {
+      MBBList.remove(MBB);
+    }
+  }
+  for (auto & Chain : Chains) {
+    for (MachineBasicBlock * MBB : Chain) {
+      MBBList.push_back(MBB);
+    }
+  }
+  ++NumFuncsBBLR;
+  return DynJumps;
+}
+
 //
 // Method: shuffleMachineBasicBlockClusters()
 //
@@ -162,24 +365,310 @@ ARMRandezvousCLR::shuffleMachineBasicBlockClusters(MachineFunction & MF) {
   }
 }
 
+//
+// Function: getBranchRange()
+//
+// Description:
+//   This function finds out how far a Thumb branch instruction can reach
+//   before a later pass has to rewrite it into a longer instruction sequence
+//   or add a branch island for it: the constant island pass for direct
+//   branches and jump tables, and the low-overhead loop pass for loop
+//   branches.  A 32-bit branch going out of the range of its 16-bit form
+//   only costs 2 bytes, so that range does not count.
+//
+// Inputs:
+//   MI - A const reference to the branch instruction.
+//
+// Outputs:
+//   Range        - The maximum displacement of the branch.
+//   ForwardOnly  - Whether the branch can only jump forward.
+//   BackwardOnly - Whether the branch can only jump backward.
+//
+// Return value:
+//   true  - The instruction is a branch that we know about.
+//   false - The instruction is not a branch that we know about.
+//
+static bool
+getBranchRange(const MachineInstr & MI, unsigned & Range, bool & ForwardOnly,
+               bool & BackwardOnly) {
+  ForwardOnly = false;
+  BackwardOnly = false;
+  switch (MI.getOpcode()) {
+  case ARM::tB:
+    // Thumb1 only; an out-of-range B becomes a BL
+    Range = ((1 << 10) - 1) * 2;
+    return true;
+
+  case ARM::t2B:
+    Range = ((1 << 23) - 1) * 2;
+    return true;
+
+  case ARM::tBcc:
+    // Thumb1 only; an out-of-range B<c> gets inverted to skip over a B
+    Range = ((1 << 7) - 1) * 2;
+    return true;
+
+  case ARM::t2Bcc:
+    Range = ((1 << 19) - 1) * 2;
+    return true;
+
+  case ARM::tCBZ:
+  case ARM::tCBNZ:
+    // CBZ/CBNZ have no long form; the constant island pass turns them into a
+    // compare and a conditional branch if they go out of range
+    Range = 126;
+    ForwardOnly = true;
+    return true;
+
+  case ARM::tBR_JTr:
+  case ARM::t2BR_JT:
+  case ARM::t2TBB_JT:
+  case ARM::t2TBH_JT:
+    // A jump table becomes a TBH (or a TBB) if all its targets are in range;
+    // otherwise it stays a table of addresses loaded by a longer sequence.
+    // A TBB becoming a TBH only doubles the size of the table.
+    Range = ((1 << 16) - 1) * 2;
+    ForwardOnly = true;
+    return true;
+
+  case ARM::t2WhileLoopStart:
+    // WLS and LE have 12-bit offsets; the low-overhead loop pass reverts the
+    // loop to a compare and a conditional branch if they go out of range
+    Range = 4094;
+    ForwardOnly = true;
+    return true;
+
+  case ARM::t2LoopEnd:
+    Range = 4094;
+    BackwardOnly = true;
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+//
+// Method: limitTrapsByBranchRange()
+//
+// Description:
+//   This method reduces the numbers of trap instructions to insert at
+//   insertion points that lie between a branch and its target, so that the
+//   branch does not have to be rewritten or get a branch island because of
+//   trap instructions.  Trap instructions taken away from such points are
+//   moved to points that no branch spans; if every point is spanned, they
+//   are spread over the points that can still take more, and whatever does
+//   not fit is left for the caller to place after the last basic block.
+//
+//   Capping trap instructions makes their placement less random, so only
+//   ranges whose overflow costs more than a wider encoding are respected.
+//
+// Inputs:
+//   MF     - A reference to the MachineFunction.
+//   Pts    - A reference to the insertion points in layout order.
+//   Shares - A reference to the numbers of trap instructions to insert at
+//            each insertion point.
+//
+// Output:
+//   Shares - The adjusted numbers of trap instructions to insert.
+//
+// Return value:
+//   The number of trap instructions that no insertion point can take.
+//
+uint64_t
+ARMRandezvousCLR::limitTrapsByBranchRange(MachineFunction & MF,
+                                          std::vector<MachineBasicBlock *> & Pts,
+                                          std::vector<uint64_t> & Shares) {
+  // Estimate the offsets of basic blocks and instructions
+  ARMBasicBlockUtils BBUtils(MF);
+  BBUtils.computeAllBlockSizes();
+  BBUtils.adjustBBOffsetsAfter(&MF.front());
+
+  // Find out the layout position of each basic block
+  DenseMap<const MachineBasicBlock *, unsigned> Positions;
+  for (MachineBasicBlock & MBB : MF) {
+    unsigned Position = Positions.size();
+    Positions[&MBB] = Position;
+  }
+
+  uint64_t NumTrapsBefore = 0;
+  for (uint64_t Share : Shares) {
+    NumTrapsBefore += Share;
+  }
+
+  // Find the insertion points between each branch and each of its targets,
+  // and how many trap instructions they can take in total
+  struct BranchSpan {
+    std::vector<uint64_t> Between;
+    uint64_t MaxTrapInsts;
+  };
+  std::vector<BranchSpan> Spans;
+  std::vector<bool> Spanned(Pts.size(), false);
+  const MachineJumpTableInfo * MJTI = MF.getJumpTableInfo();
+  for (MachineBasicBlock & MBB : MF) {
+    for (MachineInstr & MI : MBB.terminators()) {
+      unsigned Range;
+      bool ForwardOnly, BackwardOnly;
+      if (!getBranchRange(MI, Range, ForwardOnly, BackwardOnly)) {
+        continue;
+      }
+
+      SmallPtrSet<MachineBasicBlock *, 8> Targets;
+      for (const MachineOperand & MO : MI.operands()) {
+        if (MO.isMBB()) {
+          Targets.insert(MO.getMBB());
+          break;
+        }
+        if (MO.isJTI() && MJTI != nullptr) {
+          const auto & JTBBs = MJTI->getJumpTables()[MO.getIndex()].MBBs;
+          Targets.insert(JTBBs.begin(), JTBBs.end());
+          break;
+        }
+      }
+
+      for (MachineBasicBlock * Target : Targets) {
+        // Compute the distance in the same way as the constant island pass
+        unsigned BrOffset = BBUtils.getOffsetOf(&MI) + 4;
+        unsigned DestOffset = BBUtils.getOffsetOf(Target);
+        bool Forward = DestOffset >= BrOffset;
+        unsigned Distance = Forward ? DestOffset - BrOffset
+                                    : BrOffset - DestOffset;
+        if ((ForwardOnly && !Forward) || (BackwardOnly && Forward)) {
+          continue;
+        }
+        if (Distance > Range) {
+          continue;
+        }
+
+        // Trap instructions go right after their insertion points, so an
+        // insertion point lies between the branch and its target if it is at
+        // or after the branch but before the target (forward), or at or after
+        // the target but before the branch (backward)
+        BranchSpan Span;
+        Span.MaxTrapInsts = (Range - Distance) / 4;
+        unsigned Lo = Forward ? Positions[&MBB] : Positions[Target];
+        unsigned Hi = Forward ? Positions[Target] : Positions[&MBB];
+        for (uint64_t i = 0; i < Pts.size(); ++i) {
+          unsigned Position = Positions[Pts[i]];
+          if (Position >= Lo && Position < Hi) {
+            Span.Between.push_back(i);
+            Spanned[i] = true;
+          }
+        }
+        Spans.push_back(std::move(Span));
+      }
+    }
+  }
+
+  // Scale down the numbers of trap instructions between each branch and its
+  // target; this never breaks the limits of branches handled earlier
+  for (BranchSpan & Span : Spans) {
+    uint64_t NumTrapInsts = 0;
+    for (uint64_t i : Span.Between) {
+      NumTrapInsts += Shares[i];
+    }
+    if (NumTrapInsts > Span.MaxTrapInsts) {
+      for (uint64_t i : Span.Between) {
+        Shares[i] = Shares[i] * Span.MaxTrapInsts / NumTrapInsts;
+      }
+      ++NumLongBranchesAvoided;
+    }
+  }
+
+  uint64_t NumTrapsAfter = 0;
+  for (uint64_t Share : Shares) {
+    NumTrapsAfter += Share;
+  }
+  uint64_t Surplus = NumTrapsBefore - NumTrapsAfter;
+
+  // Move the trap instructions taken away to insertion points that no branch
+  // spans, so that they do not push any branch out of range
+  std::vector<uint64_t> Unspanned;
+  for (uint64_t i = 0; i < Pts.size(); ++i) {
+    if (!Spanned[i]) {
+      Unspanned.push_back(i);
+    }
+  }
+  if (!Unspanned.empty()) {
+    for (uint64_t j = 0; j < Surplus; ++j) {
+      ++Shares[Unspanned[(*RNG)() % Unspanned.size()]];
+    }
+    NumTrapsMoved += Surplus;
+    return 0;
+  }
+
+  // Every insertion point is spanned, so hand out the trap instructions
+  // taken away in random amounts to random points that still have room
+  while (Surplus != 0) {
+    std::vector<uint64_t> Room(Pts.size(), ~0ull);
+    for (BranchSpan & Span : Spans) {
+      uint64_t NumTrapInsts = 0;
+      for (uint64_t i : Span.Between) {
+        NumTrapInsts += Shares[i];
+      }
+      uint64_t Left = Span.MaxTrapInsts - NumTrapInsts;
+      for (uint64_t i : Span.Between) {
+        Room[i] = std::min(Room[i], Left);
+      }
+    }
+
+    std::vector<uint64_t> Candidates;
+    for (uint64_t i = 0; i < Pts.size(); ++i) {
+      if (Room[i] != 0) {
+        Candidates.push_back(i);
+      }
+    }
+    if (Candidates.empty()) {
+      break;
+    }
+
+    uint64_t i = Candidates[(*RNG)() % Candidates.size()];
+    uint64_t Num = std::min(Surplus, 1 + (*RNG)() % Room[i]);
+    Shares[i] += Num;
+    Surplus -= Num;
+    NumTrapsMoved += Num;
+  }
+
+  // Whatever is left would push some branch out of range
+  if (Surplus != 0) {
+    LLVM_DEBUG(dbgs() << "Moving " << Surplus << " trap instructions in "
+                      << MF.getName() << " to the end to keep branches in "
+                      << "range\n");
+    NumTrapsAtEnd += Surplus;
+  }
+  return Surplus;
+}
+
 //
 // Method: insertTrapBlocks()
 //
 // Description:
-//   This method inserts a given number of trap instructions into a Function
-//   and keeps track of each inserted trap instruction as a single basic block.
+//   This method inserts a given number of trap instructions into a Function.
+//   Trap instructions inserted at the same insertion point are grouped into a
+//   single trap block (a trap region) instead of one basic block per trap
+//   instruction; consumers of trap blocks address an individual trap
+//   instruction by its offset from the start of the trap block.  Trap
+//   instructions inserted before the late stage shuffles basic blocks still
+//   get one basic block each, so that grouping does not cut down the number
+//   of basic blocks that BBLR or BBCLR shuffles.
 //
 // Inputs:
 //   F            - A reference to the Function.
 //   MF           - A reference to the MachineFunction to which F corresponds.
 //   NumTrapInsts - Total number of trap instructions to insert.
 //
-// Output:
-//   MF - The transformed MachineFunction.
+// Outputs:
+//   MF       - The transformed MachineFunction.
+//   NumAtEnd - The number of trap instructions placed after the last basic
+//              block because no insertion point could take them without
+//              pushing a branch out of range.
 //
-void
+// Return value:
+//   The number of trap instructions actually inserted.
+//
+uint64_t
 ARMRandezvousCLR::insertTrapBlocks(Function & F, MachineFunction & MF,
-                                   uint64_t NumTrapInsts) {
+                                   uint64_t NumTrapInsts, uint64_t & NumAtEnd) {
   LLVMContext & Ctx = F.getContext();
   const TargetInstrInfo * TII = MF.getSubtarget().getInstrInfo();
 
@@ -192,11 +681,19 @@ ARMRandezvousCLR::insertTrapBlocks(Function & F, MachineFunction & MF,
   // In LLVM IR, simply place trap blocks at the end of the Function.
   //
 
-  // Determine where to insert trap instructions
+  // Determine where to insert trap instructions; functions that ask for no
+  // layout changes get trap instructions only after their last basic block,
+  // since they may rely on the relative placement of their basic blocks
   std::vector<MachineBasicBlock *> InsertionPts;
-  for (MachineBasicBlock & MBB : MF) {
-    if (!MBB.canFallThrough() && !MBB.isRandezvousTrapBlock()) {
-      InsertionPts.push_back(&MBB);
+  if (hasRandezvousOption(F, "no-layout")) {
+    if (!MF.back().canFallThrough()) {
+      InsertionPts.push_back(&MF.back());
+    }
+  } else {
+    for (MachineBasicBlock & MBB : MF) {
+      if (!MBB.canFallThrough() && !MBB.isRandezvousTrapBlock()) {
+        InsertionPts.push_back(&MBB);
+      }
     }
   }
 
@@ -210,26 +707,55 @@ ARMRandezvousCLR::insertTrapBlocks(Function & F, MachineFunction & MF,
   for (uint64_t i = 0; i < InsertionPts.size(); ++i) {
     Shares[i] = Shares[i] * NumTrapInsts / SumShares;
   }
+  NumAtEnd = 0;
+  if (EnableRandezvousCLRBranchRange) {
+    NumAtEnd = limitTrapsByBranchRange(MF, InsertionPts, Shares);
+  }
+
+  // No branch spans the end of the function, so trap instructions that fit
+  // nowhere else go after the last basic block
+  if (NumAtEnd != 0) {
+    InsertionPts.push_back(&MF.back());
+    Shares.push_back(NumAtEnd);
+  }
+
+  // Group trap instructions unless basic blocks will be shuffled later
+  bool WillShuffle = !LateStage && !hasRandezvousOption(F, "no-layout") &&
+                     (EnableRandezvousBBLR || EnableRandezvousPGBBLR ||
+                      EnableRandezvousBBCLR);
+  uint64_t TrapsPerBlock = WillShuffle ? 1 : UINT64_MAX;
 
   // Do insertion
+  uint64_t NumInserted = 0;
   for (uint64_t i = 0; i < InsertionPts.size(); ++i) {
-    for (uint64_t j = 0; j < Shares[i]; ++j) {
+    MachineBasicBlock * InsertionPt = InsertionPts[i];
+    for (uint64_t Left = Shares[i]; Left != 0; ) {
+      uint64_t Num = std::min(Left, TrapsPerBlock);
+
       // Build an IR basic block
       BasicBlock * BB = BasicBlock::Create(Ctx, "", &F);
       IRBuilder<> IRB(BB);
       IRB.CreateUnreachable();
 
-      // Build a machine IR basic block
+      // Build a machine IR basic block that holds the trap instructions
       MachineBasicBlock * MBB = MF.CreateMachineBasicBlock(BB);
-      BuildMI(MBB, DebugLoc(), TII->get(ARM::t2UDF_ga)).addImm(0);
+      for (uint64_t j = 0; j < Num; ++j) {
+        BuildMI(MBB, DebugLoc(), TII->get(ARM::t2UDF_ga)).addImm(0);
+      }
       MF.push_back(MBB);
-      MBB->moveAfter(InsertionPts[i]);
+      MBB->moveAfter(InsertionPt);
       MBB->setHasAddressTaken();
       MBB->setIsRandezvousTrapBlock();
+      InsertionPt = MBB;
 
-      ++NumTraps;
+      ++NumTrapBlocks;
+      NumTraps += Num;
+      NumInserted += Num;
+      Left -= Num;
     }
   }
+
+  return NumInserted;
 }
 
 //
@@ -258,8 +784,13 @@ ARMRandezvousCLR::runOnModule(Module & M) {
   }
 
   MachineModuleInfo & MMI = getAnalysis<MachineModuleInfoWrapperPass>().getMMI();
-  Twine RNGName = getPassName() + "-" + Twine(RandezvousCLRSeed);
-  RNG = M.createRNG(RNGName.str());
+  ProfileSummaryInfo * PSI =
+    &getAnalysis<ProfileSummaryInfoWrapperPass>().getPSI();
+  const MachineBranchProbabilityInfo & MBPI =
+    getAnalysis<MachineBranchProbabilityInfo>();
+  const char * Stage = LateStage ? "-late" : "-early";
+  RandezvousPassReport Report(Twine("clr") + Stage);
+  Report.beginModule(M, MMI);
 
   // First, shuffle the order of basic blocks in each function (if requested
   // and at the late stage) and calculate how much space existing functions
@@ -273,10 +804,33 @@ ARMRandezvousCLR::runOnModule(Module & M) {
     }
 
     if (LateStage) {
-      if (EnableRandezvousBBLR) {
+      // Hot functions in the reduced tier keep hot fall-through edges even
+      // if plain BBLR is requested, while functions asking for full
+      // protection get plain BBLR even if profile-guided BBLR is requested
+      RandezvousTier Tier = getRandezvousTier(F, PSI);
+      bool UsePGBBLR =
+        (EnableRandezvousPGBBLR && !hasRandezvousOption(F, "full")) ||
+        (EnableRandezvousBBLR && Tier == RandezvousTier::Reduced);
+      bool UseBBLR = EnableRandezvousBBLR || EnableRandezvousPGBBLR;
+      RNG = createRandezvousRNG(RandezvousCLRSeed, getPassName() + "-layout",
+                                F);
+      if (hasRandezvousOption(F, "no-layout")) {
+        recordRandezvousOverhead(Report, F, Tier, "none", 0);
+      } else if (UsePGBBLR) {
+        uint64_t DynJumps = shuffleMachineBasicBlockChains(*MF);
+        recordRandezvousOverhead(Report, F, Tier, "pg-bblr", DynJumps);
+      } else if (UseBBLR) {
+        // Estimate the dynamic jumps before shuffling takes apart every
+        // fall-through edge, so that BBLR compares with profile-guided BBLR
+        if (AreStatisticsEnabled() || Report.isEnabled()) {
+          uint64_t DynJumps = getDynamicFallThroughCount(*MF, MBPI);
+          NumDynJumps4BBLR += DynJumps;
+          recordRandezvousOverhead(Report, F, Tier, "bblr", DynJumps);
+        }
         shuffleMachineBasicBlocks(*MF);
       } else if (EnableRandezvousBBCLR) {
         shuffleMachineBasicBlockClusters(*MF);
+        recordRandezvousOverhead(Report, F, Tier, "bbclr", 0);
       }
     }
 
@@ -286,14 +840,25 @@ ARMRandezvousCLR::runOnModule(Module & M) {
       TotalTextSize += TextSize;
     }
   }
-  assert(TotalTextSize <= RandezvousMaxTextSize && "Text size exceeds the limit");
+
+  // Record how much text the module uses before any trap instruction is
+  // inserted, and find out how much text the module is allowed to fill up
+  if (!LateStage) {
+    recordRandezvousSectionSize(Report, RandezvousSection::Text,
+                                TotalTextSize);
+  }
+  uint64_t MaxTextSize = getRandezvousBudget(M, RandezvousSection::Text);
+  assert(TotalTextSize <= MaxTextSize && "Text size exceeds the limit");
 
   if (LateStage) {
     // Second, shuffle the order of functions; SymbolTableList (iplist_impl)
     // does not support iterator increment/decrement so we have to first do
     // out-of-place shuffling and then do in-place removal and insertion
     SymbolTableList<Function> & FunctionList = M.getFunctionList();
-    llvm::shuffle(Functions.begin(), Functions.end(), *RNG);
+    shuffleGlobalValues(Functions, RandezvousCLRSeed, getPassName() + "-order",
+                        [](const std::pair<Function *, MachineFunction *> & P) {
+                          return P.first;
+                        });
     for (auto & FMF : Functions) {
       FunctionList.remove(FMF.first);
     }
@@ -303,9 +868,10 @@ ARMRandezvousCLR::runOnModule(Module & M) {
   }
 
   // Third, determine the numbers of trap instructions to insert
-  uint64_t NumTrapInsts = (RandezvousMaxTextSize - TotalTextSize) / 4;
+  uint64_t NumTrapInsts = (MaxTextSize - TotalTextSize) / 4;
   uint64_t SumShares = 0;
   std::vector<uint64_t> Shares(Functions.size());
+  std::vector<std::unique_ptr<RandezvousRNG> > TrapRNGs(Functions.size());
   if (!LateStage) {
     // Insert 80% of trap instructions during the early stage; this allows most
     // of trap blocks to be consumed by later passes while still keeping a
@@ -314,7 +880,10 @@ ARMRandezvousCLR::runOnModule(Module & M) {
     NumTrapInsts = NumTrapInsts * 80 / 100;
   }
   for (uint64_t i = 0; i < Functions.size(); ++i) {
-    Shares[i] = (*RNG)() & 0xffffffff; // Prevent overflow
+    TrapRNGs[i] = createRandezvousRNG(RandezvousCLRSeed,
+                                      getPassName() + Stage + "-traps",
+                                      *Functions[i].first);
+    Shares[i] = (*TrapRNGs[i])() & 0xffffffff; // Prevent overflow
     SumShares += Shares[i];
   }
   for (uint64_t i = 0; i < Functions.size(); ++i) {
@@ -322,8 +891,24 @@ ARMRandezvousCLR::runOnModule(Module & M) {
   }
 
   // Lastly, insert trap instructions into each function
+  uint64_t NumInserted = 0;
   for (uint64_t i = 0; i < Functions.size(); ++i) {
-    insertTrapBlocks(*Functions[i].first, *Functions[i].second, Shares[i]);
+    uint64_t NumAtEnd;
+    RNG = std::move(TrapRNGs[i]);
+    NumInserted += insertTrapBlocks(*Functions[i].first, *Functions[i].second,
+                                    Shares[i], NumAtEnd);
+    if (NumAtEnd != 0) {
+      Report.addCounter(*Functions[i].first, "traps-at-end", NumAtEnd);
+    }
+  }
+  Report.addSection(RandezvousSection::Text, TotalTextSize, MaxTextSize,
+                    "trap", NumInserted, 4);
+  Report.endModule(M, MMI);
+  Report.write(M);
+
+  // Basic blocks have been moved around, so drop their cached leakability
+  if (auto * LA = getAnalysisIfAvailable<ARMRandezvousLeakability>()) {
+    LA->invalidateBlockLeakability();
   }
 
   return true;
@@ -18,7 +18,6 @@
 
 #include "ARMRandezvousInstrumentor.h"
 #include "llvm/Pass.h"
-#include "llvm/Support/RandomNumberGenerator.h"
 
 namespace llvm {
   struct ARMRandezvousCLR : public ModulePass, ARMRandezvousInstrumentor {
@@ -40,12 +39,16 @@ namespace llvm {
     //               instructions
     bool LateStage = false;
 
-    std::unique_ptr<RandomNumberGenerator> RNG;
+    std::unique_ptr<RandezvousRNG> RNG;
 
     void shuffleMachineBasicBlocks(MachineFunction & MF);
+    uint64_t shuffleMachineBasicBlockChains(MachineFunction & MF);
     void shuffleMachineBasicBlockClusters(MachineFunction & MF);
-    void insertTrapBlocks(Function & F, MachineFunction & MF,
-                          uint64_t NumTrapInsts);
+    uint64_t limitTrapsByBranchRange(MachineFunction & MF,
+                                     std::vector<MachineBasicBlock *> & Pts,
+                                     std::vector<uint64_t> & Shares);
+    uint64_t insertTrapBlocks(Function & F, MachineFunction & MF,
+                              uint64_t NumTrapInsts, uint64_t & NumAtEnd);
   };
 
   ModulePass * createARMRandezvousCLR(bool LateStage);
@@ -15,8 +15,11 @@
 
 #define DEBUG_TYPE "arm-randezvous-gdlr"
 
+#include "ARMRandezvousBudget.h"
 #include "ARMRandezvousGDLR.h"
+#include "ARMRandezvousLeakability.h"
 #include "ARMRandezvousOptions.h"
+#include "ARMRandezvousReport.h"
 #include "MCTargetDesc/ARMAddressingModes.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/CodeGen/MachineModuleInfo.h"
@@ -33,6 +36,7 @@ STATISTIC(NumGVsBss2Data, "Number of global variables moved from Bss to Data");
 STATISTIC(NumBytesInRodata, "Original Rodata size");
 STATISTIC(NumBytesInData, "Original Data size");
 STATISTIC(NumBytesInBss, "Original Bss size");
+STATISTIC(NumGarbageRegions, "Number of garbage regions inserted");
 STATISTIC(NumGarbageObjects, "Number of pointer-sized garbage objects inserted");
 STATISTIC(NumGarbageObjectsInRodata, "Number of pointer-sized garbage objects inserted in Rodata");
 STATISTIC(NumGarbageObjectsInData, "Number of pointer-sized garbage objects inserted in Data");
@@ -54,6 +58,9 @@ ARMRandezvousGDLR::getAnalysisUsage(AnalysisUsage & AU) const {
   // We need this to access MachineFunctions
   AU.addRequired<MachineModuleInfoWrapperPass>();
 
+  // We neither reorder basic blocks nor add calls, so leakability holds
+  AU.addPreserved<ARMRandezvousLeakability>();
+
   AU.setPreservesCFG();
   ModulePass::getAnalysisUsage(AU);
 }
@@ -61,8 +68,9 @@ ARMRandezvousGDLR::getAnalysisUsage(AnalysisUsage & AU) const {
 void
 ARMRandezvousGDLR::releaseMemory() {
   TrapBlocks.clear();
-  TrapBlocksUnetched.clear();
-  TrapBlocksEtched.clear();
+  TrapInstEnds.clear();
+  TrapInstsUnetched.clear();
+  TrapInstsEtched.clear();
   GarbageObjects.clear();
   GarbageObjectsEligibleForGlobalGuard.clear();
 }
@@ -72,11 +80,20 @@ ARMRandezvousGDLR::releaseMemory() {
 //
 // Description:
 //   This method creates a function (both Function and MachineFunction) that
-//   picks a garbage object as the global guard.  A garbage object is eligible
-//   to be picked as the global guard if it is writable, has a size of at least
-//   32 bytes, and aligns at a 32-byte boundary.  If no such garbage object is
+//   picks a 32-byte chunk of a garbage region as the global guard.  A chunk is
+//   eligible to be picked as the global guard if it is writable, has a size of
+//   32 bytes, and aligns at a 32-byte boundary.  If no such chunk is
 //   available, this method also creates an eligible garbage object.
 //
+//   If a dynamic RNG is available, the function picks one of a power-of-two
+//   number of candidates in constant time: it masks a random number into an
+//   index and jumps into a table of 16-byte entries, each of which is a basic
+//   block that materializes a candidate's address with MOVW/MOVT and returns.
+//   The table lives in code and is never read as data, so the candidates stay
+//   hidden in execute-only memory.  If the RNG has no random number ready
+//   (i.e., it reads as zero), the function falls back to an index picked at
+//   compile time rather than waiting for the RNG.
+//
 // Input:
 //   M - A reference to the Module in which to create the function.
 //
@@ -97,6 +114,7 @@ ARMRandezvousGDLR::createGlobalGuardFunction(Module & M) {
   FunctionCallee FC = M.getOrInsertFunction(GlobalGuardFuncName, FuncTy);
   Function * F = dyn_cast<Function>(FC.getCallee());
   assert(F != nullptr && "Global guard function has wrong type!");
+  RNG = createRandezvousRNG(RandezvousGDLRSeed, getPassName() + "-guard", *F);
   MachineModuleInfo & MMI = getAnalysis<MachineModuleInfoWrapperPass>().getMMI();
   MachineFunction & MF = MMI.getOrCreateMachineFunction(*F);
 
@@ -111,15 +129,24 @@ ARMRandezvousGDLR::createGlobalGuardFunction(Module & M) {
   if (!F->hasFnAttribute(Attribute::WillReturn)) {
     F->addFnAttr(Attribute::WillReturn);
   }
+  F->addFnAttr("randezvous", "no-layout");
   using Property = MachineFunctionProperties::Property;
   if (!MF.getProperties().hasProperty(Property::NoVRegs)) {
     MF.getProperties().set(Property::NoVRegs);
   }
 
-  // Generate a list of global guard candidates
-  std::vector<GlobalValue *> GlobalGuardCandidates;
+  // Generate a list of global guard candidates, each of which is a garbage
+  // region and an offset into it
+  std::vector<std::pair<GlobalValue *, uint64_t> > GlobalGuardCandidates;
   if (!GarbageObjectsEligibleForGlobalGuard.empty()) {
-    for (unsigned i = 0; i < RandezvousNumGlobalGuardCandidates; ++i) {
+    // Use a power-of-two number of candidates (no more than 256) so that a
+    // random index can be computed with a mask
+    unsigned NumCandidates = RandezvousNumGlobalGuardCandidates;
+    if (!isPowerOf2_32(NumCandidates) || NumCandidates > 256) {
+      report_fatal_error("[GDLR] Number of global guard candidates must be a "
+                         "power of two no greater than 256");
+    }
+    for (unsigned i = 0; i < NumCandidates; ++i) {
       uint64_t Idx = (*RNG)() % GarbageObjectsEligibleForGlobalGuard.size();
       GlobalGuardCandidates.push_back(GarbageObjectsEligibleForGlobalGuard[Idx]);
     }
@@ -131,7 +158,7 @@ ARMRandezvousGDLR::createGlobalGuardFunction(Module & M) {
       Constant::getNullValue(GarbageObjectTy), GarbageObjectNamePrefix
     );
     GV->setAlignment(MaybeAlign(32));
-    GlobalGuardCandidates.push_back(GV);
+    GlobalGuardCandidates.push_back(std::make_pair(GV, 0));
   }
 
   // Create a basic block if not created
@@ -147,10 +174,6 @@ ARMRandezvousGDLR::createGlobalGuardFunction(Module & M) {
     // Build machine IR basic block(s)
     const TargetInstrInfo * TII = MF.getSubtarget().getInstrInfo();
     MachineBasicBlock * MBB = MF.CreateMachineBasicBlock(BB);
-    MachineBasicBlock * MBB2 = nullptr;
-    MachineBasicBlock * MBB3 = nullptr;
-    MachineBasicBlock * MBB4 = nullptr;
-    MachineBasicBlock * RetMBB = MBB;
     MF.push_back(MBB);
     if (RandezvousRNGAddress != 0 && GlobalGuardCandidates.size() > 1) {
       // User provided an RNG address, so load a random index from the RNG
@@ -172,140 +195,124 @@ ARMRandezvousGDLR::createGlobalGuardFunction(Module & M) {
         .add(predOps(ARMCC::AL));
       }
 
-      MBB2 = MF.CreateMachineBasicBlock(BB);
-      MF.push_back(MBB2);
-      MBB->addSuccessor(MBB2);
-      MBB2->addSuccessor(MBB2);
+      // Load a random index; if the RNG is not ready and reads zero, fall back
+      // to an index picked at compile time instead of waiting for it
+      uint64_t StaticIdx = (*RNG)() % GlobalGuardCandidates.size();
       // LDRi12 R3, [R2, #0]
-      BuildMI(MBB2, DebugLoc(), TII->get(ARM::t2LDRi12), ARM::R3)
+      BuildMI(MBB, DebugLoc(), TII->get(ARM::t2LDRi12), ARM::R3)
       .addReg(ARM::R2)
       .addImm(0)
       .add(predOps(ARMCC::AL));
       // CMPi8 R3, #0
-      BuildMI(MBB2, DebugLoc(), TII->get(ARM::t2CMPri))
+      BuildMI(MBB, DebugLoc(), TII->get(ARM::t2CMPri))
       .addReg(ARM::R3)
       .addImm(0)
       .add(predOps(ARMCC::AL));
-      // BEQ MBB2
-      BuildMI(MBB2, DebugLoc(), TII->get(ARM::t2Bcc))
-      .addMBB(MBB2)
+      // IT EQ
+      BuildMI(MBB, DebugLoc(), TII->get(ARM::t2IT))
       .addImm(ARMCC::EQ)
-      .addReg(ARM::CPSR, RegState::Kill);
-
-      MBB3 = MF.CreateMachineBasicBlock(BB);
-      MF.push_back(MBB3);
-      MBB2->addSuccessor(MBB3);
-      // Prepare for runtime modulus
-      if (ARM_AM::getT2SOImmVal(GlobalGuardCandidates.size()) != -1) {
-        // Use MOVi if the number of global guard candidates can be encoded in
-        // Thumb modified constant
-        BuildMI(MBB3, DebugLoc(), TII->get(ARM::t2MOVi), ARM::R2)
-        .addImm(GlobalGuardCandidates.size())
-        .add(predOps(ARMCC::AL))
-        .add(condCodeOp()); // No 'S' bit
-      } else {
-        // Otherwise use MOVi16/MOVTi16 to encode lower/upper 16 bits of the
-        // number
-        BuildMI(MBB3, DebugLoc(), TII->get(ARM::t2MOVi16), ARM::R2)
-        .addImm(GlobalGuardCandidates.size() & 0xffff)
-        .add(predOps(ARMCC::AL));
-        BuildMI(MBB3, DebugLoc(), TII->get(ARM::t2MOVTi16), ARM::R2)
-        .addReg(ARM::R2)
-        .addImm((GlobalGuardCandidates.size() >> 16) & 0xffff)
-        .add(predOps(ARMCC::AL));
-      }
-      // UDIV R12, R3, R2
-      BuildMI(MBB3, DebugLoc(), TII->get(ARM::t2UDIV), ARM::R12)
+      .addImm(0x8);
+      // MOVi R3, #StaticIdx (EQ)
+      BuildMI(MBB, DebugLoc(), TII->get(ARM::t2MOVi), ARM::R3)
+      .addImm(StaticIdx)
+      .add(predOps(ARMCC::EQ, ARM::CPSR))
+      .add(condCodeOp()); // No 'S' bit
+      // ANDri R3, R3, #(NumCandidates - 1)
+      BuildMI(MBB, DebugLoc(), TII->get(ARM::t2ANDri), ARM::R3)
       .addReg(ARM::R3)
-      .addReg(ARM::R2)
-      .add(predOps(ARMCC::AL));
-      // MLS R3, R2, R12, R3
-      BuildMI(MBB3, DebugLoc(), TII->get(ARM::t2MLS), ARM::R3)
-      .addReg(ARM::R2)
-      .addReg(ARM::R12)
+      .addImm(GlobalGuardCandidates.size() - 1)
+      .add(predOps(ARMCC::AL))
+      .add(condCodeOp()); // No 'S' bit
+      // LSLri R3, R3, #4
+      BuildMI(MBB, DebugLoc(), TII->get(ARM::t2LSLri), ARM::R3)
+      .addReg(ARM::R3)
+      .addImm(4)
+      .add(predOps(ARMCC::AL))
+      .add(condCodeOp()); // No 'S' bit
+      // ADDhirr R3, R3, PC; PC reads as the address of this instruction plus
+      // 4, which is where the table starts right after the branch below
+      BuildMI(MBB, DebugLoc(), TII->get(ARM::tADDhirr), ARM::R3)
       .addReg(ARM::R3)
+      .addReg(ARM::PC)
+      .add(predOps(ARMCC::AL));
+      // BRIND R3
+      BuildMI(MBB, DebugLoc(), TII->get(ARM::tBRIND))
+      .addReg(ARM::R3, RegState::Kill)
       .add(predOps(ARMCC::AL));
 
-      MBB4 = MF.CreateMachineBasicBlock(BB);
-      MF.push_back(MBB4);
-      MBB3->addSuccessor(MBB4);
-      RetMBB = MBB4;
-      for (unsigned i = 0; i < GlobalGuardCandidates.size() - 1; ++i) {
-        // SUBri12 R2, R2, #1
-        BuildMI(MBB3, DebugLoc(), TII->get(ARM::t2SUBri12), ARM::R2)
+      // Build the table; each entry is a basic block of exactly 16 bytes, and
+      // the "no-layout" option keeps CLR from moving the entries or inserting
+      // trap instructions between them
+      for (auto & Candidate : GlobalGuardCandidates) {
+        MachineBasicBlock * EntryMBB = MF.CreateMachineBasicBlock(BB);
+        MF.push_back(EntryMBB);
+        MBB->addSuccessor(EntryMBB);
+        // MOVi16 R2, @Candidate_lo
+        BuildMI(EntryMBB, DebugLoc(), TII->get(ARM::t2MOVi16), ARM::R2)
+        .addGlobalAddress(Candidate.first, Candidate.second, ARMII::MO_LO16)
+        .add(predOps(ARMCC::AL));
+        // MOVTi16 R2, @Candidate_hi
+        BuildMI(EntryMBB, DebugLoc(), TII->get(ARM::t2MOVTi16), ARM::R2)
         .addReg(ARM::R2)
-        .addImm(1)
+        .addGlobalAddress(Candidate.first, Candidate.second, ARMII::MO_HI16)
         .add(predOps(ARMCC::AL));
-        // CMPrr R3, R2
-        BuildMI(MBB3, DebugLoc(), TII->get(ARM::tCMPr))
-        .addReg(ARM::R3)
+        // STRi R2, [R0, #0]
+        BuildMI(EntryMBB, DebugLoc(), TII->get(ARM::tSTRi))
         .addReg(ARM::R2)
+        .addReg(ARM::R0)
+        .addImm(0)
+        .add(predOps(ARMCC::AL));
+        // ADDi8 R2, #32
+        BuildMI(EntryMBB, DebugLoc(), TII->get(ARM::tADDi8), ARM::R2)
+        .add(t1CondCodeOp(true))
+        .addReg(ARM::R2)
+        .addImm(32)
+        .add(predOps(ARMCC::AL));
+        // STRi R2, [R1, #0]
+        BuildMI(EntryMBB, DebugLoc(), TII->get(ARM::tSTRi))
+        .addReg(ARM::R2)
+        .addReg(ARM::R1)
+        .addImm(0)
+        .add(predOps(ARMCC::AL));
+        // BX_RET
+        BuildMI(EntryMBB, DebugLoc(), TII->get(ARM::tBX_RET))
         .add(predOps(ARMCC::AL));
-        // IT EQ
-        BuildMI(MBB3, DebugLoc(), TII->get(ARM::t2IT))
-        .addImm(ARMCC::EQ)
-        .addImm(2);
-        // MOVi16 R12, @GlobalGuardCandidates[i]_lo
-        BuildMI(MBB3, DebugLoc(), TII->get(ARM::t2MOVi16), ARM::R12)
-        .addGlobalAddress(GlobalGuardCandidates[i], 0, ARMII::MO_LO16)
-        .add(predOps(ARMCC::EQ, ARM::CPSR));
-        // MOVTi16 R12, @GlobalGuardCandidates[i]_hi
-        BuildMI(MBB3, DebugLoc(), TII->get(ARM::t2MOVTi16), ARM::R12)
-        .addReg(ARM::R12)
-        .addGlobalAddress(GlobalGuardCandidates[i], 0, ARMII::MO_HI16)
-        .add(predOps(ARMCC::EQ, ARM::CPSR));
-        // B MBB4
-        BuildMI(MBB3, DebugLoc(), TII->get(ARM::t2B))
-        .addMBB(MBB4)
-        .add(predOps(ARMCC::EQ, ARM::CPSR));
       }
-      // MOVi16 R12, @GlobalGuardCandidates[last]_lo
-      BuildMI(MBB3, DebugLoc(), TII->get(ARM::t2MOVi16), ARM::R12)
-      .addGlobalAddress(GlobalGuardCandidates.back(), 0, ARMII::MO_LO16)
-      .add(predOps(ARMCC::AL));
-      // MOVTi16 R12, @GlobalGuardCandidates[last]_hi
-      BuildMI(MBB3, DebugLoc(), TII->get(ARM::t2MOVTi16), ARM::R12)
-      .addReg(ARM::R12)
-      .addGlobalAddress(GlobalGuardCandidates.back(), 0, ARMII::MO_HI16)
-      .add(predOps(ARMCC::AL));
-      // B MBB4
-      BuildMI(MBB3, DebugLoc(), TII->get(ARM::t2B))
-      .addMBB(MBB4)
-      .add(predOps(ARMCC::AL));
     } else {
       // Pick a static global guard
       uint64_t Idx = (*RNG)() % GlobalGuardCandidates.size();
       // MOVi16 R12, @GlobalGuardCandidates[Idx]_lo
       BuildMI(MBB, DebugLoc(), TII->get(ARM::t2MOVi16), ARM::R12)
-      .addGlobalAddress(GlobalGuardCandidates[Idx], 0, ARMII::MO_LO16)
+      .addGlobalAddress(GlobalGuardCandidates[Idx].first,
+                        GlobalGuardCandidates[Idx].second, ARMII::MO_LO16)
       .add(predOps(ARMCC::AL));
       // MOVTi16 R12, @GlobalGuardCandidates[Idx]_hi
       BuildMI(MBB, DebugLoc(), TII->get(ARM::t2MOVTi16), ARM::R12)
       .addReg(ARM::R12)
-      .addGlobalAddress(GlobalGuardCandidates[Idx], 0, ARMII::MO_HI16)
+      .addGlobalAddress(GlobalGuardCandidates[Idx].first,
+                        GlobalGuardCandidates[Idx].second, ARMII::MO_HI16)
+      .add(predOps(ARMCC::AL));
+      // STRi12 R12, [R0, #0]
+      BuildMI(MBB, DebugLoc(), TII->get(ARM::t2STRi12))
+      .addReg(ARM::R12)
+      .addReg(ARM::R0)
+      .addImm(0)
+      .add(predOps(ARMCC::AL));
+      // ADDri12 R12, R12, #32
+      BuildMI(MBB, DebugLoc(), TII->get(ARM::t2ADDri12), ARM::R12)
+      .addReg(ARM::R12)
+      .addImm(32)
+      .add(predOps(ARMCC::AL));
+      // STRi12 R12, [R1, #0]
+      BuildMI(MBB, DebugLoc(), TII->get(ARM::t2STRi12))
+      .addReg(ARM::R12)
+      .addReg(ARM::R1)
+      .addImm(0)
+      .add(predOps(ARMCC::AL));
+      // BX_RET
+      BuildMI(MBB, DebugLoc(), TII->get(ARM::tBX_RET))
       .add(predOps(ARMCC::AL));
     }
-
-    // STRi12 R12, [R0, #0]
-    BuildMI(RetMBB, DebugLoc(), TII->get(ARM::t2STRi12))
-    .addReg(ARM::R12)
-    .addReg(ARM::R0)
-    .addImm(0)
-    .add(predOps(ARMCC::AL));
-    // ADDri12 R12, R12, #32
-    BuildMI(RetMBB, DebugLoc(), TII->get(ARM::t2ADDri12), ARM::R12)
-    .addReg(ARM::R12)
-    .addImm(32)
-    .add(predOps(ARMCC::AL));
-    // STRi12 R12, [R1, #0]
-    BuildMI(RetMBB, DebugLoc(), TII->get(ARM::t2STRi12))
-    .addReg(ARM::R12)
-    .addReg(ARM::R1)
-    .addImm(0)
-    .add(predOps(ARMCC::AL));
-    // BX_RET
-    BuildMI(RetMBB, DebugLoc(), TII->get(ARM::tBX_RET))
-    .add(predOps(ARMCC::AL));
   }
 
   // Add the global guard function to @llvm.used
@@ -330,93 +337,100 @@ ARMRandezvousGDLR::createGlobalGuardFunction(Module & M) {
 void
 ARMRandezvousGDLR::insertGarbageObjects(GlobalVariable & GV,
                                         uint64_t NumGarbages) {
+  if (NumGarbages == 0) {
+    return;
+  }
+
   Module & M = *GV.getParent();
+  RNG = createRandezvousRNG(RandezvousGDLRSeed, getPassName() + "-garbage", GV);
 
   //
-  // Instead of creating N pointer-sized garbage objects, we create
-  // N / (32 / pointer size) garbage array objects of (32 / pointer size)
-  // elements (plus a remainder garbage array object if N % (32 / pointer size)
-  // is not zero)
+  // Instead of creating N pointer-sized garbage objects, we create a single
+  // garbage region (an array of N pointer-sized elements) and treat each 32
+  // bytes of it as a garbage object; the region aligns at a 32-byte boundary
+  // if it is at least 32 bytes, so it has exactly the same layout as a run of
+  // 32-byte aligned garbage objects followed by a remainder, while adding only
+  // one global to the Module.
   //
 
-  // Create types for the garbage objects
+  // Create the type of the garbage region
   uint64_t PtrSize = M.getDataLayout().getPointerSize();
+  uint64_t RegionSize = NumGarbages * PtrSize;
   LLVMContext & Ctx = M.getContext();
   PointerType * BlockAddrTy = PointerType::getUnqual(Type::getInt8Ty(Ctx));
-  ArrayType * GarbageObjectTy = ArrayType::get(BlockAddrTy, 32 / PtrSize);
-  ArrayType * RemainderTy = ArrayType::get(BlockAddrTy,
-                                           NumGarbages % (32 / PtrSize));
-
-  uint64_t RemainingSize = NumGarbages * PtrSize;
-  while (RemainingSize > 0) {
-    uint64_t ObjectSize = RemainingSize < 32 ? RemainingSize : 32;
-    uint64_t ObjectAlign = RemainingSize < 32 ? PtrSize : 32;
-    ArrayType * ObjectTy = RemainingSize < 32 ? RemainderTy : GarbageObjectTy;
-
-    // Create an initializer for the garbage object
-    Constant * Initializer = nullptr;
-    if (GV.hasInitializer() && GV.getInitializer()->isZeroValue()) {
-      // GV is in BSS, so initialize the garbage object with zeros
-      Initializer = Constant::getNullValue(ObjectTy);
-    } else if (EnableRandezvousDecoyPointers && !TrapBlocks.empty()) {
-      // Initialize the garbage object with addresses of random trap blocks
-      std::vector<Constant *> InitArray;
-      for (uint64_t i = 0; i < ObjectSize / PtrSize; ++i) {
-        uint64_t Idx = (*RNG)() % TrapBlocks.size();
-        const BasicBlock * BB = TrapBlocks[Idx]->getBasicBlock();
-        InitArray.push_back(BlockAddress::get(const_cast<BasicBlock *>(BB)));
-      }
-      Initializer = ConstantArray::get(ObjectTy, InitArray);
-    } else {
-      // Initialize the garbage object with random values
-      std::vector<Constant *> InitArray;
-      for (uint64_t i = 0; i < ObjectSize / PtrSize; ++i) {
-        InitArray.push_back(Constant::getIntegerValue(BlockAddrTy,
-                                                      APInt(8 * PtrSize,
-                                                            (*RNG)())));
-      }
-      Initializer = ConstantArray::get(ObjectTy, InitArray);
+  ArrayType * RegionTy = ArrayType::get(BlockAddrTy, NumGarbages);
+
+  // Create an initializer for the garbage region
+  Constant * Initializer = nullptr;
+  if (GV.hasInitializer() && GV.getInitializer()->isZeroValue()) {
+    // GV is in BSS, so initialize the garbage region with zeros
+    Initializer = Constant::getNullValue(RegionTy);
+  } else if (EnableRandezvousDecoyPointers && !TrapBlocks.empty()) {
+    // Initialize the garbage region with addresses of random trap
+    // instructions
+    std::vector<Constant *> InitArray;
+    for (uint64_t i = 0; i < NumGarbages; ++i) {
+      uint64_t Idx = (*RNG)() % TrapInstEnds.back();
+      uint64_t Offset;
+      MachineBasicBlock * TrapBlock = findTrapInst(TrapBlocks, TrapInstEnds,
+                                                   Idx, Offset);
+      InitArray.push_back(createTrapInstAddress(*TrapBlock, Offset));
     }
-
-    // Create the garbage object and insert it before GV
-    GlobalVariable * GarbageObject = new GlobalVariable(
-      M, ObjectTy, GV.isConstant(), GlobalVariable::InternalLinkage,
-      Initializer, GarbageObjectNamePrefix, &GV
-    );
-    GarbageObject->setAlignment(MaybeAlign(ObjectAlign));
-    NumGarbageObjects += ObjectSize / PtrSize;
-    if (GarbageObject->isConstant()) {
-      NumGarbageObjectsInRodata += ObjectSize / PtrSize;
-    } else if (Initializer->isZeroValue()) {
-      NumGarbageObjectsInBss += ObjectSize / PtrSize;
-    } else {
-      NumGarbageObjectsInData += ObjectSize / PtrSize;
+    Initializer = ConstantArray::get(RegionTy, InitArray);
+  } else {
+    // Initialize the garbage region with random values
+    std::vector<Constant *> InitArray;
+    for (uint64_t i = 0; i < NumGarbages; ++i) {
+      InitArray.push_back(Constant::getIntegerValue(BlockAddrTy,
+                                                    APInt(8 * PtrSize,
+                                                          (*RNG)())));
     }
+    Initializer = ConstantArray::get(RegionTy, InitArray);
+  }
 
-    // Keep track of the garbage object
-    GarbageObjects.push_back(GarbageObject);
-    if (EnableRandezvousGlobalGuard && !GarbageObject->isConstant() &&
-        ObjectSize == 32 && !Initializer->isZeroValue()) {
-      GarbageObjectsEligibleForGlobalGuard.push_back(GarbageObject);
+  // Create the garbage region and insert it before GV
+  GlobalVariable * GarbageRegion = new GlobalVariable(
+    M, RegionTy, GV.isConstant(), GlobalVariable::InternalLinkage,
+    Initializer, GarbageObjectNamePrefix, &GV
+  );
+  GarbageRegion->setAlignment(MaybeAlign(RegionSize < 32 ? PtrSize : 32));
+  ++NumGarbageRegions;
+  NumGarbageObjects += NumGarbages;
+  if (GarbageRegion->isConstant()) {
+    NumGarbageObjectsInRodata += NumGarbages;
+  } else if (Initializer->isZeroValue()) {
+    NumGarbageObjectsInBss += NumGarbages;
+  } else {
+    NumGarbageObjectsInData += NumGarbages;
+  }
+
+  // Keep track of the garbage region
+  GarbageObjects.push_back(GarbageRegion);
+
+  for (uint64_t Offset = 0; Offset < RegionSize; Offset += 32) {
+    // Keep track of each complete 32-byte chunk eligible for the global guard
+    if (EnableRandezvousGlobalGuard && !GarbageRegion->isConstant() &&
+        Offset + 32 <= RegionSize && !Initializer->isZeroValue()) {
+      GarbageObjectsEligibleForGlobalGuard.push_back(
+        std::make_pair(GarbageRegion, Offset)
+      );
     }
 
-    // Etch (the lower 16 bits of) the garbage object's address onto a trap
-    // instruction so that it will not be GC'd away
-    if (!TrapBlocksUnetched.empty()) {
-      MachineBasicBlock * TrapBlock = TrapBlocksUnetched.back();
-      assert(!TrapBlock->empty() && "Invalid trap block!");
-      MachineInstr & TrapInst = TrapBlock->front();
-      assert(TrapInst.getOpcode() == ARM::t2UDF_ga && "Invalid trap block!");
-
-      TrapBlocksUnetched.pop_back();
-      TrapInst.getOperand(0).ChangeToGA(GarbageObject, 0, ARMII::MO_LO16);
-      TrapBlocksEtched.push_back(TrapBlock);
+    // Etch (the lower 16 bits of) the chunk's address onto a trap instruction
+    // so that the garbage region will not be GC'd away
+    if (!TrapInstsUnetched.empty()) {
+      MachineInstr * TrapInst = TrapInstsUnetched.back();
+      assert(TrapInst->getOpcode() == ARM::t2UDF_ga && "Invalid trap block!");
+
+      TrapInstsUnetched.pop_back();
+      TrapInst->getOperand(0).ChangeToGA(GarbageRegion, Offset,
+                                         ARMII::MO_LO16);
+      TrapInstsEtched.push_back(TrapInst);
       ++NumTrapsEtched;
     } else if (!TrapBlocks.empty()) {
-      errs() << "[GDLR] All trap blocks etched!\n";
+      errs() << "[GDLR] All trap instructions etched!\n";
+      break;
     }
-
-    RemainingSize -= ObjectSize;
   }
 }
 
@@ -442,8 +456,6 @@ ARMRandezvousGDLR::insertGarbageObjects(GlobalVariable & GV,
 bool
 ARMRandezvousGDLR::runOnModule(Module & M) {
   MachineModuleInfo & MMI = getAnalysis<MachineModuleInfoWrapperPass>().getMMI();
-  Twine RNGName = getPassName() + "-" + Twine(RandezvousGDLRSeed);
-  RNG = M.createRNG(RNGName.str());
 
   // Find trap blocks inserted by CLR
   for (Function & F : M) {
@@ -451,8 +463,12 @@ ARMRandezvousGDLR::runOnModule(Module & M) {
     if (MF != nullptr) {
       for (MachineBasicBlock & MBB : *MF) {
         if (MBB.isRandezvousTrapBlock()) {
+          uint64_t NumTrapInsts = TrapInstEnds.empty() ? 0 : TrapInstEnds.back();
           TrapBlocks.push_back(&MBB);
-          TrapBlocksUnetched.push_back(&MBB);
+          TrapInstEnds.push_back(NumTrapInsts + MBB.size());
+          for (MachineInstr & MI : MBB) {
+            TrapInstsUnetched.push_back(&MI);
+          }
         }
       }
     }
@@ -520,12 +536,26 @@ ARMRandezvousGDLR::runOnModule(Module & M) {
   if (!EnableRandezvousGDLR) {
     return false;
   }
+  RandezvousPassReport Report("gdlr");
 
   TotalDataSize += TotalBss2DataSize;
 
-  assert(TotalRodataSize <= RandezvousMaxRodataSize && "Rodata size exceeds the limit!");
-  assert(TotalDataSize <= RandezvousMaxDataSize && "Data size exceeds the limit!");
-  assert(TotalBssSize <= RandezvousMaxBssSize && "Bss size exceeds the limit!");
+  // Record how much space each category of globals uses before any garbage
+  // object is inserted, and find out how much space the module is allowed to
+  // fill up
+  recordRandezvousSectionSize(Report, RandezvousSection::Rodata,
+                              TotalRodataSize);
+  recordRandezvousSectionSize(Report, RandezvousSection::Data,
+                              TotalDataSize);
+  recordRandezvousSectionSize(Report, RandezvousSection::Bss,
+                              TotalBssSize);
+  uint64_t MaxRodataSize = getRandezvousBudget(M, RandezvousSection::Rodata);
+  uint64_t MaxDataSize = getRandezvousBudget(M, RandezvousSection::Data);
+  uint64_t MaxBssSize = getRandezvousBudget(M, RandezvousSection::Bss);
+
+  assert(TotalRodataSize <= MaxRodataSize && "Rodata size exceeds the limit!");
+  assert(TotalDataSize <= MaxDataSize && "Data size exceeds the limit!");
+  assert(TotalBssSize <= MaxBssSize && "Bss size exceeds the limit!");
 
   /* Move globals that should migrate from Bss to Data */
   for (GlobalVariable * GV : Bss2DataGVs) {
@@ -540,9 +570,11 @@ ARMRandezvousGDLR::runOnModule(Module & M) {
 
   // Third, shuffle the order of globals
   SymbolTableList<GlobalVariable> & GlobalList = M.getGlobalList();
-  llvm::shuffle(RodataGVs.begin(), RodataGVs.end(), *RNG);
-  llvm::shuffle(DataGVs.begin(), DataGVs.end(), *RNG);
-  llvm::shuffle(BssGVs.begin(), BssGVs.end(), *RNG);
+  auto GetGV = [](GlobalVariable * GV) { return GV; };
+  std::string OrderPurpose = (getPassName() + "-order").str();
+  shuffleGlobalValues(RodataGVs, RandezvousGDLRSeed, OrderPurpose, GetGV);
+  shuffleGlobalValues(DataGVs, RandezvousGDLRSeed, OrderPurpose, GetGV);
+  shuffleGlobalValues(BssGVs, RandezvousGDLRSeed, OrderPurpose, GetGV);
   for (GlobalVariable * GV : RodataGVs) {
     GlobalList.remove(GV);
   }
@@ -564,24 +596,28 @@ ARMRandezvousGDLR::runOnModule(Module & M) {
 
   // Fourth, determine the numbers of pointer-sized garbage objects
   uint64_t PtrSize = DL.getPointerSize();
-  uint64_t NumGrbgInRodata = (RandezvousMaxRodataSize - TotalRodataSize) / PtrSize;
-  uint64_t NumGrbgInData = (RandezvousMaxDataSize - TotalDataSize) / PtrSize;
-  uint64_t NumGrbgInBss = (RandezvousMaxBssSize - TotalBssSize) / PtrSize;
+  uint64_t NumGrbgInRodata = (MaxRodataSize - TotalRodataSize) / PtrSize;
+  uint64_t NumGrbgInData = (MaxDataSize - TotalDataSize) / PtrSize;
+  uint64_t NumGrbgInBss = (MaxBssSize - TotalBssSize) / PtrSize;
   uint64_t SumSharesForRodata = 0;
   uint64_t SumSharesForData = 0;
   uint64_t SumSharesForBss = 0;
   std::vector<uint64_t> SharesForRodata(RodataGVs.size());
   std::vector<uint64_t> SharesForData(DataGVs.size());
   std::vector<uint64_t> SharesForBss(BssGVs.size());
+  std::string SharePurpose = (getPassName() + "-share").str();
   for (uint64_t i = 0; i < RodataGVs.size(); ++i) {
+    RNG = createRandezvousRNG(RandezvousGDLRSeed, SharePurpose, *RodataGVs[i]);
     SharesForRodata[i] = (*RNG)() & 0xffffffff; // Prevent overflow
     SumSharesForRodata += SharesForRodata[i];
   }
   for (uint64_t i = 0; i < DataGVs.size(); ++i) {
+    RNG = createRandezvousRNG(RandezvousGDLRSeed, SharePurpose, *DataGVs[i]);
     SharesForData[i] = (*RNG)() & 0xffffffff;   // Prevent overflow
     SumSharesForData += SharesForData[i];
   }
   for (uint64_t i = 0; i < BssGVs.size(); ++i) {
+    RNG = createRandezvousRNG(RandezvousGDLRSeed, SharePurpose, *BssGVs[i]);
     SharesForBss[i] = (*RNG)() & 0xffffffff;    // Prevent overflow
     SumSharesForBss += SharesForBss[i];
   }
@@ -596,15 +632,27 @@ ARMRandezvousGDLR::runOnModule(Module & M) {
   }
 
   // Lastly, insert garbage objects before each global
+  uint64_t NumGarbagesInRodata = 0;
+  uint64_t NumGarbagesInData = 0;
+  uint64_t NumGarbagesInBss = 0;
   for (uint64_t i = 0; i < RodataGVs.size(); ++i) {
     insertGarbageObjects(*RodataGVs[i], SharesForRodata[i]);
+    NumGarbagesInRodata += SharesForRodata[i];
   }
   for (uint64_t i = 0; i < DataGVs.size(); ++i) {
     insertGarbageObjects(*DataGVs[i], SharesForData[i]);
+    NumGarbagesInData += SharesForData[i];
   }
   for (uint64_t i = 0; i < BssGVs.size(); ++i) {
     insertGarbageObjects(*BssGVs[i], SharesForBss[i]);
+    NumGarbagesInBss += SharesForBss[i];
   }
+  Report.addSection(RandezvousSection::Rodata, TotalRodataSize, MaxRodataSize,
+                    "garbage", NumGarbagesInRodata, PtrSize);
+  Report.addSection(RandezvousSection::Data, TotalDataSize, MaxDataSize,
+                    "garbage", NumGarbagesInData, PtrSize);
+  Report.addSection(RandezvousSection::Bss, TotalBssSize, MaxBssSize,
+                    "garbage", NumGarbagesInBss, PtrSize);
 
   // Create global guard function
   if (EnableRandezvousGlobalGuard) {
@@ -613,6 +661,7 @@ ARMRandezvousGDLR::runOnModule(Module & M) {
 
   // Add all the garbage objects to @llvm.used
   appendToUsed(M, GarbageObjects);
+  Report.write(M);
 
   return true;
 }
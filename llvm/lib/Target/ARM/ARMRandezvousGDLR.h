@@ -18,7 +18,6 @@
 
 #include "ARMRandezvousInstrumentor.h"
 #include "llvm/Pass.h"
-#include "llvm/Support/RandomNumberGenerator.h"
 
 namespace llvm {
   struct ARMRandezvousGDLR : public ModulePass, ARMRandezvousInstrumentor {
@@ -35,12 +34,13 @@ namespace llvm {
     virtual bool runOnModule(Module & M) override;
 
   private:
-    std::unique_ptr<RandomNumberGenerator> RNG;
+    std::unique_ptr<RandezvousRNG> RNG;
     std::vector<MachineBasicBlock *> TrapBlocks;
-    std::vector<MachineBasicBlock *> TrapBlocksUnetched;
-    std::vector<MachineBasicBlock *> TrapBlocksEtched;
+    std::vector<uint64_t> TrapInstEnds;
+    std::vector<MachineInstr *> TrapInstsUnetched;
+    std::vector<MachineInstr *> TrapInstsEtched;
     std::vector<GlobalValue *> GarbageObjects;
-    std::vector<GlobalValue *> GarbageObjectsEligibleForGlobalGuard;
+    std::vector<std::pair<GlobalValue *, uint64_t> > GarbageObjectsEligibleForGlobalGuard;
 
     Function * createGlobalGuardFunction(Module & M);
     void insertGarbageObjects(GlobalVariable & GV, uint64_t NumGarbages);
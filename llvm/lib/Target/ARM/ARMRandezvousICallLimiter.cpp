@@ -18,6 +18,8 @@
 #include "ARMBaseInstrInfo.h"
 #include "ARMRandezvousICallLimiter.h"
 #include "ARMRandezvousOptions.h"
+#include "ARMRandezvousReport.h"
+#include "ARMRandezvousTiering.h"
 #include "ARMRegisterInfo.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/CodeGen/TargetInstrInfo.h"
@@ -28,7 +30,8 @@ STATISTIC(NumICallsLimited, "Number of indirect calls limited");
 
 char ARMRandezvousICallLimiter::ID = 0;
 
-ARMRandezvousICallLimiter::ARMRandezvousICallLimiter() : MachineFunctionPass(ID) {
+ARMRandezvousICallLimiter::ARMRandezvousICallLimiter()
+    : MachineFunctionPass(ID), Report("icall-limiter") {
 }
 
 StringRef
@@ -36,6 +39,34 @@ ARMRandezvousICallLimiter::getPassName() const {
   return "ARM Randezvous Indirect Call Limiter Pass";
 }
 
+void
+ARMRandezvousICallLimiter::getAnalysisUsage(AnalysisUsage & AU) const {
+  // We need this to choose the protection tier of each function
+  AU.addRequired<ProfileSummaryInfoWrapperPass>();
+
+  MachineFunctionPass::getAnalysisUsage(AU);
+}
+
+//
+// Method: doInitialization()
+//
+// Description:
+//   This method is called before the pass runs on any function of a Module.
+//   This method stops the timer of the report until a function is
+//   transformed.
+//
+// Input:
+//   M - A reference to the Module.
+//
+// Return value:
+//   false - The Module was not transformed.
+//
+bool
+ARMRandezvousICallLimiter::doInitialization(Module & M) {
+  Report.pauseTimer();
+  return MachineFunctionPass::doInitialization(M);
+}
+
 //
 // Method: runOnMachineFunction()
 //
@@ -61,13 +92,27 @@ ARMRandezvousICallLimiter::runOnMachineFunction(MachineFunction & MF) {
     return false;
   }
 
+  // Leave register allocation alone in functions that opt out or are of the
+  // reduced tier
+  ProfileSummaryInfo * PSI =
+    &getAnalysis<ProfileSummaryInfoWrapperPass>().getPSI();
+  RandezvousTier Tier = getRandezvousTier(MF.getFunction(), PSI);
+  if (hasRandezvousOption(MF.getFunction(), "no-icall-limiter") ||
+      Tier == RandezvousTier::Reduced) {
+    recordRandezvousOverhead(Report, MF.getFunction(), Tier, "none", 0);
+    return false;
+  }
+
   MachineRegisterInfo & MRI = MF.getRegInfo();
   const TargetInstrInfo * TII = MF.getSubtarget().getInstrInfo();
+  Report.resumeTimer();
+  Report.beginFunction(MF);
 
   // Find all indirect calls and limit the register they use to be within
   // { R0 -- R3, R12 } (i.e., tcGPR class).  This will ensure that those
   // function pointers are not spilled to memory due to callee-saved registers.
   bool changed = false;
+  uint64_t NumCopies = 0;
   for (MachineBasicBlock & MBB : MF) {
     for (MachineInstr & MI : MBB) {
       if (MI.getOpcode() == ARM::tBLXr) {
@@ -95,6 +140,7 @@ ARMRandezvousICallLimiter::runOnMachineFunction(MachineFunction & MF) {
             .addReg(Reg)
             .add(predOps(Pred, PredReg));
           }
+          ++NumCopies;
         }
         MI.setDesc(TII->get(ARM::tBLXr_Randezvous));
         ++NumICallsLimited;
@@ -103,9 +149,38 @@ ARMRandezvousICallLimiter::runOnMachineFunction(MachineFunction & MF) {
     }
   }
 
+  // Assume that each copy runs once per invocation
+  recordRandezvousOverhead(Report, MF.getFunction(), Tier, "icall-limiter",
+                           getRandezvousDynamicCount(MF.getFunction(),
+                                                     NumCopies));
+  Report.endFunction(MF);
+  Report.addCounter(MF.getFunction(), "copies", NumCopies);
+  Report.pauseTimer();
+
   return changed;
 }
 
+//
+// Method: doFinalization()
+//
+// Description:
+//   This method is called after the pass has run on every function of a
+//   Module.  This method writes the report of the whole Module.
+//
+// Input:
+//   M - A reference to the Module.
+//
+// Return value:
+//   false - The Module was not transformed.
+//
+bool
+ARMRandezvousICallLimiter::doFinalization(Module & M) {
+  if (EnableRandezvousICallLimiter) {
+    Report.write(M);
+  }
+  return false;
+}
+
 FunctionPass *
 llvm::createARMRandezvousICallLimiter(void) {
   return new ARMRandezvousICallLimiter();
@@ -16,6 +16,7 @@
 #ifndef ARM_RANDEZVOUS_ICALL_LIMITER
 #define ARM_RANDEZVOUS_ICALL_LIMITER
 
+#include "ARMRandezvousReport.h"
 #include "llvm/CodeGen/MachineFunctionPass.h"
 
 namespace llvm {
@@ -25,7 +26,14 @@ namespace llvm {
 
     ARMRandezvousICallLimiter();
     virtual StringRef getPassName() const override;
+    void getAnalysisUsage(AnalysisUsage & AU) const override;
+    virtual bool doInitialization(Module & M) override;
     virtual bool runOnMachineFunction(MachineFunction & MF) override;
+    virtual bool doFinalization(Module & M) override;
+
+  private:
+    // Report of the whole module, written once the module is finalized
+    RandezvousPassReport Report;
   };
 
   FunctionPass * createARMRandezvousICallLimiter(void);
@@ -0,0 +1,189 @@
+//===- ARMRandezvousICallPromote.cpp - ARM Randezvous ICall Promotion -----===//
+//
+// Copyright (c) 2021-2022, University of Rochester
+//
+// Part of the Randezvous Project, under the Apache License v2.0 with
+// LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+// information.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains the implementation of a pass that promotes hot indirect
+// calls to guarded direct calls according to indirect call value profiles.
+//
+// The indirect call limiter restricts the target register of every indirect
+// call to R0 -- R3 and R12, which adds copies and raises register pressure in
+// dispatch-heavy code.  This pass runs before instruction selection and turns
+// each target that takes a large enough share of the calls at a call site
+// into a direct call guarded by a comparison of the function pointer, so that
+// only truly polymorphic call sites keep a hot limited indirect call.  It
+// picks targets by their share of the whole call site instead of their share
+// of the remaining calls, as a limited indirect call costs more than a plain
+// one, and it also picks up call sites left alone by the generic indirect
+// call promotion.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "arm-randezvous-icall-promote"
+
+#include "ARMRandezvousICallPromote.h"
+#include "ARMRandezvousOptions.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Transforms/Instrumentation.h"
+#include "llvm/Transforms/Utils/CallPromotionUtils.h"
+
+using namespace llvm;
+
+STATISTIC(NumSitesPromoted, "Number of indirect call sites promoted");
+STATISTIC(NumSitesRemoved, "Number of indirect call sites left cold by promotion");
+STATISTIC(NumTargetsPromoted, "Number of indirect call targets promoted");
+STATISTIC(NumDynICallsPromoted, "Number of dynamic indirect calls promoted, per value profile counts");
+
+char ARMRandezvousICallPromote::ID = 0;
+
+ARMRandezvousICallPromote::ARMRandezvousICallPromote() : ModulePass(ID) {
+}
+
+StringRef
+ARMRandezvousICallPromote::getPassName() const {
+  return "ARM Randezvous Indirect Call Promotion Pass";
+}
+
+//
+// Method: promoteCallSite()
+//
+// Description:
+//   This method promotes the hot targets of an indirect call site to guarded
+//   direct calls, the hottest first, and updates the value profile of the
+//   remaining indirect call.
+//
+// Inputs:
+//   M      - A reference to the Module containing the call site.
+//   CB     - A reference to the indirect call.
+//   Symtab - A reference to the symbol table mapping profiled function names
+//            to functions.
+//
+// Return value:
+//   true  - The call site was promoted.
+//   false - The call site was not promoted.
+//
+bool
+ARMRandezvousICallPromote::promoteCallSite(Module & M, CallBase & CB,
+                                           InstrProfSymtab & Symtab) {
+  uint32_t MaxTargets = RandezvousICallPromoteMaxTargets;
+  std::unique_ptr<InstrProfValueData[]> VD =
+    std::make_unique<InstrProfValueData[]>(MaxTargets);
+  uint32_t NumVals;
+  uint64_t TotalCount;
+  if (MaxTargets == 0 ||
+      !getValueProfDataFromInst(CB, IPVK_IndirectCallTarget, MaxTargets,
+                                VD.get(), NumVals, TotalCount) ||
+      TotalCount == 0) {
+    return false;
+  }
+
+  // Promote every target that is hot enough and can be called directly; the
+  // other targets are skipped but kept for the value profile of the
+  // remaining indirect call
+  uint64_t RemainingCount = TotalCount;
+  uint32_t NumPromoted = 0;
+  std::vector<InstrProfValueData> Unpromoted;
+  for (uint32_t i = 0; i < NumVals; ++i) {
+    uint64_t Count = VD[i].Count;
+    Function * Target = Symtab.getFunction(VD[i].Value);
+    if (Count * 100 < RandezvousICallPromoteThreshold * TotalCount ||
+        Target == nullptr || !isLegalToPromote(CB, Target)) {
+      Unpromoted.push_back(VD[i]);
+      continue;
+    }
+
+    // Weigh the guard by the count of the target against the rest
+    uint64_t Scale = calculateCountScale(RemainingCount);
+    MDBuilder MDB(M.getContext());
+    MDNode * BranchWeights =
+      MDB.createBranchWeights(scaleBranchCount(Count, Scale),
+                              scaleBranchCount(RemainingCount - Count, Scale));
+    promoteCallWithIfThenElse(CB, Target, BranchWeights);
+
+    RemainingCount -= Count;
+    ++NumPromoted;
+    ++NumTargetsPromoted;
+    // This is the profiled count of calls that now go to a direct call; how
+    // many limiter copies go away is only known after register allocation
+    NumDynICallsPromoted += Count;
+  }
+  if (NumPromoted == 0) {
+    return false;
+  }
+
+  // Keep the value profile of the remaining indirect call up to date
+  CB.setMetadata(LLVMContext::MD_prof, nullptr);
+  if (RemainingCount != 0) {
+    annotateValueSite(M, CB, Unpromoted, RemainingCount,
+                      IPVK_IndirectCallTarget, MaxTargets);
+  } else {
+    ++NumSitesRemoved;
+  }
+
+  ++NumSitesPromoted;
+  return true;
+}
+
+//
+// Method: runOnModule()
+//
+// Description:
+//   This method is called when the PassManager wants this pass to transform
+//   the specified Module.  This method promotes hot targets of all indirect
+//   call sites with value profiles to guarded direct calls.
+//
+// Input:
+//   M - A reference to the Module to transform.
+//
+// Output:
+//   M - The transformed Module.
+//
+// Return value:
+//   true  - The Module was transformed.
+//   false - The Module was not transformed.
+//
+bool
+ARMRandezvousICallPromote::runOnModule(Module & M) {
+  if (!EnableRandezvousICallPromote) {
+    return false;
+  }
+
+  InstrProfSymtab Symtab;
+  if (Error E = Symtab.create(M)) {
+    consumeError(std::move(E));
+    return false;
+  }
+
+  // Collect indirect calls first, as promotion splits basic blocks
+  std::vector<CallBase *> ICalls;
+  for (Function & F : M) {
+    for (BasicBlock & BB : F) {
+      for (Instruction & I : BB) {
+        if (CallBase * CB = dyn_cast<CallBase>(&I)) {
+          if (CB->isIndirectCall() && !CB->isInlineAsm()) {
+            ICalls.push_back(CB);
+          }
+        }
+      }
+    }
+  }
+
+  bool changed = false;
+  for (CallBase * CB : ICalls) {
+    changed |= promoteCallSite(M, *CB, Symtab);
+  }
+
+  return changed;
+}
+
+ModulePass *
+llvm::createARMRandezvousICallPromote(void) {
+  return new ARMRandezvousICallPromote();
+}
@@ -0,0 +1,39 @@
+//===- ARMRandezvousICallPromote.h - ARM Randezvous ICall Promotion -------===//
+//
+// Copyright (c) 2021-2022, University of Rochester
+//
+// Part of the Randezvous Project, under the Apache License v2.0 with
+// LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+// information.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the interfaces of a pass that promotes hot indirect calls
+// to guarded direct calls according to indirect call value profiles.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef ARM_RANDEZVOUS_ICALL_PROMOTE
+#define ARM_RANDEZVOUS_ICALL_PROMOTE
+
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/Pass.h"
+#include "llvm/ProfileData/InstrProf.h"
+
+namespace llvm {
+  struct ARMRandezvousICallPromote : public ModulePass {
+    // Pass Identifier
+    static char ID;
+
+    ARMRandezvousICallPromote();
+    virtual StringRef getPassName() const override;
+    virtual bool runOnModule(Module & M) override;
+
+  private:
+    bool promoteCallSite(Module & M, CallBase & CB, InstrProfSymtab & Symtab);
+  };
+
+  ModulePass * createARMRandezvousICallPromote(void);
+}
+
+#endif
@@ -58,7 +58,8 @@ ARMRandezvousInstrumentor::getITBlockSize(const MachineInstr & IT) {
 //   This method finds the IT instruction that forms an IT block containing a
 //   given instruction MI.  It also computes the distance (from 0 to 4, 0 means
 //   MI itself is IT) between the IT and MI.  If there is no such IT, a null
-//   pointer is returned.
+//   pointer is returned.  The answer is looked up from the IT index of MI's
+//   basic block (see getITIndex()) instead of scanning backward from MI.
 //
 // Input:
 //   MI - A reference to an instruction from which to find IT.
@@ -71,22 +72,13 @@ ARMRandezvousInstrumentor::getITBlockSize(const MachineInstr & IT) {
 //
 MachineInstr *
 ARMRandezvousInstrumentor::findIT(MachineInstr & MI, unsigned & distance) {
-  MachineInstr * Prev = &MI;
-  unsigned dist = 0;
-  while (Prev != nullptr && dist < 5 && Prev->getOpcode() != ARM::t2IT) {
-    // Only count non-meta instructions
-    if (!Prev->isMetaInstruction()) {
-      ++dist;
-    }
-    Prev = Prev->getPrevNode();
+  const ITMember * Member = getITMember(MI);
+  if (Member == nullptr) {
+    return nullptr;
   }
-  if (Prev != nullptr && dist < 5 && Prev->getOpcode() == ARM::t2IT) {
-    if (getITBlockSize(*Prev) >= dist) {
-      distance = dist;
-      return Prev;
-    }
-  }
-  return nullptr;
+
+  distance = Member->Distance;
+  return Member->IT;
 }
 
 //
@@ -173,11 +165,22 @@ ARMRandezvousInstrumentor::insertInstsBefore(MachineInstr & MI,
   unsigned distance;
   MachineInstr * IT = findIT(MI, distance);
 
+  // The IT block containing MI is about to be rewritten
+  if (IT != nullptr && distance != 0) {
+    unindexITBlock(*IT);
+  }
+
   // Do insert new instructions before MI
   for (MachineInstr * Inst : Insts) {
     MBB.insert(MI, Inst);
+    forgetIT(*Inst);
   }
 
+  // Instructions whose liveness needs to be updated; MI is included in case
+  // the caller has modified it in place
+  MachineInstr * First = Insts.empty() ? &MI : Insts.front();
+  MachineInstr * Last = &MI;
+
   // If MI is inside an IT block, we should make sure to cover all new
   // instructions with IT(s)
   if (IT != nullptr && distance != 0) {
@@ -212,6 +215,7 @@ ARMRandezvousInstrumentor::insertInstsBefore(MachineInstr & MI,
     DQMask.insert(it, NumRealInsts, sameAsFirstCond);
 
     // Insert ITs to cover instructions in [firstMI, lastMI)
+    SmallVector<MachineInstr *, 4> NewITs;
     for (MachineBasicBlock::iterator i(firstMI); i != lastMI; ) {
       std::deque<bool> NewDQMask;
       MachineBasicBlock::iterator j(i);
@@ -230,15 +234,30 @@ ARMRandezvousInstrumentor::insertInstsBefore(MachineInstr & MI,
         }
         flip = true;
       }
-      BuildMI(MBB, i, IT->getDebugLoc(), TII->get(ARM::t2IT))
-      .addImm(flip ? ARMCC::getOppositeCondition(firstCond) : firstCond)
-      .addImm(encodeITMask(NewDQMask));
+      MachineInstr * NewIT = BuildMI(MBB, i, IT->getDebugLoc(),
+                                     TII->get(ARM::t2IT))
+                             .addImm(flip ? ARMCC::getOppositeCondition(firstCond)
+                                          : firstCond)
+                             .addImm(encodeITMask(NewDQMask));
+      if (i == firstMI) {
+        First = NewIT;
+      }
+      NewITs.push_back(NewIT);
       i = j; // Update i here
     }
+    Last = &*std::prev(lastMI);
 
     // Remove the original IT
+    forgetLiveness(*IT);
     IT->eraseFromParent();
+
+    // Index the new IT blocks
+    for (MachineInstr * NewIT : NewITs) {
+      indexITBlock(*NewIT);
+    }
   }
+
+  updateLiveness(*First, *Last);
 }
 
 //
@@ -267,11 +286,22 @@ ARMRandezvousInstrumentor::insertInstsAfter(MachineInstr & MI,
   unsigned distance;
   MachineInstr * IT = findIT(MI, distance);
 
+  // The IT block containing MI is about to be rewritten
+  if (IT != nullptr && distance != 0) {
+    unindexITBlock(*IT);
+  }
+
   // Do insert new instructions after MI
   for (MachineInstr * Inst : Insts) {
     MBB.insert(NextMI, Inst);
+    forgetIT(*Inst);
   }
 
+  // Instructions whose liveness needs to be updated; MI is included in case
+  // the caller has modified it in place
+  MachineInstr * First = &MI;
+  MachineInstr * Last = Insts.empty() ? &MI : Insts.back();
+
   // If MI is inside an IT block, we should make sure to cover all new
   // instructions with IT(s)
   if (IT != nullptr && distance != 0) {
@@ -306,6 +336,7 @@ ARMRandezvousInstrumentor::insertInstsAfter(MachineInstr & MI,
     DQMask.insert(it, NumRealInsts, sameAsFirstCond);
 
     // Insert ITs to cover instructions in [firstMI, lastMI)
+    SmallVector<MachineInstr *, 4> NewITs;
     for (MachineBasicBlock::iterator i(firstMI); i != lastMI; ) {
       std::deque<bool> NewDQMask;
       MachineBasicBlock::iterator j(i);
@@ -324,15 +355,30 @@ ARMRandezvousInstrumentor::insertInstsAfter(MachineInstr & MI,
         }
         flip = true;
       }
-      BuildMI(MBB, i, IT->getDebugLoc(), TII->get(ARM::t2IT))
-      .addImm(flip ? ARMCC::getOppositeCondition(firstCond) : firstCond)
-      .addImm(encodeITMask(NewDQMask));
+      MachineInstr * NewIT = BuildMI(MBB, i, IT->getDebugLoc(),
+                                     TII->get(ARM::t2IT))
+                             .addImm(flip ? ARMCC::getOppositeCondition(firstCond)
+                                          : firstCond)
+                             .addImm(encodeITMask(NewDQMask));
+      if (i == firstMI) {
+        First = NewIT;
+      }
+      NewITs.push_back(NewIT);
       i = j; // Update i here
     }
+    Last = &*std::prev(lastMI);
 
     // Remove the original IT
+    forgetLiveness(*IT);
     IT->eraseFromParent();
+
+    // Index the new IT blocks
+    for (MachineInstr * NewIT : NewITs) {
+      indexITBlock(*NewIT);
+    }
   }
+
+  updateLiveness(*First, *Last);
 }
 
 //
@@ -359,6 +405,8 @@ ARMRandezvousInstrumentor::removeInst(MachineInstr & MI) {
   if (IT != nullptr) {
     assert(distance != 0 && "Cannot remove an IT instruction directly!");
 
+    unindexITBlock(*IT);
+
     unsigned Mask = IT->getOperand(1).getImm() & 0xf;
     ARMCC::CondCodes firstCond = (ARMCC::CondCodes)IT->getOperand(0).getImm();
     std::deque<bool> DQMask = decodeITMask(Mask);
@@ -372,7 +420,9 @@ ARMRandezvousInstrumentor::removeInst(MachineInstr & MI) {
 
     // Remove IT as well if MI was the only instruction in the IT block
     if (DQMask.empty()) {
+      forgetLiveness(*IT);
       IT->eraseFromParent();
+      IT = nullptr;
     } else {
       // If MI was the first instruction in the IT block, removing MI might
       // change the first condition, in which case we need to flip it
@@ -387,8 +437,21 @@ ARMRandezvousInstrumentor::removeInst(MachineInstr & MI) {
     }
   }
 
-  // Now do remove MI
+  // Now do remove MI and update the liveness of its preceding instructions
+  MachineBasicBlock & MBB = *MI.getParent();
+  MachineBasicBlock::iterator NextMI(MI); ++NextMI;
+  forgetLiveness(MI);
+  forgetIT(MI);
   MI.eraseFromParent();
+  if (NextMI != MBB.begin()) {
+    MachineInstr & PrevMI = *std::prev(NextMI);
+    updateLiveness(PrevMI, PrevMI);
+  }
+
+  // Index the updated IT block
+  if (IT != nullptr) {
+    indexITBlock(*IT);
+  }
 }
 
 //
@@ -432,6 +495,11 @@ ARMRandezvousInstrumentor::splitBasicBlockBefore(MachineInstr & MI) {
   NewMBB.transferSuccessors(&MBB);
   MBB.addSuccessor(&NewMBB);
 
+  // Liveness and IT index of both basic blocks will be recomputed when next
+  // queried
+  invalidateCache(MBB);
+  invalidateCache(NewMBB);
+
   // If MI was inside an IT block (but not the IT instruction itself), we
   // should make sure to update/remove the IT instruction and insert a new IT
   // in the new basic block
@@ -515,6 +583,11 @@ ARMRandezvousInstrumentor::splitBasicBlockAfter(MachineInstr & MI) {
   NewMBB.transferSuccessors(&MBB);
   MBB.addSuccessor(&NewMBB);
 
+  // Liveness and IT index of both basic blocks will be recomputed when next
+  // queried
+  invalidateCache(MBB);
+  invalidateCache(NewMBB);
+
   // If MI was inside an IT block and is not the last one, we should make sure
   // to update/remove the IT instruction and insert a new IT in the new basic
   // block
@@ -625,14 +698,15 @@ ARMRandezvousInstrumentor::encodeITMask(std::deque<bool> DQMask) {
 
   return Mask;
 }
-
 //
 // Method: findFreeRegistersBefore()
 //
 // Description:
 //   This method computes the liveness of ARM core registers before a given
 //   instruction MI and returns a list of free core registers that can be
-//   used for instrumentation purposes.
+//   used for instrumentation purposes.  Liveness is looked up from the cache
+//   of MI's basic block (see getBlockLiveness()), so repeated queries on the
+//   same basic block take amortized constant time.
 //
 // Inputs:
 //   MI    - A reference to the instruction before which to find free
@@ -647,176 +721,549 @@ ARMRandezvousInstrumentor::encodeITMask(std::deque<bool> DQMask) {
 std::vector<Register>
 ARMRandezvousInstrumentor::findFreeRegistersBefore(const MachineInstr & MI,
                                                    bool Thumb) {
-  assert(!MI.isMetaInstruction() && "Cannot instrument meta instruction!");
+  return findFreeRegisters(MI, false, Thumb);
+}
 
-  unsigned distance;
-  const MachineInstr * IT = findIT(MI, distance);
+//
+// Method: findFreeRegistersAfter()
+//
+// Description:
+//   This method computes the liveness of ARM core registers after a given
+//   instruction MI and returns a list of free core registers that can be
+//   used for instrumentation purposes.  Liveness is looked up from the cache
+//   of MI's basic block (see getBlockLiveness()), so repeated queries on the
+//   same basic block take amortized constant time.
+//
+// Inputs:
+//   MI    - A reference to the instruction after which to find free
+//           registers.
+//   Thumb - Whether we are looking for Thumb registers (low registers, i,e,,
+//           R0 -- R7) or ARM registers (both low and high registers, i.e.,
+//           R0 -- R12 and LR).
+//
+// Return value:
+//   A vector of free registers (might be empty, if none is found).
+//
+std::vector<Register>
+ARMRandezvousInstrumentor::findFreeRegistersAfter(const MachineInstr & MI,
+                                                  bool Thumb) {
+  return findFreeRegisters(MI, true, Thumb);
+}
 
-  Register PredReg;
-  ARMCC::CondCodes Pred = getInstrPredicate(MI, PredReg);
+//
+// Method: invalidateCache()
+//
+// Description:
+//   This method drops the cached liveness and IT index of all basic blocks.
+//   Subclasses should call it once they are done with a machine function, or
+//   after they modify machine IR without using the methods of this class.
+//
+void
+ARMRandezvousInstrumentor::invalidateCache() {
+  LivenessCache.clear();
+  ITIndex.clear();
+}
 
-  const MachineFunction & MF = *MI.getMF();
-  const MachineBasicBlock & MBB = *MI.getParent();
-  const MachineRegisterInfo & MRI = MF.getRegInfo();
-  const TargetRegisterInfo * TRI = MF.getSubtarget().getRegisterInfo();
-  LivePhysRegs UsedRegs(*TRI);
+//
+// Method: invalidateCache()
+//
+// Description:
+//   This method drops the cached liveness and IT index of a given basic
+//   block.  Subclasses should call it after they modify the basic block
+//   without using the methods of this class.
+//
+// Input:
+//   MBB - A const reference to the basic block.
+//
+void
+ARMRandezvousInstrumentor::invalidateCache(const MachineBasicBlock & MBB) {
+  LivenessCache.erase(&MBB);
+  ITIndex.erase(&MBB);
+}
 
-  // First add live-out registers of MBB; these registers are considered live
-  // at the end of MBB
-  UsedRegs.addLiveOuts(MBB);
+//
+// Method: getITIndex()
+//
+// Description:
+//   This method returns the IT index of a given basic block, which maps each
+//   instruction in an IT block (including the IT instruction itself) to its
+//   membership in the IT block.  If the basic block is not indexed yet, it is
+//   indexed in a single forward walk over the basic block.
+//
+// Input:
+//   MBB - A const reference to the basic block.
+//
+// Return value:
+//   A reference to the IT index of MBB.
+//
+ARMRandezvousInstrumentor::ITMembers &
+ARMRandezvousInstrumentor::getITIndex(const MachineBasicBlock & MBB) {
+  auto It = ITIndex.find(&MBB);
+  if (It != ITIndex.end()) {
+    return It->second;
+  }
 
-  // Then move backward step by step to compute live registers before MI
-  MachineBasicBlock::const_iterator MBBI(MI);
-  MachineBasicBlock::const_iterator I = MBB.end();
-  while (I != MBBI) {
-    unsigned distance2;
-    const MachineInstr * IT2 = findIT(*--I, distance2);
-    Register PredReg2;
-    ARMCC::CondCodes Pred2 = getInstrPredicate(*I, PredReg2);
-
-    if (IT2 != nullptr && IT == IT2) {
-      // Skip instructions in the same IT block but with a different predicate
-      if (Pred != Pred2) {
-        continue;
-      }
+  ITMembers & Members = ITIndex[&MBB];
+  for (const MachineInstr & MI : MBB) {
+    if (MI.getOpcode() == ARM::t2IT) {
+      indexITBlock(const_cast<MachineInstr &>(MI));
+    }
+  }
 
-      // A return in the same IT block with the same predicate can reset live
-      // registers to the callee-saved registers
-      if (I->isReturn()) {
-        UsedRegs.init(*TRI);
-        for (auto CSR = MRI.getCalleeSavedRegs(); CSR && *CSR; ++CSR) {
-          UsedRegs.addReg(*CSR);
-        }
+  return Members;
+}
+
+//
+// Method: getITMember()
+//
+// Description:
+//   This method looks up the membership of a given instruction MI in an IT
+//   block.
+//
+// Input:
+//   MI - A const reference to the instruction.
+//
+// Return value:
+//   A const pointer to the membership of MI if MI is in an IT block, nullptr
+//   otherwise.
+//
+const ARMRandezvousInstrumentor::ITMember *
+ARMRandezvousInstrumentor::getITMember(const MachineInstr & MI) {
+  ITMembers & Members = getITIndex(*MI.getParent());
+  auto It = Members.find(&MI);
+  return It == Members.end() ? nullptr : &It->second;
+}
+
+//
+// Method: indexITBlock()
+//
+// Description:
+//   This method adds an IT instruction and the instructions it covers to the
+//   IT index of its basic block, together with the predicate each covered
+//   instruction gets from the IT mask.  Meta instructions in between are
+//   considered members as well, with the distance of the last non-meta
+//   instruction before them and no predicate.  Nothing is done if the basic
+//   block is not indexed yet.
+//
+// Input:
+//   IT - A reference to the IT instruction.
+//
+void
+ARMRandezvousInstrumentor::indexITBlock(MachineInstr & IT) {
+  assert(IT.getOpcode() == ARM::t2IT && "Not an IT instruction!");
+
+  MachineBasicBlock & MBB = *IT.getParent();
+  auto It = ITIndex.find(&MBB);
+  if (It == ITIndex.end()) {
+    return;
+  }
+  ITMembers & Members = It->second;
+
+  unsigned Mask = IT.getOperand(1).getImm() & 0xf;
+  ARMCC::CondCodes firstCond = (ARMCC::CondCodes)IT.getOperand(0).getImm();
+  std::deque<bool> DQMask = decodeITMask(Mask);
+
+  Members[&IT] = { &IT, 0, ARMCC::AL };
+  unsigned distance = 0;
+  for (MachineBasicBlock::iterator I(IT), E = MBB.end(); ++I != E; ) {
+    ARMCC::CondCodes Pred = ARMCC::AL;
+    if (!I->isMetaInstruction()) {
+      if (distance == DQMask.size()) {
+        break;
       }
+      Pred = DQMask[distance] ? firstCond
+                              : ARMCC::getOppositeCondition(firstCond);
+      ++distance;
     }
+    Members[&*I] = { &IT, distance, Pred };
+  }
+}
 
-    UsedRegs.stepBackward(*I);
+//
+// Method: unindexITBlock()
+//
+// Description:
+//   This method removes an IT instruction and the instructions it covers from
+//   the IT index of its basic block.  It should be called before the IT block
+//   is rewritten.
+//
+// Input:
+//   IT - A const reference to the IT instruction.
+//
+void
+ARMRandezvousInstrumentor::unindexITBlock(const MachineInstr & IT) {
+  const MachineBasicBlock & MBB = *IT.getParent();
+  auto It = ITIndex.find(&MBB);
+  if (It == ITIndex.end()) {
+    return;
   }
+  ITMembers & Members = It->second;
 
-  // Now add registers that are neither reserved nor live to a free list
-  const auto LoGPRs = {
-    ARM::R0, ARM::R1, ARM::R2, ARM::R3, ARM::R4, ARM::R5, ARM::R6, ARM::R7,
-  };
-  const auto HiGPRs = {
-    ARM::R8, ARM::R9, ARM::R10, ARM::R11, ARM::R12, ARM::LR,
-  };
-  std::vector<Register> FreeRegs;
-  for (Register Reg : LoGPRs) {
-    if (!MRI.isReserved(Reg) && !UsedRegs.contains(Reg)) {
-      FreeRegs.push_back(Reg);
+  for (MachineBasicBlock::const_iterator I(IT), E = MBB.end(); I != E; ++I) {
+    auto Member = Members.find(&*I);
+    if (Member == Members.end() || Member->second.IT != &IT) {
+      break;
     }
+    Members.erase(Member);
   }
-  if (!Thumb) {
-    for (Register Reg : HiGPRs) {
-      if (!MRI.isReserved(Reg) && !UsedRegs.contains(Reg)) {
-        FreeRegs.push_back(Reg);
+}
+
+//
+// Method: forgetIT()
+//
+// Description:
+//   This method removes an instruction that is about to be erased or has just
+//   been inserted from the IT index of its basic block, so that a stale entry
+//   left by an erased instruction at the same address would not be picked up.
+//
+// Input:
+//   MI - A const reference to the instruction.
+//
+void
+ARMRandezvousInstrumentor::forgetIT(const MachineInstr & MI) {
+  auto It = ITIndex.find(MI.getParent());
+  if (It != ITIndex.end()) {
+    It->second.erase(&MI);
+  }
+}
+
+//
+// ARM core registers tracked by the liveness cache, in the order of their
+// bits in a liveness mask.
+//
+static const MCPhysReg CoreRegs[] = {
+  ARM::R0, ARM::R1, ARM::R2, ARM::R3, ARM::R4, ARM::R5, ARM::R6, ARM::R7,
+  ARM::R8, ARM::R9, ARM::R10, ARM::R11, ARM::R12, ARM::LR,
+};
+
+//
+// Function: getLivenessMask()
+//
+// Description:
+//   This function encodes which ARM core registers in a LivePhysRegs are live
+//   into a bit mask.
+//
+static uint16_t
+getLivenessMask(const LivePhysRegs & UsedRegs) {
+  uint16_t Mask = 0;
+  for (unsigned i = 0; i < array_lengthof(CoreRegs); ++i) {
+    if (UsedRegs.contains(CoreRegs[i])) {
+      Mask |= 1u << i;
+    }
+  }
+  return Mask;
+}
+
+//
+// Function: setLivenessMask()
+//
+// Description:
+//   This function resets a LivePhysRegs to contain exactly the ARM core
+//   registers in a bit mask.
+//
+static void
+setLivenessMask(LivePhysRegs & UsedRegs, const TargetRegisterInfo & TRI,
+                uint16_t Mask) {
+  UsedRegs.init(TRI);
+  for (unsigned i = 0; i < array_lengthof(CoreRegs); ++i) {
+    if (Mask & (1u << i)) {
+      UsedRegs.addReg(CoreRegs[i]);
+    }
+  }
+}
+
+//
+// Function: getReturnUsesMask()
+//
+// Description:
+//   This function returns the bit mask of ARM core registers used by the
+//   return instruction that ends a basic block, if there is one.
+//
+static uint16_t
+getReturnUsesMask(const MachineBasicBlock & MBB,
+                  const TargetRegisterInfo & TRI) {
+  MachineBasicBlock::const_iterator Terminator = MBB.getLastNonDebugInstr();
+  if (Terminator == MBB.end() || !Terminator->isReturn()) {
+    return 0;
+  }
+
+  LivePhysRegs UsedRegs(TRI);
+  UsedRegs.addUses(*Terminator);
+  return getLivenessMask(UsedRegs);
+}
+
+//
+// Method: getBlockLiveness()
+//
+// Description:
+//   This method returns the cached liveness of ARM core registers in a given
+//   basic block.  If the basic block is not cached yet, its liveness is
+//   computed in a single backward walk over the basic block, without regard
+//   to IT blocks, and then cached.
+//
+// Input:
+//   MBB - A const reference to the basic block.
+//
+// Return value:
+//   A reference to the cached liveness of MBB.
+//
+ARMRandezvousInstrumentor::BlockLiveness &
+ARMRandezvousInstrumentor::getBlockLiveness(const MachineBasicBlock & MBB) {
+  auto It = LivenessCache.find(&MBB);
+  if (It != LivenessCache.end()) {
+    return It->second;
+  }
+
+  const TargetRegisterInfo * TRI = MBB.getParent()->getSubtarget().getRegisterInfo();
+  BlockLiveness & BL = LivenessCache[&MBB];
+  LivePhysRegs UsedRegs(*TRI);
+
+  // Live-out registers of MBB are considered live at the end of MBB
+  UsedRegs.addLiveOuts(MBB);
+  BL.LiveOut = getLivenessMask(UsedRegs);
+  BL.ReturnUses = getReturnUsesMask(MBB, *TRI);
+
+  // Move backward step by step to compute live registers before each
+  // instruction
+  for (const MachineInstr & MI : make_range(MBB.rbegin(), MBB.rend())) {
+    UsedRegs.stepBackward(MI);
+    BL.LiveBefore[&MI] = getLivenessMask(UsedRegs);
+  }
+
+  return BL;
+}
+
+//
+// Method: getLiveBefore()
+//
+// Description:
+//   This method returns the cached liveness of ARM core registers right
+//   before a given instruction.  If the instruction is missing from the cache
+//   because its basic block was changed behind our back, the liveness of the
+//   basic block is recomputed from scratch.
+//
+// Input:
+//   MI - A const reference to the instruction.
+//
+// Return value:
+//   A bit mask of the ARM core registers live right before MI.
+//
+uint16_t
+ARMRandezvousInstrumentor::getLiveBefore(const MachineInstr & MI) {
+  const MachineBasicBlock & MBB = *MI.getParent();
+  BlockLiveness & BL = getBlockLiveness(MBB);
+  auto It = BL.LiveBefore.find(&MI);
+  if (It != BL.LiveBefore.end()) {
+    return It->second;
+  }
+
+  // The basic block was changed behind our back; start over
+  LivenessCache.erase(&MBB);
+  BlockLiveness & NewBL = getBlockLiveness(MBB);
+  It = NewBL.LiveBefore.find(&MI);
+  assert(It != NewBL.LiveBefore.end() && "Instruction not in basic block!");
+  return It->second;
+}
+
+//
+// Method: updateLiveness()
+//
+// Description:
+//   This method updates the cached liveness of a basic block after a range
+//   of its instructions have been inserted or modified.  Liveness is
+//   recomputed for every instruction in the range and then propagated
+//   backward until it agrees with the cached liveness again, so the cost is
+//   proportional to the number of instructions actually affected.
+//
+// Inputs:
+//   First - A const reference to the first instruction of the range.
+//   Last  - A const reference to the last instruction of the range.
+//
+void
+ARMRandezvousInstrumentor::updateLiveness(const MachineInstr & First,
+                                          const MachineInstr & Last) {
+  const MachineBasicBlock & MBB = *Last.getParent();
+  auto It = LivenessCache.find(&MBB);
+  if (It == LivenessCache.end()) {
+    // Nothing cached; liveness will be computed when first queried
+    return;
+  }
+
+  const TargetRegisterInfo * TRI = MBB.getParent()->getSubtarget().getRegisterInfo();
+  BlockLiveness & BL = It->second;
+  LivePhysRegs UsedRegs(*TRI);
+
+  // Start from the liveness right after Last
+  MachineBasicBlock::const_iterator I(Last);
+  if (++I == MBB.end()) {
+    BL.ReturnUses = getReturnUsesMask(MBB, *TRI);
+    setLivenessMask(UsedRegs, *TRI, BL.LiveOut);
+  } else {
+    auto Next = BL.LiveBefore.find(&*I);
+    if (Next == BL.LiveBefore.end()) {
+      // The basic block was changed behind our back; start over
+      LivenessCache.erase(It);
+      return;
+    }
+    setLivenessMask(UsedRegs, *TRI, Next->second);
+  }
+
+  bool InRange = true;
+  while (I != MBB.begin()) {
+    --I;
+    UsedRegs.stepBackward(*I);
+    uint16_t Mask = getLivenessMask(UsedRegs);
+
+    // Stop once we are out of the range and nothing changes anymore
+    if (!InRange) {
+      auto Old = BL.LiveBefore.find(&*I);
+      if (Old != BL.LiveBefore.end() && Old->second == Mask) {
+        break;
       }
     }
+
+    BL.LiveBefore[&*I] = Mask;
+    if (&*I == &First) {
+      InRange = false;
+    }
   }
+}
 
-  return FreeRegs;
+//
+// Method: forgetLiveness()
+//
+// Description:
+//   This method removes the cached liveness of an instruction that is about
+//   to be erased, so that a new instruction allocated at the same address
+//   would not pick it up.
+//
+// Input:
+//   MI - A const reference to the instruction.
+//
+void
+ARMRandezvousInstrumentor::forgetLiveness(const MachineInstr & MI) {
+  auto It = LivenessCache.find(MI.getParent());
+  if (It != LivenessCache.end()) {
+    It->second.LiveBefore.erase(&MI);
+  }
 }
 
 //
-// Method: findFreeRegistersAfter()
+// Method: findFreeRegisters()
 //
 // Description:
-//   This method computes the liveness of ARM core registers after a given
-//   instruction MI and returns a list of free core registers that can be
-//   used for instrumentation purposes.
+//   This method finds free ARM core registers either before or after a given
+//   instruction MI.  If MI is not in an IT block, the answer comes straight
+//   from the liveness cache.  Otherwise, liveness is recomputed from the end
+//   of MI's IT block, taking into account that instructions with a different
+//   predicate do not execute together with MI and that a return with the
+//   same predicate ends the function.
 //
 // Inputs:
-//   MI    - A reference to the instruction after which to find free
+//   MI    - A const reference to the instruction around which to find free
 //           registers.
-//   Thumb - Whether we are looking for Thumb registers (low registers, i,e,,
-//           R0 -- R7) or ARM registers (both low and high registers, i.e.,
-//           R0 -- R12 and LR).
+//   After - Whether to find free registers after MI (or before MI).
+//   Thumb - Whether we are looking for low registers only.
 //
 // Return value:
 //   A vector of free registers (might be empty, if none is found).
 //
 std::vector<Register>
-ARMRandezvousInstrumentor::findFreeRegistersAfter(const MachineInstr & MI,
-                                                  bool Thumb) {
+ARMRandezvousInstrumentor::findFreeRegisters(const MachineInstr & MI,
+                                             bool After, bool Thumb) {
   assert(!MI.isMetaInstruction() && "Cannot instrument meta instruction!");
 
-  unsigned distance;
-  const MachineInstr * IT = findIT(MI, distance);
-
-  Register PredReg;
-  ARMCC::CondCodes Pred = getInstrPredicate(MI, PredReg);
+  const ITMember * Member = getITMember(MI);
 
   const MachineFunction & MF = *MI.getMF();
   const MachineBasicBlock & MBB = *MI.getParent();
   const MachineRegisterInfo & MRI = MF.getRegInfo();
   const TargetRegisterInfo * TRI = MF.getSubtarget().getRegisterInfo();
-  LivePhysRegs UsedRegs(*TRI);
-
-  // First add live-out registers of MBB; these registers are considered live
-  // at the end of MBB
-  UsedRegs.addLiveOuts(MBB);
 
-  // If there is a return, add registers used by the return as well; here the
-  // rationale is that, if MI is the return, MI will not be stepped over and
-  // therefore the (potentially live) registers used in MI would not be counted
-  MachineBasicBlock::const_iterator Terminator = MBB.getLastNonDebugInstr();
-  if (Terminator != MBB.end() && Terminator->isReturn()) {
-    UsedRegs.addUses(*Terminator);
-  }
-
-  // Then move backward step by step to compute live registers after MI
-  MachineBasicBlock::const_iterator MBBI(MI);
-  MachineBasicBlock::const_iterator I = MBB.end();
-  while (I != MBBI) {
-    unsigned distance2;
-    const MachineInstr * IT2 = findIT(*--I, distance2);
-    Register PredReg2;
-    ARMCC::CondCodes Pred2 = getInstrPredicate(*I, PredReg2);
-
-    if (IT2 != nullptr && IT == IT2) {
-      // Skip instructions in the same IT block but with a different predicate
-      if (Pred != Pred2) {
-        continue;
+  uint16_t Live;
+  if (Member == nullptr) {
+    MachineBasicBlock::const_iterator Next(MI);
+    ++Next;
+    if (!After) {
+      Live = getLiveBefore(MI);
+    } else if (Next == MBB.end()) {
+      // If MI is the return, the (potentially live) registers used in MI are
+      // considered live after MI
+      const BlockLiveness & BL = getBlockLiveness(MBB);
+      Live = BL.LiveOut | BL.ReturnUses;
+    } else {
+      Live = getLiveBefore(*Next);
+    }
+  } else {
+    const MachineInstr * IT = Member->IT;
+    ARMCC::CondCodes Pred = Member->Pred;
+
+    // Find the end of the IT block
+    MachineBasicBlock::const_iterator End(*IT);
+    for (++End; End != MBB.end(); ++End) {
+      const ITMember * Member2 = getITMember(*End);
+      if (Member2 == nullptr || Member2->IT != IT) {
+        break;
       }
+    }
+
+    LivePhysRegs UsedRegs(*TRI);
+    if (End == MBB.end()) {
+      const BlockLiveness & BL = getBlockLiveness(MBB);
+      setLivenessMask(UsedRegs, *TRI,
+                      After ? BL.LiveOut | BL.ReturnUses : BL.LiveOut);
+    } else {
+      setLivenessMask(UsedRegs, *TRI, getLiveBefore(*End));
+    }
 
-      // A return in the same IT block with the same predicate can reset live
-      // registers to the callee-saved registers
-      if (I->isReturn()) {
-        UsedRegs.init(*TRI);
-        for (auto CSR = MRI.getCalleeSavedRegs(); CSR && *CSR; ++CSR) {
-          UsedRegs.addReg(*CSR);
+    // Then move backward step by step to compute live registers before or
+    // after MI
+    MachineBasicBlock::const_iterator MBBI(MI);
+    MachineBasicBlock::const_iterator I = End;
+    while (I != MBBI) {
+      const ITMember * Member2 = getITMember(*--I);
+
+      if (Member2 != nullptr && IT == Member2->IT) {
+        // Skip instructions in the same IT block but with a different
+        // predicate
+        if (Pred != Member2->Pred) {
+          continue;
         }
 
-        // Add registers used by the return; if MI is the return, MI will not
-        // be stepped over and therefore the (potentially live) registers used
-        // in MI would not be counted
-        UsedRegs.addUses(*I);
+        // A return in the same IT block with the same predicate can reset
+        // live registers to the callee-saved registers
+        if (I->isReturn()) {
+          UsedRegs.init(*TRI);
+          for (auto CSR = MRI.getCalleeSavedRegs(); CSR && *CSR; ++CSR) {
+            UsedRegs.addReg(*CSR);
+          }
+
+          // Add registers used by the return; if MI is the return, MI will
+          // not be stepped over and therefore the (potentially live)
+          // registers used in MI would not be counted
+          if (After) {
+            UsedRegs.addUses(*I);
+          }
+        }
       }
-    }
 
-    if (I != MBBI) {
-      UsedRegs.stepBackward(*I);
+      if (!After || I != MBBI) {
+        UsedRegs.stepBackward(*I);
+      }
     }
+
+    Live = getLivenessMask(UsedRegs);
   }
 
-  // Now add registers that are neither reserved nor live to a free list
-  const auto LoGPRs = {
-    ARM::R0, ARM::R1, ARM::R2, ARM::R3, ARM::R4, ARM::R5, ARM::R6, ARM::R7,
-  };
-  const auto HiGPRs = {
-    ARM::R8, ARM::R9, ARM::R10, ARM::R11, ARM::R12, ARM::LR,
-  };
+  // Now add registers that are neither reserved nor live to a free list; the
+  // first 8 core registers are low registers
   std::vector<Register> FreeRegs;
-  for (Register Reg : LoGPRs) {
-    if (!MRI.isReserved(Reg) && !UsedRegs.contains(Reg)) {
-      FreeRegs.push_back(Reg);
+  for (unsigned i = 0; i < array_lengthof(CoreRegs); ++i) {
+    if (Thumb && i >= 8) {
+      break;
     }
-  }
-  if (!Thumb) {
-    for (Register Reg : HiGPRs) {
-      if (!MRI.isReserved(Reg) && !UsedRegs.contains(Reg)) {
-        FreeRegs.push_back(Reg);
-      }
+    if (!MRI.isReserved(CoreRegs[i]) && !(Live & (1u << i))) {
+      FreeRegs.push_back(CoreRegs[i]);
     }
   }
 
@@ -18,8 +18,18 @@
 #define ARM_RANDEZVOUS_INSTRUMENTOR
 
 #include "ARMBaseInstrInfo.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MD5.h"
+
+#include <random>
 
 namespace llvm {
+  // Random number generator used by Randezvous passes
+  typedef std::mt19937_64 RandezvousRNG;
+
   //====================================================================
   // Static inline functions.
   //====================================================================
@@ -142,6 +152,159 @@ namespace llvm {
     return Constant::getNullValue(Ty);
   }
 
+  //
+  // Function: findTrapInst()
+  //
+  // Description:
+  //   This function locates a trap instruction by its index among all the trap
+  //   instructions held by a list of trap blocks.  Each trap block holds one or
+  //   more consecutive 4-byte trap instructions.
+  //
+  // Inputs:
+  //   TrapBlocks   - A reference to an array of trap blocks.
+  //   TrapInstEnds - A reference to an array containing, for each trap block,
+  //                  the total number of trap instructions held by the trap
+  //                  block and all the trap blocks before it.
+  //   Idx          - The index of the trap instruction to locate.
+  //
+  // Output:
+  //   Offset - A reference to a uint64_t to store the offset (in bytes) of the
+  //            trap instruction from the beginning of its trap block.
+  //
+  // Return value:
+  //   A pointer to the trap block holding the trap instruction.
+  //
+  static inline MachineBasicBlock *
+  findTrapInst(ArrayRef<MachineBasicBlock *> TrapBlocks,
+               ArrayRef<uint64_t> TrapInstEnds, uint64_t Idx,
+               uint64_t & Offset) {
+    assert(Idx < TrapInstEnds.back() && "Invalid trap instruction index!");
+
+    auto It = std::upper_bound(TrapInstEnds.begin(), TrapInstEnds.end(), Idx);
+    uint64_t i = It - TrapInstEnds.begin();
+    uint64_t Begin = i == 0 ? 0 : TrapInstEnds[i - 1];
+    Offset = (Idx - Begin) * 4;
+    return TrapBlocks[i];
+  }
+
+  //
+  // Function: createTrapInstAddress()
+  //
+  // Description:
+  //   This function creates a Constant that represents the address of a trap
+  //   instruction held by a trap block.
+  //
+  // Inputs:
+  //   TrapBlock - A reference to the trap block.
+  //   Offset    - The offset (in bytes) of the trap instruction from the
+  //               beginning of the trap block.
+  //
+  // Return value:
+  //   A pointer to a created Constant of type i8*.
+  //
+  static inline Constant *
+  createTrapInstAddress(const MachineBasicBlock & TrapBlock, uint64_t Offset) {
+    const BasicBlock * BB = TrapBlock.getBasicBlock();
+    assert(BB != nullptr && "No corresponding BB for a trap block!");
+
+    Constant * BA = BlockAddress::get(const_cast<BasicBlock *>(BB));
+    if (Offset == 0) {
+      return BA;
+    }
+
+    LLVMContext & Ctx = BB->getContext();
+    return ConstantExpr::getGetElementPtr(Type::getInt8Ty(Ctx), BA,
+                                          ConstantInt::get(Type::getInt32Ty(Ctx),
+                                                           Offset));
+  }
+
+  //
+  // Function: createRandezvousRNG()
+  //
+  // Description:
+  //   This function creates a random number generator dedicated to a global
+  //   value.  The generator is seeded from a seed, a purpose that tells apart
+  //   multiple streams of the same global value, and a hash of the global
+  //   value's identifier; so the random numbers a function or global gets do
+  //   not change when other functions or globals are added, removed,
+  //   reordered, or compiled in other modules.
+  //
+  //   The identifier of a global value with local linkage includes the
+  //   source file name of its module, so that same-named local functions and
+  //   globals in different modules get different streams.  An unnamed global
+  //   value is identified by its position among the unnamed global values of
+  //   its module instead.
+  //
+  // Inputs:
+  //   Seed    - The seed of the pass.
+  //   Purpose - The purpose of the random number stream.
+  //   GV      - A const reference to the global value.
+  //
+  // Return value:
+  //   A unique pointer to the created random number generator.
+  //
+  static inline std::unique_ptr<RandezvousRNG>
+  createRandezvousRNG(uint64_t Seed, const Twine & Purpose,
+                      const GlobalValue & GV) {
+    SmallString<64> Salt;
+    Purpose.toVector(Salt);
+    Salt.push_back('\0');
+    if (GV.hasName()) {
+      Salt += GV.getGlobalIdentifier();
+    } else {
+      const Module * M = GV.getParent();
+      assert(M != nullptr && "Global value not in a module!");
+      uint64_t Index = 0;
+      for (const GlobalValue & Other : M->global_values()) {
+        if (&Other == &GV) {
+          break;
+        }
+        if (!Other.hasName()) {
+          ++Index;
+        }
+      }
+      Salt += GlobalValue::getGlobalIdentifier("<unnamed>." + utostr(Index),
+                                               GlobalValue::InternalLinkage,
+                                               M->getSourceFileName());
+    }
+    uint64_t Hash = MD5Hash(Salt);
+
+    std::seed_seq SeedSeq {
+      static_cast<uint32_t>(Seed), static_cast<uint32_t>(Seed >> 32),
+      static_cast<uint32_t>(Hash), static_cast<uint32_t>(Hash >> 32),
+    };
+    return std::make_unique<RandezvousRNG>(SeedSeq);
+  }
+
+  //
+  // Function: shuffleGlobalValues()
+  //
+  // Description:
+  //   This function shuffles a list of global values such that the relative
+  //   order of any two of them depends only on themselves: each global value
+  //   draws a random key from its own random number stream, and the list is
+  //   sorted by the keys.
+  //
+  // Inputs:
+  //   GVs     - A reference to the list of global values.
+  //   Seed    - The seed of the pass.
+  //   Purpose - The purpose of the random number streams.
+  //   GetGV   - A callable that returns the global value of a list element.
+  //
+  template <typename T, typename GetGVTy>
+  static inline void
+  shuffleGlobalValues(std::vector<T> & GVs, uint64_t Seed,
+                      const Twine & Purpose, GetGVTy GetGV) {
+    DenseMap<const GlobalValue *, uint64_t> Keys;
+    for (const T & Elem : GVs) {
+      const GlobalValue * GV = GetGV(Elem);
+      Keys[GV] = (*createRandezvousRNG(Seed, Purpose, *GV))();
+    }
+    std::stable_sort(GVs.begin(), GVs.end(), [&](const T & A, const T & B) {
+      return Keys[GetGV(A)] < Keys[GetGV(B)];
+    });
+  }
+
   //====================================================================
   // Class ARMRandezvousInstrumentor.
   //====================================================================
@@ -166,7 +329,50 @@ namespace llvm {
     std::vector<Register> findFreeRegistersAfter(const MachineInstr & MI,
                                                  bool Thumb = false);
 
+    void invalidateCache();
+    void invalidateCache(const MachineBasicBlock & MBB);
+
   private:
+    // Liveness of ARM core registers (R0 -- R12 and LR) in a basic block, each
+    // encoded as a bit mask
+    struct BlockLiveness {
+      // Registers live right before each instruction
+      DenseMap<const MachineInstr *, uint16_t> LiveBefore;
+      // Registers live at the end of the basic block
+      uint16_t LiveOut = 0;
+      // Registers used by the return instruction ending the basic block
+      uint16_t ReturnUses = 0;
+    };
+
+    DenseMap<const MachineBasicBlock *, BlockLiveness> LivenessCache;
+
+    BlockLiveness & getBlockLiveness(const MachineBasicBlock & MBB);
+    uint16_t getLiveBefore(const MachineInstr & MI);
+    void updateLiveness(const MachineInstr & First, const MachineInstr & Last);
+    void forgetLiveness(const MachineInstr & MI);
+    std::vector<Register> findFreeRegisters(const MachineInstr & MI,
+                                            bool After, bool Thumb);
+
+    // Membership of an instruction in an IT block
+    struct ITMember {
+      // The IT instruction
+      MachineInstr * IT;
+      // Number of non-meta instructions from the IT to the instruction
+      unsigned Distance;
+      // Predicate given to the instruction by the IT
+      ARMCC::CondCodes Pred;
+    };
+
+    typedef DenseMap<const MachineInstr *, ITMember> ITMembers;
+
+    DenseMap<const MachineBasicBlock *, ITMembers> ITIndex;
+
+    ITMembers & getITIndex(const MachineBasicBlock & MBB);
+    const ITMember * getITMember(const MachineInstr & MI);
+    void indexITBlock(MachineInstr & IT);
+    void unindexITBlock(const MachineInstr & IT);
+    void forgetIT(const MachineInstr & MI);
+
     unsigned getITBlockSize(const MachineInstr & IT);
     MachineInstr * findIT(MachineInstr & MI, unsigned & distance);
     const MachineInstr * findIT(const MachineInstr & MI, unsigned & distance);
@@ -11,6 +11,12 @@
 // This file contains the implementation of a pass that promotes certain local
 // variables that hold function pointers to global variables.
 //
+// With slot sharing, locals of two functions share one global variable if
+// neither function can call the other directly or indirectly, as the two
+// functions are then never live at the same time.  Like promotion itself,
+// this assumes that no function is live in two threads of control (e.g., a
+// task and an interrupt handler) at the same time.
+//
 //===----------------------------------------------------------------------===//
 
 #define DEBUG_TYPE "arm-randezvous-lgp"
@@ -18,10 +24,8 @@
 #include "ARMRandezvousInstrumentor.h"
 #include "ARMRandezvousLGPromote.h"
 #include "ARMRandezvousOptions.h"
-#include "llvm/ADT/SCCIterator.h"
 #include "llvm/ADT/Statistic.h"
-#include "llvm/Analysis/CallGraph.h"
-#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Constants.h"
 
 using namespace llvm;
 
@@ -29,7 +33,10 @@ STATISTIC(NumAllocasPromoted, "Number of allocas promoted to globals");
 STATISTIC(NumAllocasSCC, "Number of allocas not promoted due to SCC");
 STATISTIC(NumAllocasVarSize, "Number of allocas not promoted due to variable size");
 
+STATISTIC(NumSlotsShared, "Number of globals shared by promoted allocas");
+
 STATISTIC(NumBytesPromoted, "Total size of allocas promoted to globals");
+STATISTIC(NumBytesShared, "Total size of globals saved by slot sharing");
 
 char ARMRandezvousLGPromote::ID = 0;
 
@@ -50,6 +57,141 @@ ARMRandezvousLGPromote::getAnalysisUsage(AnalysisUsage & AU) const {
   ModulePass::getAnalysisUsage(AU);
 }
 
+void
+ARMRandezvousLGPromote::releaseMemory() {
+  FuncIndices.clear();
+  Reaches.clear();
+  Escaped.clear();
+}
+
+//
+// Method: computeReach()
+//
+// Description:
+//   This method computes the set of functions reachable from each function
+//   in an SCC of the call graph, assuming that the SCCs called by it have
+//   been visited.  Calls to code outside the Module (including indirect
+//   calls) set the extra bit of unknown code, which may call back any
+//   escaped function.  The SCC of the external calling node gives the set of
+//   escaped functions.
+//
+// Inputs:
+//   SCC - A reference to the SCC iterator pointing to the SCC.
+//   CG  - A reference to the call graph.
+//
+void
+ARMRandezvousLGPromote::computeReach(scc_iterator<CallGraph *> & SCC,
+                                     CallGraph & CG) {
+  unsigned UnknownIdx = FuncIndices.size();
+  BitVector Reach(UnknownIdx + 1);
+  for (CallGraphNode * Node : *SCC) {
+    for (auto & CR : *Node) {
+      CallGraphNode * Callee = CR.second;
+      if (Function * CF = Callee->getFunction()) {
+        Reach.set(FuncIndices[CF]);
+        auto It = Reaches.find(CF);
+        if (It != Reaches.end()) {
+          Reach |= It->second;
+        }
+      } else {
+        Reach.set(UnknownIdx);
+      }
+    }
+  }
+
+  for (CallGraphNode * Node : *SCC) {
+    if (Function * F = Node->getFunction()) {
+      Reaches[F] = Reach;
+    } else if (Node == CG.getExternalCallingNode()) {
+      Escaped = Reach;
+    }
+  }
+}
+
+//
+// Method: canShareSlot()
+//
+// Description:
+//   This method checks if an alloca of a given function can go into a given
+//   slot, i.e., if the function is never live at the same time as any
+//   function already having an alloca in the slot.
+//
+// Inputs:
+//   S - A const reference to the slot.
+//   F - A const reference to the function.
+//
+// Return value:
+//   true  - The alloca can go into the slot.
+//   false - The alloca cannot go into the slot.
+//
+bool
+ARMRandezvousLGPromote::canShareSlot(const Slot & S,
+                                     const Function & F) const {
+  unsigned UnknownIdx = FuncIndices.size();
+  unsigned Idx = FuncIndices.lookup(&F);
+  const BitVector & Reach = Reaches.find(&F)->second;
+
+  // Neither F nor any function it reaches may be a member, and F may not be
+  // reachable from any member
+  if (S.Members.test(Idx) || S.Members.anyCommon(Reach) ||
+      S.MembersReach.test(Idx)) {
+    return false;
+  }
+
+  // Unknown code reachable from one side may call back the other side if the
+  // other side escapes
+  if (Reach.test(UnknownIdx) && S.Members.anyCommon(Escaped)) {
+    return false;
+  }
+  if (S.MembersReach.test(UnknownIdx) && Escaped.test(Idx)) {
+    return false;
+  }
+  return true;
+}
+
+//
+// Method: promote()
+//
+// Description:
+//   This method promotes one or more static allocas to a single global
+//   variable.  The global variable takes the type of the first alloca,
+//   which must be the largest one, and the largest alignment of them.
+//
+// Inputs:
+//   M          - A reference to the Module in which to create the global.
+//   Candidates - The allocas to promote, the largest first.
+//
+void
+ARMRandezvousLGPromote::promote(Module & M,
+                                ArrayRef<const Candidate *> Candidates) {
+  const Candidate & First = *Candidates.front();
+  Type * Ty = First.AI->getAllocatedType();
+  Align Alignment = First.AI->getAlign();
+  for (const Candidate * C : Candidates) {
+    assert(C->Size <= First.Size && "Largest alloca not first!");
+    Alignment = std::max(Alignment, C->AI->getAlign());
+  }
+
+  std::string Name = "__randezvous_lgp_slot";
+  if (Candidates.size() == 1) {
+    Name = (First.F->getName() + "." + First.AI->getName()).str();
+  }
+  GlobalVariable * GV = new GlobalVariable(
+    M, Ty, false, GlobalVariable::InternalLinkage,
+    createNonZeroInitializerFor(Ty), Name
+  );
+  GV->setAlignment(Alignment);
+
+  for (const Candidate * C : Candidates) {
+    C->AI->replaceAllUsesWith(
+      ConstantExpr::getPointerBitCastOrAddrSpaceCast(GV, C->AI->getType())
+    );
+    C->AI->eraseFromParent();
+    ++NumAllocasPromoted;
+    NumBytesPromoted += C->Size;
+  }
+}
+
 //
 // Method: runOnModule()
 //
@@ -57,7 +199,8 @@ ARMRandezvousLGPromote::getAnalysisUsage(AnalysisUsage & AU) const {
 //   This method is called when the PassManager wants this pass to transform
 //   the specified Module.  This method promotes all static local variables in
 //   a non-recursive function that contain one or more function pointers into
-//   global variables.
+//   global variables.  With slot sharing, allocas of functions that are never
+//   live at the same time are promoted to the same global variable.
 //
 // Input:
 //   M - A reference to the Module to transform.
@@ -75,13 +218,23 @@ ARMRandezvousLGPromote::runOnModule(Module & M) {
     return false;
   }
 
-  bool changed = false;
   const DataLayout & DL = M.getDataLayout();
+  if (EnableRandezvousLGPShare) {
+    for (Function & F : M) {
+      unsigned Idx = FuncIndices.size();
+      FuncIndices[&F] = Idx;
+    }
+  }
 
   // Loop over SCCs instead of functions; this allows us to naturally skip
   // recursive functions
+  std::vector<Candidate> Candidates;
   CallGraph & CG = getAnalysis<CallGraphWrapperPass>().getCallGraph();
   for (scc_iterator<CallGraph *> SCC = scc_begin(&CG); !SCC.isAtEnd(); ++SCC) {
+    if (EnableRandezvousLGPShare) {
+      computeReach(SCC, CG);
+    }
+
     // Skip recursive functions but collect statistics from them
     if (SCC.hasCycle()) {
       for (CallGraphNode * Node : *SCC) {
@@ -105,42 +258,70 @@ ARMRandezvousLGPromote::runOnModule(Module & M) {
       continue;
     }
 
-    // Identify alloca instructions in the function
-    std::vector<AllocaInst *> Allocas;
+    // Identify static allocas that contain function pointers in the function
     for (BasicBlock & BB : *F) {
       for (Instruction & I : BB) {
         if (AllocaInst * AI = dyn_cast<AllocaInst>(&I)) {
-          Allocas.push_back(AI);
+          Type * AllocatedTy = AI->getAllocatedType();
+          if (containsFunctionPointerType(AllocatedTy)) {
+            if (!AI->isStaticAlloca()) {
+              ++NumAllocasVarSize;
+              continue;
+            }
+            Candidates.push_back({F, AI, DL.getTypeAllocSize(AllocatedTy)});
+          }
         }
       }
     }
+  }
+
+  if (!EnableRandezvousLGPShare) {
+    // Promote each alloca to its own global
+    for (const Candidate & C : Candidates) {
+      promote(M, &C);
+    }
+    return !Candidates.empty();
+  }
 
-    // Promote static allocas that contain function pointers to globals
-    for (AllocaInst * AI : Allocas) {
-      Type * AllocatedTy = AI->getAllocatedType();
-      if (containsFunctionPointerType(AllocatedTy)) {
-        if (!AI->isStaticAlloca()) {
-          ++NumAllocasVarSize;
-          continue;
-        }
+  // Put each alloca, the largest first, into the first slot that its function
+  // can share with other functions in the slot
+  std::vector<const Candidate *> Sorted;
+  for (const Candidate & C : Candidates) {
+    Sorted.push_back(&C);
+  }
+  std::stable_sort(Sorted.begin(), Sorted.end(),
+                   [](const Candidate * A, const Candidate * B) {
+    return A->Size > B->Size;
+  });
+
+  std::vector<Slot> Slots;
+  for (const Candidate * C : Sorted) {
+    auto It = std::find_if(Slots.begin(), Slots.end(), [&](const Slot & S) {
+      return canShareSlot(S, *C->F);
+    });
+    if (It == Slots.end()) {
+      Slots.emplace_back();
+      It = std::prev(Slots.end());
+      It->Members.resize(FuncIndices.size() + 1);
+      It->MembersReach.resize(FuncIndices.size() + 1);
+    }
+    It->Members.set(FuncIndices[C->F]);
+    It->MembersReach |= Reaches[C->F];
+    It->Candidates.push_back(C);
+  }
 
-        GlobalVariable * GV = new GlobalVariable(
-          M, AllocatedTy, false, GlobalVariable::InternalLinkage,
-          createNonZeroInitializerFor(AllocatedTy),
-          F->getName() + "." + AI->getName()
-        );
-        GV->setAlignment(AI->getAlign());
-
-        AI->replaceAllUsesWith(GV);
-        AI->eraseFromParent();
-        ++NumAllocasPromoted;
-        NumBytesPromoted += DL.getTypeAllocSize(AllocatedTy);
-        changed = true;
+  // Promote the allocas of each slot to a global
+  for (Slot & S : Slots) {
+    promote(M, S.Candidates);
+    if (S.Candidates.size() > 1) {
+      ++NumSlotsShared;
+      for (const Candidate * C : makeArrayRef(S.Candidates).drop_front()) {
+        NumBytesShared += C->Size;
       }
     }
   }
 
-  return changed;
+  return !Candidates.empty();
 }
 
 ModulePass *
@@ -16,6 +16,11 @@
 #ifndef ARM_RANDEZVOUS_LGP
 #define ARM_RANDEZVOUS_LGP
 
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/Pass.h"
 
 namespace llvm {
@@ -26,7 +31,38 @@ namespace llvm {
     ARMRandezvousLGPromote();
     virtual StringRef getPassName() const override;
     void getAnalysisUsage(AnalysisUsage & AU) const override;
+    void releaseMemory() override;
     virtual bool runOnModule(Module & M) override;
+
+  private:
+    // A static alloca to promote and the function containing it
+    struct Candidate {
+      Function * F;
+      AllocaInst * AI;
+      uint64_t Size;
+    };
+
+    // A global variable shared by promoted allocas of functions that are never
+    // live at the same time
+    struct Slot {
+      // Functions having an alloca in the slot
+      BitVector Members;
+      // Functions (and unknown code) reachable from any of the members
+      BitVector MembersReach;
+      std::vector<const Candidate *> Candidates;
+    };
+
+    // Index of each function in the bit vectors below
+    DenseMap<const Function *, unsigned> FuncIndices;
+    // Functions (and unknown code) reachable from each function
+    DenseMap<const Function *, BitVector> Reaches;
+    // Functions (and functions reachable from them) that code outside the
+    // Module can call
+    BitVector Escaped;
+
+    void computeReach(scc_iterator<CallGraph *> & SCC, CallGraph & CG);
+    bool canShareSlot(const Slot & S, const Function & F) const;
+    void promote(Module & M, ArrayRef<const Candidate *> Candidates);
   };
 
   ModulePass * createARMRandezvousLGPromote(void);
@@ -0,0 +1,499 @@
+//===- ARMRandezvousLeakability.cpp - ARM Randezvous Leakability Analysis -===//
+//
+// Copyright (c) 2021-2022, University of Rochester
+//
+// Part of the Randezvous Project, under the Apache License v2.0 with
+// LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+// information.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains the implementation of an analysis pass that determines
+// which functions and basic blocks of ARM machine code can have their
+// addresses leaked.  Results are computed on demand and cached for as long as
+// the analysis is preserved, so that all Randezvous passes can share them.
+//
+// Whether a function can spill LR is computed for the whole module at once:
+// a function spills LR if it does so by itself or if it tail-calls a function
+// that spills LR.  This is propagated backward along tail calls from the
+// functions that spill LR by themselves, which takes linear time and
+// terminates on cycles of tail calls.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "arm-randezvous-leakability"
+
+#include "ARM.h"
+#include "ARMBaseInstrInfo.h"
+#include "ARMRandezvousLeakability.h"
+#include "llvm/CodeGen/MachineFrameInfo.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/InitializePasses.h"
+
+#include <map>
+#include <set>
+
+using namespace llvm;
+
+char ARMRandezvousLeakability::ID = 0;
+
+INITIALIZE_PASS_BEGIN(ARMRandezvousLeakability, DEBUG_TYPE,
+                      "ARM Randezvous Leakability Analysis", false, true)
+INITIALIZE_PASS_DEPENDENCY(MachineModuleInfoWrapperPass)
+INITIALIZE_PASS_END(ARMRandezvousLeakability, DEBUG_TYPE,
+                    "ARM Randezvous Leakability Analysis", false, true)
+
+ARMRandezvousLeakability::ARMRandezvousLeakability() : ModulePass(ID) {
+  initializeARMRandezvousLeakabilityPass(*PassRegistry::getPassRegistry());
+}
+
+StringRef
+ARMRandezvousLeakability::getPassName() const {
+  return "ARM Randezvous Leakability Analysis Pass";
+}
+
+void
+ARMRandezvousLeakability::getAnalysisUsage(AnalysisUsage & AU) const {
+  // We need this to access MachineFunctions
+  AU.addRequired<MachineModuleInfoWrapperPass>();
+
+  AU.setPreservesAll();
+  ModulePass::getAnalysisUsage(AU);
+}
+
+void
+ARMRandezvousLeakability::releaseMemory() {
+  AddressTaken.clear();
+  LRSpilled.clear();
+  LeakableViaRetAddr.clear();
+}
+
+//
+// Function: getCalledFunction()
+//
+// Description:
+//   This function returns the Function that a call or tail call operand
+//   refers to, going through aliases and ifuncs.
+//
+// Input:
+//   MO - A const reference to the callee operand.
+//
+// Return value:
+//   A const pointer to the callee Function, or nullptr if the callee is only
+//   known by its symbol name.
+//
+static const Function *
+getCalledFunction(const MachineOperand & MO) {
+  if (MO.isSymbol()) {
+    return nullptr;
+  }
+  assert(MO.isGlobal() && "Unrecognized type of MachineOperand!");
+
+  // Go through aliases and ifuncs
+  const GlobalValue * GV = MO.getGlobal();
+  while (!isa<Function>(GV)) {
+    if (const auto * GIS = dyn_cast<GlobalIndirectSymbol>(GV)) {
+      GV = GIS->getBaseObject();
+    } else {
+      llvm_unreachable("Invalid type of global!");
+    }
+  }
+  return cast<Function>(GV);
+}
+
+//
+// Method: isReallyAddressTaken()
+//
+// Description:
+//   This method examines the use chain of a specified Function to see if its
+//   address really escapes to memory or if the Function is considered to be
+//   address-taken because it is used in some way (e.g., in a compare
+//   instruction, a global alias, or a select instruction).  The result is
+//   cached.
+//
+// Input:
+//   F - A const reference to the Function.
+//
+// Return value:
+//   true  - There may be a use of the Function that stores its address to
+//           memory.
+//   false - There is no use of the Function that may store its address to
+//           memory.
+//
+bool
+ARMRandezvousLeakability::isReallyAddressTaken(const Function & F) {
+  auto It = AddressTaken.find(&F);
+  if (It != AddressTaken.end()) {
+    return It->second;
+  }
+
+  bool & Taken = AddressTaken[&F];
+  Taken = false;
+  if (!F.hasAddressTaken()) {
+    return false;
+  }
+
+  std::vector<const Value *> Worklist;
+  std::set<const Value *> PHIs;
+
+  Worklist.push_back(&F);
+  while (!Worklist.empty()) {
+    const Value * V = Worklist.back();
+    Worklist.pop_back();
+
+    //
+    // Examine all uses of the value.
+    //
+    for (const User * U : V->users()) {
+      if (isa<PHINode>(U)) {
+        // Follow each PHINode once
+        if (PHIs.count(U) == 0) {
+          PHIs.insert(U);
+          Worklist.push_back(U);
+        }
+      } else if (isa<GlobalAlias>(U)) {
+        // Follow aliases
+        Worklist.push_back(U);
+      } else if (isa<BlockAddress>(U)) {
+        // Block addresses are fine
+        continue;
+      } else if (const ConstantExpr * CE = dyn_cast<ConstantExpr>(U)) {
+        // Follow constant expressions except compares
+        if (CE->isCompare()) {
+          continue;
+        }
+        Worklist.push_back(U);
+      } else if (const GlobalVariable * GV = dyn_cast<GlobalVariable>(U)) {
+        // Globals are stored in memory except certain LLVM metadata
+        if (GV->getName() != "llvm.used" &&
+            GV->getName() != "llvm.compiler.used") {
+          return Taken = true;
+        }
+      } else if (isa<Constant>(U)) {
+        // Follow all other constants
+        Worklist.push_back(U);
+      } else if (isa<StoreInst>(U)) {
+        // Stores write to memory
+        return Taken = true;
+      } else if (isa<CastInst>(U)) {
+        // Follow casts
+        Worklist.push_back(U);
+      } else if (isa<SelectInst>(U)) {
+        // Follow selects
+        Worklist.push_back(U);
+      } else if (isa<CmpInst>(U)) {
+        // Compares are fine
+        continue;
+      } else if (const CallInst * CI = dyn_cast<CallInst>(U)) {
+        // Function call arguments cannot be analyzed
+        if (CI->hasArgument(V)) {
+          return Taken = true;
+        }
+      } else {
+        errs() << "[Leakability] Unrecognized use of @" << F.getName() << ": "
+               << *U << "\n";
+      }
+    }
+  }
+
+  return false;
+}
+
+//
+// Method: computeLRSpills()
+//
+// Description:
+//   This method determines, for every Function in the Module, whether it can
+//   spill the return address in Link Register (LR) to memory.  A Function
+//   spills LR by itself if it saves LR as a callee-saved register, if it
+//   tail-calls an unknown function, or if we cannot tell (e.g., it has no
+//   MachineFunction).  Even if a Function does not spill LR by itself, it
+//   might tail-call another Function that does, in which case LR still points
+//   to the Function's caller; so spilling is then propagated backward along
+//   tail calls.
+//
+void
+ARMRandezvousLeakability::computeLRSpills() {
+  std::map<const Function *, std::vector<const Function *> > TailCallers;
+  std::vector<const Function *> Worklist;
+
+  LRSpilled.clear();
+  for (const Function & F : *M) {
+    bool Spilled = false;
+    std::vector<const Function *> Callees;
+
+    const MachineFunction * MF = MMI->getMachineFunction(F);
+    if (MF == nullptr) {
+      // External functions do not have MachineFunction available, so assume
+      // spilling conservatively
+      Spilled = true;
+    } else if (!MF->getFrameInfo().isCalleeSavedInfoValid()) {
+      // CalleeSavedInfo not valid, assume spilling conservatively
+      Spilled = true;
+    } else {
+      for (const CalleeSavedInfo & CSI : MF->getFrameInfo().getCalleeSavedInfo()) {
+        if (CSI.getReg() == ARM::LR) {
+          // Most functions end up here
+          Spilled = true;
+          break;
+        }
+      }
+    }
+
+    // Collect tail-called functions
+    if (!Spilled) {
+      for (const MachineBasicBlock & MBB : *MF) {
+        for (const MachineInstr & MI : MBB) {
+          switch (MI.getOpcode()) {
+          case ARM::tTAILJMPd:
+          case ARM::tTAILJMPdND:
+            if (const Function * Callee = getCalledFunction(MI.getOperand(0))) {
+              Callees.push_back(Callee);
+            } else {
+              // Don't know the callee, so assume spilling conservatively
+              Spilled = true;
+            }
+            break;
+
+          case ARM::tTAILJMPr:
+            // Don't know the callee, so assume spilling conservatively
+            Spilled = true;
+            break;
+
+          default:
+            break;
+          }
+        }
+      }
+    }
+
+    LRSpilled[&F] = Spilled;
+    if (Spilled) {
+      Worklist.push_back(&F);
+    } else {
+      for (const Function * Callee : Callees) {
+        TailCallers[Callee].push_back(&F);
+      }
+    }
+  }
+
+  // Propagate spilling backward along tail calls
+  while (!Worklist.empty()) {
+    const Function * F = Worklist.back();
+    Worklist.pop_back();
+    for (const Function * Caller : TailCallers[F]) {
+      bool & Spilled = LRSpilled[Caller];
+      if (!Spilled) {
+        Spilled = true;
+        Worklist.push_back(Caller);
+      }
+    }
+  }
+}
+
+//
+// Method: canSpillLinkRegister()
+//
+// Description:
+//   This method checks if a specified Function can spill the return address in
+//   Link Register (LR) to memory, either by itself or through tail calls.
+//
+// Input:
+//   F - A const reference to the Function.
+//
+// Return value:
+//   true  - The Function may spill LR to memory.
+//   false - The Function does not spill LR to memory.
+//
+bool
+ARMRandezvousLeakability::canSpillLinkRegister(const Function & F) {
+  auto It = LRSpilled.find(&F);
+  if (It == LRSpilled.end()) {
+    // F was created after we last looked at the Module
+    computeLRSpills();
+    It = LRSpilled.find(&F);
+  }
+  return It->second;
+}
+
+//
+// Method: callsLRSpiller()
+//
+// Description:
+//   This method checks if a given instruction is a call to a function that
+//   might spill LR to memory.  Calls to unknown functions are conservatively
+//   considered as such.
+//
+// Input:
+//   MI - A const reference to the instruction.
+//
+// Return value:
+//   true  - MI is a call to a function that might spill LR.
+//   false - MI is not a call, or it calls a function that does not spill LR.
+//
+bool
+ARMRandezvousLeakability::callsLRSpiller(const MachineInstr & MI) {
+  switch (MI.getOpcode()) {
+  case ARM::tBL:
+  case ARM::tBLXi:
+    if (const Function * Callee = getCalledFunction(MI.getOperand(2))) {
+      return canSpillLinkRegister(*Callee);
+    }
+    // Don't know the callee, so return true conservatively
+    return true;
+
+  case ARM::tBLXr:
+  case ARM::tBLXr_Randezvous:
+    // Don't know the callee, so return true conservatively
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+//
+// Method: analyzeBlocks()
+//
+// Description:
+//   This method determines, for each basic block of a MachineFunction in
+//   layout order, whether its address can be leaked via return addresses.  A
+//   MachineBasicBlock is considered leakable this way if
+//
+//   * its layout predecessor is leakable (via return addresses or because
+//     the function's address escapes to memory), or
+//
+//   * the last instruction of its layout predecessor is a call to a function
+//     that might spill LR to memory, or
+//
+//   * it contains a call to a function that might spill LR to memory and the
+//     call is not the last instruction.
+//
+//   Trap blocks are never considered leakable.
+//
+// Input:
+//   MF - A const reference to the MachineFunction.
+//
+void
+ARMRandezvousLeakability::analyzeBlocks(const MachineFunction & MF) {
+  bool FuncLeakable = isReallyAddressTaken(MF.getFunction());
+
+  const MachineBasicBlock * LayoutPred = nullptr;
+  bool LayoutPredLeakable = false;
+  for (const MachineBasicBlock & MBB : MF) {
+    bool Leakable = false;
+    if (!MBB.isRandezvousTrapBlock()) {
+      // First examine MBB's layout predecessor
+      if (LayoutPred != nullptr) {
+        if (LayoutPredLeakable) {
+          Leakable = true;
+        } else {
+          auto MI = LayoutPred->getLastNonDebugInstr();
+          Leakable = MI != LayoutPred->end() && callsLRSpiller(*MI);
+        }
+      }
+
+      // Now examine MBB's own instructions
+      auto Last = MBB.getLastNonDebugInstr();
+      for (auto MI = MBB.begin(); !Leakable && MI != Last; ++MI) {
+        Leakable = callsLRSpiller(*MI);
+      }
+    }
+
+    LeakableViaRetAddr[&MBB] = Leakable;
+    LayoutPred = &MBB;
+    LayoutPredLeakable = !MBB.isRandezvousTrapBlock() &&
+                         (FuncLeakable || Leakable);
+  }
+}
+
+//
+// Method: isLeakableViaRetAddr()
+//
+// Description:
+//   This method checks if the address of a given basic block can be leaked
+//   via return addresses (see analyzeBlocks()).
+//
+// Input:
+//   MBB - A const reference to the basic block.
+//
+// Return value:
+//   true  - The address of MBB may be leakable via return addresses.
+//   false - The address of MBB is not leakable via return addresses.
+//
+bool
+ARMRandezvousLeakability::isLeakableViaRetAddr(const MachineBasicBlock & MBB) {
+  auto It = LeakableViaRetAddr.find(&MBB);
+  if (It == LeakableViaRetAddr.end()) {
+    analyzeBlocks(*MBB.getParent());
+    It = LeakableViaRetAddr.find(&MBB);
+  }
+  return It->second;
+}
+
+//
+// Method: isLeakable()
+//
+// Description:
+//   This method checks if the address of a given basic block can be leaked,
+//   either because its function's address escapes to memory or via return
+//   addresses.
+//
+// Input:
+//   MBB - A const reference to the basic block.
+//
+// Return value:
+//   true  - The address of MBB may be leakable.
+//   false - The address of MBB is not leakable.
+//
+bool
+ARMRandezvousLeakability::isLeakable(const MachineBasicBlock & MBB) {
+  if (MBB.isRandezvousTrapBlock()) {
+    return false;
+  }
+  return isReallyAddressTaken(MBB.getParent()->getFunction()) ||
+         isLeakableViaRetAddr(MBB);
+}
+
+//
+// Method: invalidateBlockLeakability()
+//
+// Description:
+//   This method drops the cached leakability of all basic blocks.  Passes
+//   that preserve this analysis but change the code layout or calls should
+//   call it when they are done.
+//
+void
+ARMRandezvousLeakability::invalidateBlockLeakability() {
+  LeakableViaRetAddr.clear();
+}
+
+//
+// Method: runOnModule()
+//
+// Description:
+//   This method is called when the PassManager wants this pass to analyze
+//   the specified Module.  It computes whether each function can spill LR;
+//   everything else is computed on demand.
+//
+// Input:
+//   M - A reference to the Module to analyze.
+//
+// Return value:
+//   false - The Module was not modified.
+//
+bool
+ARMRandezvousLeakability::runOnModule(Module & M) {
+  this->M = &M;
+  MMI = &getAnalysis<MachineModuleInfoWrapperPass>().getMMI();
+
+  releaseMemory();
+  computeLRSpills();
+
+  return false;
+}
+
+ModulePass *
+llvm::createARMRandezvousLeakability(void) {
+  return new ARMRandezvousLeakability();
+}
@@ -0,0 +1,63 @@
+//===- ARMRandezvousLeakability.h - ARM Randezvous Leakability Analysis ---===//
+//
+// Copyright (c) 2021-2022, University of Rochester
+//
+// Part of the Randezvous Project, under the Apache License v2.0 with
+// LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+// information.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the interfaces of an analysis pass that determines which
+// functions and basic blocks of ARM machine code can have their addresses
+// leaked.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef ARM_RANDEZVOUS_LEAKABILITY
+#define ARM_RANDEZVOUS_LEAKABILITY
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
+#include "llvm/Pass.h"
+
+namespace llvm {
+  struct ARMRandezvousLeakability : public ModulePass {
+    // Pass Identifier
+    static char ID;
+
+    ARMRandezvousLeakability();
+    virtual StringRef getPassName() const override;
+    void getAnalysisUsage(AnalysisUsage & AU) const override;
+    void releaseMemory() override;
+    virtual bool runOnModule(Module & M) override;
+
+    bool isReallyAddressTaken(const Function & F);
+    bool canSpillLinkRegister(const Function & F);
+    bool isLeakable(const MachineBasicBlock & MBB);
+    bool isLeakableViaRetAddr(const MachineBasicBlock & MBB);
+    void invalidateBlockLeakability();
+
+  private:
+    Module * M = nullptr;
+    MachineModuleInfo * MMI = nullptr;
+
+    // Whether the address of each function really escapes to memory
+    DenseMap<const Function *, bool> AddressTaken;
+
+    // Whether each function can spill LR, either by itself or through tail
+    // calls
+    DenseMap<const Function *, bool> LRSpilled;
+
+    // Whether each basic block is leakable via return addresses
+    DenseMap<const MachineBasicBlock *, bool> LeakableViaRetAddr;
+
+    void computeLRSpills();
+    void analyzeBlocks(const MachineFunction & MF);
+    bool callsLRSpiller(const MachineInstr & MI);
+  };
+
+  ModulePass * createARMRandezvousLeakability(void);
+}
+
+#endif
@@ -45,6 +45,22 @@ BBCLR("arm-randezvous-bbclr",
       cl::location(EnableRandezvousBBCLR),
       cl::init(false));
 
+bool EnableRandezvousPGBBLR;
+static cl::opt<bool, true>
+PGBBLR("arm-randezvous-pg-bblr",
+       cl::Hidden,
+       cl::desc("Enable Profile-Guided Basic Block Layout Randomization for ARM Randezvous CLR"),
+       cl::location(EnableRandezvousPGBBLR),
+       cl::init(false));
+
+bool EnableRandezvousCLRBranchRange;
+static cl::opt<bool, true>
+CLRBranchRange("arm-randezvous-clr-branch-range",
+               cl::Hidden,
+               cl::desc("Keep branches in range when inserting trap instructions in ARM Randezvous CLR"),
+               cl::location(EnableRandezvousCLRBranchRange),
+               cl::init(false));
+
 bool EnableRandezvousPicoXOM;
 static cl::opt<bool, true>
 PicoXOM("arm-randezvous-picoxom",
@@ -53,6 +69,14 @@ PicoXOM("arm-randezvous-picoxom",
         cl::location(EnableRandezvousPicoXOM),
         cl::init(false));
 
+bool EnableRandezvousXOMCSE;
+static cl::opt<bool, true>
+XOMCSE("arm-randezvous-xom-cse",
+       cl::Hidden,
+       cl::desc("Enable reuse and hoisting of MOVW/MOVT materializations for ARM Randezvous Execute-Only Memory"),
+       cl::location(EnableRandezvousXOMCSE),
+       cl::init(false));
+
 bool EnableRandezvousGDLR;
 static cl::opt<bool, true>
 GDLR("arm-randezvous-gdlr",
@@ -85,6 +109,14 @@ ShadowStack("arm-randezvous-shadow-stack",
             cl::location(EnableRandezvousShadowStack),
             cl::init(false));
 
+bool EnableRandezvousShadowStackOpt;
+static cl::opt<bool, true>
+ShadowStackOpt("arm-randezvous-shadow-stack-opt",
+               cl::Hidden,
+               cl::desc("Enable LR spill elision and shrink-wrapping for ARM Randezvous Shadow Stack"),
+               cl::location(EnableRandezvousShadowStackOpt),
+               cl::init(false));
+
 bool EnableRandezvousRAN;
 static cl::opt<bool, true>
 RAN("arm-randezvous-ran",
@@ -101,6 +133,14 @@ LGPromote("arm-randezvous-lgp",
           cl::location(EnableRandezvousLGPromote),
           cl::init(false));
 
+bool EnableRandezvousLGPShare;
+static cl::opt<bool, true>
+LGPShare("arm-randezvous-lgp-share",
+         cl::Hidden,
+         cl::desc("Enable global sharing among locals of functions never live at the same time for ARM Randezvous Local-to-Global Promotion"),
+         cl::location(EnableRandezvousLGPShare),
+         cl::init(false));
+
 bool EnableRandezvousICallLimiter;
 static cl::opt<bool, true>
 ICallLimiter("arm-randezvous-icall-limiter",
@@ -109,6 +149,22 @@ ICallLimiter("arm-randezvous-icall-limiter",
              cl::location(EnableRandezvousICallLimiter),
              cl::init(false));
 
+bool EnableRandezvousICallPromote;
+static cl::opt<bool, true>
+ICallPromote("arm-randezvous-icall-promote",
+             cl::Hidden,
+             cl::desc("Enable profile-guided indirect call promotion for ARM Randezvous Indirect Call Limiter"),
+             cl::location(EnableRandezvousICallPromote),
+             cl::init(false));
+
+bool EnableRandezvousTiering;
+static cl::opt<bool, true>
+Tiering("arm-randezvous-tiering",
+        cl::Hidden,
+        cl::desc("Enable profile-guided per-function protection tiering for ARM Randezvous"),
+        cl::location(EnableRandezvousTiering),
+        cl::init(false));
+
 //===----------------------------------------------------------------------===//
 // Randezvous pass seeds
 //===----------------------------------------------------------------------===//
@@ -181,6 +237,66 @@ ShadowStackSize("arm-randezvous-shadow-stack-size",
                 cl::location(RandezvousShadowStackSize),
                 cl::init(0x8000)); // 32 KB
 
+//===----------------------------------------------------------------------===//
+// Shadow stack placement options used by Randezvous passes
+//===----------------------------------------------------------------------===//
+
+std::string RandezvousShadowStackSection;
+static cl::opt<std::string, true>
+ShadowStackSection("arm-randezvous-shadow-stack-section",
+                   cl::Hidden,
+                   cl::desc("Section in which to place ARM Randezvous Shadow Stack"),
+                   cl::location(RandezvousShadowStackSection),
+                   cl::init(""));
+
+unsigned RandezvousShadowStackAlignment;
+static cl::opt<unsigned, true>
+ShadowStackAlignment("arm-randezvous-shadow-stack-alignment",
+                     cl::Hidden,
+                     cl::desc("Alignment in bytes of ARM Randezvous Shadow Stack (0 for the default)"),
+                     cl::location(RandezvousShadowStackAlignment),
+                     cl::init(0));
+
+std::string RandezvousShadowStackBase;
+static cl::opt<std::string, true>
+ShadowStackBase("arm-randezvous-shadow-stack-base",
+                cl::Hidden,
+                cl::desc("Linker-provided symbol at which ARM Randezvous Shadow Stack starts (instead of a shadow stack created by the compiler)"),
+                cl::location(RandezvousShadowStackBase),
+                cl::init(""));
+
+std::string RandezvousShadowStackEnd;
+static cl::opt<std::string, true>
+ShadowStackEnd("arm-randezvous-shadow-stack-end",
+               cl::Hidden,
+               cl::desc("Linker-provided symbol at which ARM Randezvous Shadow Stack ends (required with -arm-randezvous-shadow-stack-base)"),
+               cl::location(RandezvousShadowStackEnd),
+               cl::init(""));
+
+//===----------------------------------------------------------------------===//
+// Whole-program budgeting options used by Randezvous passes
+//===----------------------------------------------------------------------===//
+
+std::string RandezvousBudgetManifest;
+static cl::opt<std::string, true>
+BudgetManifest("arm-randezvous-budget-manifest",
+               cl::Hidden,
+               cl::desc("Manifest of section sizes used by all modules in the program"),
+               cl::location(RandezvousBudgetManifest),
+               cl::init(""));
+
+//===----------------------------------------------------------------------===//
+// Reporting options used by Randezvous passes
+//===----------------------------------------------------------------------===//
+
+std::string RandezvousReportFile;
+static cl::opt<std::string, true>
+ReportFile("arm-randezvous-report-jsonl",
+           cl::Hidden,
+           cl::desc("JSON Lines file to which to append the code, section space, section sizes, protection tiers, and time of each ARM Randezvous pass"),
+           cl::location(RandezvousReportFile),
+           cl::init(""));
+
 //===----------------------------------------------------------------------===//
 // Miscellaneous options used by Randezvous passes
 //===----------------------------------------------------------------------===//
@@ -193,11 +309,35 @@ ShadowStackStrideLength("arm-randezvous-shadow-stack-stride-length",
                         cl::location(RandezvousShadowStackStrideLength),
                         cl::init(8));
 
+unsigned RandezvousBBLRHotThreshold;
+static cl::opt<unsigned, true>
+BBLRHotThreshold("arm-randezvous-bblr-hot-threshold",
+                 cl::Hidden,
+                 cl::desc("Minimum frequency (in percent of the entry frequency) of a fall-through edge that profile-guided BBLR keeps"),
+                 cl::location(RandezvousBBLRHotThreshold),
+                 cl::init(100));
+
+unsigned RandezvousICallPromoteThreshold;
+static cl::opt<unsigned, true>
+ICallPromoteThreshold("arm-randezvous-icall-promote-threshold",
+                      cl::Hidden,
+                      cl::desc("Minimum count (in percent of the total count of a call site) of an indirect call target to promote"),
+                      cl::location(RandezvousICallPromoteThreshold),
+                      cl::init(10));
+
+unsigned RandezvousICallPromoteMaxTargets;
+static cl::opt<unsigned, true>
+ICallPromoteMaxTargets("arm-randezvous-icall-promote-max-targets",
+                       cl::Hidden,
+                       cl::desc("Maximum number of indirect call targets to promote at a call site"),
+                       cl::location(RandezvousICallPromoteMaxTargets),
+                       cl::init(4));
+
 unsigned RandezvousNumGlobalGuardCandidates;
 static cl::opt<unsigned, true>
 NumGlobalGuardCandidates("arm-randezvous-num-global-guard-candidates",
                          cl::Hidden,
-                         cl::desc("Number of global guard candidates to generate"),
+                         cl::desc("Number of global guard candidates to generate (a power of two no greater than 256)"),
                          cl::location(RandezvousNumGlobalGuardCandidates),
                          cl::init(64));
 
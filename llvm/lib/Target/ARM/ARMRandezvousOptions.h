@@ -17,6 +17,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <string>
 
 //===----------------------------------------------------------------------===//
 // Randezvous pass enablers
@@ -25,14 +26,21 @@
 extern bool EnableRandezvousCLR;
 extern bool EnableRandezvousBBLR;
 extern bool EnableRandezvousBBCLR;
+extern bool EnableRandezvousPGBBLR;
+extern bool EnableRandezvousCLRBranchRange;
 extern bool EnableRandezvousPicoXOM;
+extern bool EnableRandezvousXOMCSE;
 extern bool EnableRandezvousGDLR;
 extern bool EnableRandezvousDecoyPointers;
 extern bool EnableRandezvousGlobalGuard;
 extern bool EnableRandezvousShadowStack;
+extern bool EnableRandezvousShadowStackOpt;
 extern bool EnableRandezvousRAN;
 extern bool EnableRandezvousLGPromote;
+extern bool EnableRandezvousLGPShare;
 extern bool EnableRandezvousICallLimiter;
+extern bool EnableRandezvousICallPromote;
+extern bool EnableRandezvousTiering;
 
 //===----------------------------------------------------------------------===//
 // Randezvous pass seeds
@@ -52,11 +60,35 @@ extern size_t RandezvousMaxDataSize;
 extern size_t RandezvousMaxBssSize;
 extern size_t RandezvousShadowStackSize;
 
+//===----------------------------------------------------------------------===//
+// Shadow stack placement options used by Randezvous passes
+//===----------------------------------------------------------------------===//
+
+extern std::string RandezvousShadowStackSection;
+extern unsigned RandezvousShadowStackAlignment;
+extern std::string RandezvousShadowStackBase;
+extern std::string RandezvousShadowStackEnd;
+
+//===----------------------------------------------------------------------===//
+// Whole-program budgeting options used by Randezvous passes
+//===----------------------------------------------------------------------===//
+
+extern std::string RandezvousBudgetManifest;
+
+//===----------------------------------------------------------------------===//
+// Reporting options used by Randezvous passes
+//===----------------------------------------------------------------------===//
+
+extern std::string RandezvousReportFile;
+
 //===----------------------------------------------------------------------===//
 // Miscellaneous options used by Randezvous passes
 //===----------------------------------------------------------------------===//
 
 extern unsigned RandezvousShadowStackStrideLength;
+extern unsigned RandezvousBBLRHotThreshold;
+extern unsigned RandezvousICallPromoteThreshold;
+extern unsigned RandezvousICallPromoteMaxTargets;
 extern unsigned RandezvousNumGlobalGuardCandidates;
 extern uintptr_t RandezvousRNGAddress;
 
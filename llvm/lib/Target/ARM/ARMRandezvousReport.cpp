@@ -0,0 +1,371 @@
+//===- ARMRandezvousReport.cpp - ARM Randezvous Build Report --------------===//
+//
+// Copyright (c) 2021-2022, University of Rochester
+//
+// Part of the Randezvous Project, under the Apache License v2.0 with
+// LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+// information.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains the implementation of a helper that reports what each
+// Randezvous pass costs.  The report file is in the JSON Lines format: every
+// pass run of every compilation appends to it one JSON object per line, so
+// that many compilations (e.g., of the translation units of a program) can
+// share one file.  Every record has a "kind", the "module", and the "pass":
+//
+// * "function" records, one per function, with the instructions, bytes, and
+//   static cycles that the pass adds to the function, plus pass-specific
+//   counters (e.g., the number of shadow stack sites);
+//
+// * "section" records, one per section that the pass fills up, with the
+//   space used before the pass runs, the budget, and the number and size of
+//   fillers (trap instructions or garbage objects) inserted;
+//
+// * "size" records, one per section, with the size the module uses before
+//   any filler is inserted, which budget manifests are built from;
+//
+// * "tiering" records, one per function, with the protection that the pass
+//   applied and its estimated dynamic overhead;
+//
+// * a "time" record per pass run, with the time the pass takes.
+//
+// A MachineFunction pass keeps one report for the whole module, runs its
+// timer only while it transforms a function, and writes the report once
+// when the module is finalized.
+//
+// Records are buffered and written when the pass finishes a module.
+//
+// Static cycles are the sum of the latencies of instructions according to
+// the scheduling model of the subtarget, i.e., they assume no overlap
+// between instructions.  Unlike STATISTIC counters, reports are available in
+// release builds and are broken down by function.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ARMRandezvousOptions.h"
+#include "ARMRandezvousReport.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/CodeGen/TargetSchedule.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+RandezvousPassReport::RandezvousPassReport(const Twine & PassName)
+    : PassName(PassName.str()), StartTime(TimeRecord::getCurrentTime(true)) {
+}
+
+//
+// Method: pauseTimer()
+//
+// Description:
+//   This method stops counting time towards the time the pass takes, e.g.,
+//   while other passes run between two functions.
+//
+void
+RandezvousPassReport::pauseTimer() {
+  if (TimerRunning) {
+    TimeRecord Time = TimeRecord::getCurrentTime(false);
+    Time -= StartTime;
+    Elapsed += Time;
+    TimerRunning = false;
+  }
+}
+
+//
+// Method: resumeTimer()
+//
+// Description:
+//   This method starts counting time towards the time the pass takes again.
+//
+void
+RandezvousPassReport::resumeTimer() {
+  if (!TimerRunning) {
+    StartTime = TimeRecord::getCurrentTime(true);
+    TimerRunning = true;
+  }
+}
+
+//
+// Method: isEnabled()
+//
+// Description:
+//   This method checks if a report file is requested.  All the other methods
+//   do nothing if not.
+//
+bool
+RandezvousPassReport::isEnabled() const {
+  return !RandezvousReportFile.empty();
+}
+
+//
+// Method: computeCodeCost()
+//
+// Description:
+//   This method computes the static cost of the code of a MachineFunction.
+//
+// Input:
+//   MF - A const reference to the MachineFunction.
+//
+// Return value:
+//   The number of instructions, the number of bytes, and the number of
+//   cycles (assuming no overlap between instructions) of the code.
+//
+RandezvousPassReport::CodeCost
+RandezvousPassReport::computeCodeCost(const MachineFunction & MF) {
+  const TargetSubtargetInfo & STI = MF.getSubtarget();
+  const TargetInstrInfo * TII = STI.getInstrInfo();
+  TargetSchedModel SchedModel;
+  SchedModel.init(&STI);
+
+  CodeCost Cost;
+  for (const MachineBasicBlock & MBB : MF) {
+    for (const MachineInstr & MI : MBB) {
+      if (MI.isMetaInstruction()) {
+        continue;
+      }
+      ++Cost.NumInsts;
+      Cost.NumBytes += TII->getInstSizeInBytes(MI);
+      Cost.NumCycles += SchedModel.computeInstrLatency(&MI);
+    }
+  }
+  return Cost;
+}
+
+//
+// Method: beginFunction()
+//
+// Description:
+//   This method records the cost of a MachineFunction before the pass
+//   transforms it.
+//
+// Input:
+//   MF - A const reference to the MachineFunction.
+//
+void
+RandezvousPassReport::beginFunction(const MachineFunction & MF) {
+  if (!isEnabled()) {
+    return;
+  }
+
+  CostsBefore[&MF.getFunction()] = computeCodeCost(MF);
+}
+
+//
+// Method: endFunction()
+//
+// Description:
+//   This method adds the cost that the pass added to a MachineFunction to
+//   the record of the function.  A function without a recorded cost (e.g.,
+//   one created by the pass) is charged with all its code.
+//
+// Input:
+//   MF - A const reference to the MachineFunction.
+//
+void
+RandezvousPassReport::endFunction(const MachineFunction & MF) {
+  if (!isEnabled()) {
+    return;
+  }
+
+  const Function & F = MF.getFunction();
+  CodeCost Before = CostsBefore.lookup(&F);
+  CodeCost After = computeCodeCost(MF);
+  json::Object & Record = FunctionRecords[&F];
+  Record["section"] = "text";
+  Record["insts"] = After.NumInsts - Before.NumInsts;
+  Record["bytes"] = After.NumBytes - Before.NumBytes;
+  Record["cycles"] = After.NumCycles - Before.NumCycles;
+}
+
+//
+// Method: beginModule()
+//
+// Description:
+//   This method records the cost of every MachineFunction of a Module before
+//   the pass transforms it.
+//
+// Inputs:
+//   M   - A const reference to the Module.
+//   MMI - A reference to the MachineModuleInfo of the Module.
+//
+void
+RandezvousPassReport::beginModule(const Module & M, MachineModuleInfo & MMI) {
+  if (!isEnabled()) {
+    return;
+  }
+
+  for (const Function & F : M) {
+    if (const MachineFunction * MF = MMI.getMachineFunction(F)) {
+      beginFunction(*MF);
+    }
+  }
+}
+
+//
+// Method: endModule()
+//
+// Description:
+//   This method adds the cost that the pass added to every MachineFunction
+//   of a Module to the record of the function.
+//
+// Inputs:
+//   M   - A const reference to the Module.
+//   MMI - A reference to the MachineModuleInfo of the Module.
+//
+void
+RandezvousPassReport::endModule(const Module & M, MachineModuleInfo & MMI) {
+  if (!isEnabled()) {
+    return;
+  }
+
+  for (const Function & F : M) {
+    if (const MachineFunction * MF = MMI.getMachineFunction(F)) {
+      endFunction(*MF);
+    }
+  }
+}
+
+//
+// Method: addCounter()
+//
+// Description:
+//   This method adds a pass-specific counter to the record of a function.
+//
+// Inputs:
+//   F     - A const reference to the Function.
+//   Name  - The name of the counter.
+//   Value - The value of the counter.
+//
+void
+RandezvousPassReport::addCounter(const Function & F, StringRef Name,
+                                 uint64_t Value) {
+  if (!isEnabled()) {
+    return;
+  }
+
+  FunctionRecords[&F][Name] = static_cast<int64_t>(Value);
+}
+
+//
+// Method: addSection()
+//
+// Description:
+//   This method records how much of a section the pass fills up.
+//
+// Inputs:
+//   Section    - The section.
+//   Used       - The size (in bytes) of the section used before the pass.
+//   Budget     - The size (in bytes) that the module may fill up.
+//   FillerName - The name of what the pass fills the section with.
+//   NumFillers - The number of fillers inserted.
+//   FillerSize - The size (in bytes) of each filler.
+//
+void
+RandezvousPassReport::addSection(RandezvousSection Section, uint64_t Used,
+                                 uint64_t Budget, StringRef FillerName,
+                                 uint64_t NumFillers, uint64_t FillerSize) {
+  if (!isEnabled()) {
+    return;
+  }
+
+  SectionRecords.push_back(json::Object {
+    { "section", getRandezvousSectionName(Section) },
+    { "used", static_cast<int64_t>(Used) },
+    { "budget", static_cast<int64_t>(Budget) },
+    { "filler", FillerName },
+    { "fillers", static_cast<int64_t>(NumFillers) },
+    { "filler-bytes", static_cast<int64_t>(NumFillers * FillerSize) },
+  });
+}
+
+//
+// Method: addRecord()
+//
+// Description:
+//   This method adds a record of another kind (e.g., a section size or a
+//   tiering decision) to the report.
+//
+// Inputs:
+//   Kind   - The kind of the record.
+//   Record - The fields of the record.
+//
+void
+RandezvousPassReport::addRecord(StringRef Kind, json::Object Record) {
+  if (!isEnabled()) {
+    return;
+  }
+
+  OtherRecords.push_back(std::make_pair(Kind.str(), std::move(Record)));
+}
+
+//
+// Method: write()
+//
+// Description:
+//   This method appends all the records and the time the pass has taken so
+//   far to the report file, and then clears the records.
+//
+// Input:
+//   M - A const reference to the Module being transformed.
+//
+void
+RandezvousPassReport::write(const Module & M) {
+  if (!isEnabled()) {
+    return;
+  }
+
+  std::error_code EC;
+  raw_fd_ostream OS(RandezvousReportFile, EC,
+                    sys::fs::OF_Append | sys::fs::OF_Text);
+  if (EC) {
+    report_fatal_error(Twine("[Report] Cannot open ") + RandezvousReportFile +
+                       ": " + EC.message());
+  }
+
+  for (auto & FR : FunctionRecords) {
+    json::Object Record = std::move(FR.second);
+    Record["kind"] = "function";
+    Record["module"] = M.getModuleIdentifier();
+    Record["pass"] = PassName;
+    Record["function"] = FR.first->getName();
+    OS << json::Value(std::move(Record)) << "\n";
+  }
+  for (json::Object & SR : SectionRecords) {
+    json::Object Record = std::move(SR);
+    Record["kind"] = "section";
+    Record["module"] = M.getModuleIdentifier();
+    Record["pass"] = PassName;
+    OS << json::Value(std::move(Record)) << "\n";
+  }
+  for (auto & OR : OtherRecords) {
+    json::Object Record = std::move(OR.second);
+    Record["kind"] = OR.first;
+    Record["module"] = M.getModuleIdentifier();
+    Record["pass"] = PassName;
+    OS << json::Value(std::move(Record)) << "\n";
+  }
+
+  bool WasTimerRunning = TimerRunning;
+  pauseTimer();
+  json::Object Record {
+    { "kind", "time" },
+    { "module", M.getModuleIdentifier() },
+    { "pass", PassName },
+    { "time-ms", Elapsed.getWallTime() * 1000 },
+  };
+  OS << json::Value(std::move(Record)) << "\n";
+
+  CostsBefore.clear();
+  FunctionRecords.clear();
+  SectionRecords.clear();
+  OtherRecords.clear();
+  Elapsed = TimeRecord();
+  if (WasTimerRunning) {
+    resumeTimer();
+  }
+}
@@ -0,0 +1,77 @@
+//===- ARMRandezvousReport.h - ARM Randezvous Build Report ----------------===//
+//
+// Copyright (c) 2021-2022, University of Rochester
+//
+// Part of the Randezvous Project, under the Apache License v2.0 with
+// LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+// information.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the interfaces of a helper that reports the code each
+// Randezvous pass adds to each function, the section space each pass fills
+// up, the time each pass takes, and other pass-specific records.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef ARM_RANDEZVOUS_REPORT
+#define ARM_RANDEZVOUS_REPORT
+
+#include "ARMRandezvousBudget.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Timer.h"
+
+namespace llvm {
+  class RandezvousPassReport {
+  public:
+    RandezvousPassReport(const Twine & PassName);
+
+    bool isEnabled() const;
+
+    void pauseTimer();
+    void resumeTimer();
+
+    void beginFunction(const MachineFunction & MF);
+    void endFunction(const MachineFunction & MF);
+    void beginModule(const Module & M, MachineModuleInfo & MMI);
+    void endModule(const Module & M, MachineModuleInfo & MMI);
+
+    void addCounter(const Function & F, StringRef Name, uint64_t Value);
+    void addSection(RandezvousSection Section, uint64_t Used, uint64_t Budget,
+                    StringRef FillerName, uint64_t NumFillers,
+                    uint64_t FillerSize);
+    void addRecord(StringRef Kind, json::Object Record);
+
+    void write(const Module & M);
+
+  private:
+    // Static cost of the code of a function
+    struct CodeCost {
+      int64_t NumInsts = 0;
+      int64_t NumBytes = 0;
+      int64_t NumCycles = 0;
+    };
+
+    std::string PassName;
+
+    // Time the pass has taken so far, and when the timer last started
+    TimeRecord Elapsed;
+    TimeRecord StartTime;
+    bool TimerRunning = true;
+
+    // Cost of each function before the pass runs
+    DenseMap<const Function *, CodeCost> CostsBefore;
+
+    // Records to write, per function, per section, and of other kinds
+    MapVector<const Function *, json::Object> FunctionRecords;
+    std::vector<json::Object> SectionRecords;
+    std::vector<std::pair<std::string, json::Object> > OtherRecords;
+
+    static CodeCost computeCodeCost(const MachineFunction & MF);
+  };
+}
+
+#endif
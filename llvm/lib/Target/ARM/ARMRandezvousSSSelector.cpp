@@ -0,0 +1,84 @@
+//===- ARMRandezvousSSSelector.cpp - ARM Randezvous Shadow Stack Selector -===//
+//
+// Copyright (c) 2021-2022, University of Rochester
+//
+// Part of the Randezvous Project, under the Apache License v2.0 with
+// LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+// information.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains the implementation of a pass that selects the ARM
+// machine functions whose return address is saved to the Randezvous shadow
+// stack.  The selection is made before frame lowering, as LR gets no stack
+// slot in such functions, and is then read by the shadow stack pass.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "arm-randezvous-ss-selector"
+
+#include "ARMMachineFunctionInfo.h"
+#include "ARMRandezvousOptions.h"
+#include "ARMRandezvousSSSelector.h"
+#include "ARMRandezvousTiering.h"
+#include "llvm/ADT/Statistic.h"
+
+using namespace llvm;
+
+STATISTIC(NumFunctionsSelected, "Number of functions using the shadow stack");
+
+char ARMRandezvousSSSelector::ID = 0;
+
+ARMRandezvousSSSelector::ARMRandezvousSSSelector() : MachineFunctionPass(ID) {
+}
+
+StringRef
+ARMRandezvousSSSelector::getPassName() const {
+  return "ARM Randezvous Shadow Stack Selector Pass";
+}
+
+void
+ARMRandezvousSSSelector::getAnalysisUsage(AnalysisUsage & AU) const {
+  // We need this to choose the protection tier of each function
+  AU.addRequired<ProfileSummaryInfoWrapperPass>();
+
+  AU.setPreservesAll();
+  MachineFunctionPass::getAnalysisUsage(AU);
+}
+
+//
+// Method: runOnMachineFunction()
+//
+// Description:
+//   This method is called when the PassManager wants this pass to transform
+//   the specified MachineFunction.  This method records in the function info
+//   of the MachineFunction whether its return address goes to the shadow
+//   stack, so that frame lowering and the shadow stack pass agree on it.
+//
+// Input:
+//   MF - A reference to the MachineFunction to transform.
+//
+// Return value:
+//   false - The MachineFunction was not transformed.
+//
+bool
+ARMRandezvousSSSelector::runOnMachineFunction(MachineFunction & MF) {
+  if (!EnableRandezvousShadowStack) {
+    return false;
+  }
+
+  ProfileSummaryInfo * PSI =
+    &getAnalysis<ProfileSummaryInfoWrapperPass>().getPSI();
+  bool Selected = usesRandezvousShadowStack(MF.getFunction(), PSI);
+  MF.getInfo<ARMFunctionInfo>()->setUsesRandezvousShadowStack(Selected);
+  if (Selected) {
+    ++NumFunctionsSelected;
+  }
+
+  return false;
+}
+
+FunctionPass *
+llvm::createARMRandezvousSSSelector(void) {
+  return new ARMRandezvousSSSelector();
+}
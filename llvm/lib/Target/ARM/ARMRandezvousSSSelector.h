@@ -0,0 +1,35 @@
+//===- ARMRandezvousSSSelector.h - ARM Randezvous Shadow Stack Selector ---===//
+//
+// Copyright (c) 2021-2022, University of Rochester
+//
+// Part of the Randezvous Project, under the Apache License v2.0 with
+// LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+// information.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the interfaces of a pass that selects the ARM machine
+// functions whose return address is saved to the Randezvous shadow stack.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef ARM_RANDEZVOUS_SS_SELECTOR
+#define ARM_RANDEZVOUS_SS_SELECTOR
+
+#include "llvm/CodeGen/MachineFunctionPass.h"
+
+namespace llvm {
+  struct ARMRandezvousSSSelector : public MachineFunctionPass {
+    // Pass Identifier
+    static char ID;
+
+    ARMRandezvousSSSelector();
+    virtual StringRef getPassName() const override;
+    void getAnalysisUsage(AnalysisUsage & AU) const override;
+    virtual bool runOnMachineFunction(MachineFunction & MF) override;
+  };
+
+  FunctionPass * createARMRandezvousSSSelector(void);
+}
+
+#endif
@@ -14,24 +14,34 @@
 //
 //===----------------------------------------------------------------------===//
 
-#define DEBUG_TYPE "arm-randezvous-shadow-stack"
-
+#include "ARMMachineFunctionInfo.h"
 #include "ARMRandezvousCLR.h"
+#include "ARMRandezvousLeakability.h"
 #include "ARMRandezvousOptions.h"
+#include "ARMRandezvousReport.h"
 #include "ARMRandezvousShadowStack.h"
+#include "ARMRandezvousTiering.h"
 #include "MCTargetDesc/ARMAddressingModes.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/MachineDominators.h"
 #include "llvm/CodeGen/MachineFrameInfo.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
 #include "llvm/CodeGen/MachineModuleInfo.h"
+#include "llvm/CodeGen/MachinePostDominators.h"
+#include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/IRBuilder.h"
-#include "llvm/Support/RandomNumberGenerator.h"
 #include "llvm/Transforms/Utils/ModuleUtils.h"
 
+#define DEBUG_TYPE "arm-randezvous-shadow-stack"
+
 using namespace llvm;
 
 STATISTIC(NumPrologues, "Number of prologues transformed to use shadow stack");
 STATISTIC(NumEpilogues, "Number of epilogues transformed to use shadow stack");
 STATISTIC(NumNullified, "Number of return addresses nullified");
+STATISTIC(NumShrinkWrapped, "Number of functions with shrink-wrapped shadow stack accesses");
 
 char ARMRandezvousShadowStack::ID = 0;
 
@@ -48,6 +58,12 @@ ARMRandezvousShadowStack::getAnalysisUsage(AnalysisUsage & AU) const {
   // We need this to access MachineFunctions
   AU.addRequired<MachineModuleInfoWrapperPass>();
 
+  // We need this to choose the protection tier of each function
+  AU.addRequired<ProfileSummaryInfoWrapperPass>();
+
+  // We neither reorder basic blocks nor add calls, so leakability holds
+  AU.addPreserved<ARMRandezvousLeakability>();
+
   AU.setPreservesCFG();
   ModulePass::getAnalysisUsage(AU);
 }
@@ -55,6 +71,33 @@ ARMRandezvousShadowStack::getAnalysisUsage(AnalysisUsage & AU) const {
 void
 ARMRandezvousShadowStack::releaseMemory() {
   TrapBlocks.clear();
+  TrapInstEnds.clear();
+}
+
+//
+// Function: declareLinkerSymbol()
+//
+// Description:
+//   This function declares a GlobalVariable of a given type for a symbol that
+//   the linker script defines.
+//
+// Inputs:
+//   M    - A reference to the Module in which to declare the symbol.
+//   Name - The name of the symbol.
+//   Ty   - A pointer to the type of the symbol.
+//
+// Return value:
+//   A pointer to the declared GlobalVariable.
+//
+static GlobalVariable *
+declareLinkerSymbol(Module & M, StringRef Name, Type * Ty) {
+  Constant * C = M.getOrInsertGlobal(Name, Ty);
+  GlobalVariable * GV = dyn_cast<GlobalVariable>(C->stripPointerCasts());
+  if (GV == nullptr) {
+    report_fatal_error("[ShadowStack] Linker-provided symbol @" + Name +
+                       " is not a global variable");
+  }
+  return GV;
 }
 
 //
@@ -63,7 +106,12 @@ ARMRandezvousShadowStack::releaseMemory() {
 // Description:
 //   This method creates a GlobalVariable as the shadow stack.  The shadow
 //   stack is initialized either as zeroed memory or with addresses of randomly
-//   picked trap blocks.
+//   picked trap blocks, and is placed in a given section with a given
+//   alignment if requested.  If a linker-provided base symbol is requested
+//   instead, this method only declares the symbol, and the linker script
+//   decides where the shadow stack is.  Its size is still the one given by
+//   -arm-randezvous-shadow-stack-size, which the init function checks against
+//   the linker-provided end symbol.
 //
 // Input:
 //   M - A reference to the Module in which to create the shadow stack.
@@ -80,25 +128,51 @@ ARMRandezvousShadowStack::createShadowStack(Module & M) {
   ArrayType * SSTy = ArrayType::get(RetAddrTy,
                                     RandezvousShadowStackSize / PtrSize);
 
+  // Declare the linker-provided shadow stack if requested; it cannot be
+  // initialized by us
+  if (!RandezvousShadowStackBase.empty()) {
+    if (RandezvousShadowStackEnd.empty()) {
+      report_fatal_error("[ShadowStack] Linker-provided shadow stack base "
+                         "requires a linker-provided shadow stack end");
+    }
+    return declareLinkerSymbol(M, RandezvousShadowStackBase, SSTy);
+  }
+
   // Create the shadow stack
   Constant * CSS = M.getOrInsertGlobal(ShadowStackName, SSTy);
   GlobalVariable * SS = dyn_cast<GlobalVariable>(CSS);
   assert(SS != nullptr && "Shadow stack has wrong type!");
+  RNG = createRandezvousRNG(RandezvousShadowStackSeed,
+                            getPassName() + "-decoys", *SS);
   SS->setLinkage(GlobalVariable::LinkOnceAnyLinkage);
 
+  // Place the shadow stack as requested (e.g., in tightly coupled memory)
+  if (!RandezvousShadowStackSection.empty()) {
+    SS->setSection(RandezvousShadowStackSection);
+  }
+  if (RandezvousShadowStackAlignment != 0) {
+    if (!isPowerOf2_32(RandezvousShadowStackAlignment)) {
+      report_fatal_error("[ShadowStack] Shadow stack alignment must be a "
+                         "power of two");
+    }
+    SS->setAlignment(Align(RandezvousShadowStackAlignment));
+  }
+
   // Initialize the shadow stack if not initialized
   if (!SS->hasInitializer()) {
     Constant * SSInit = nullptr;
     if (EnableRandezvousDecoyPointers) {
       // Initialize the shadow stack with an array of random values; they are
-      // either random trap block addresses or purely random values with the
-      // LSB set
+      // either random trap instruction addresses or purely random values with
+      // the LSB set
       std::vector<Constant *> SSInitArray;
       for (unsigned i = 0; i < SSTy->getNumElements(); ++i) {
         if (!TrapBlocks.empty()) {
-          uint64_t Idx = (*RNG)() % TrapBlocks.size();
-          const BasicBlock * BB = TrapBlocks[Idx]->getBasicBlock();
-          SSInitArray.push_back(BlockAddress::get(const_cast<BasicBlock *>(BB)));
+          uint64_t Idx = (*RNG)() % TrapInstEnds.back();
+          uint64_t Offset;
+          MachineBasicBlock * TrapBlock = findTrapInst(TrapBlocks, TrapInstEnds,
+                                                       Idx, Offset);
+          SSInitArray.push_back(createTrapInstAddress(*TrapBlock, Offset));
         } else {
           APInt A(8 * PtrSize, (*RNG)() | 0x1);
           SSInitArray.push_back(Constant::getIntegerValue(RetAddrTy, A));
@@ -123,7 +197,9 @@ ARMRandezvousShadowStack::createShadowStack(Module & M) {
 //
 // Description:
 //   This method creates a function (both Function and MachineFunction) that
-//   initializes the reserved registers for the shadow stack.
+//   initializes the reserved registers for the shadow stack.  If the shadow
+//   stack is provided by the linker, the function first traps if the linker
+//   script reserves less memory than the shadow stack size.
 //
 // Inputs:
 //   M  - A reference to the Module in which to create the function.
@@ -142,6 +218,8 @@ ARMRandezvousShadowStack::createInitFunction(Module & M, GlobalVariable & SS) {
   FunctionCallee FC = M.getOrInsertFunction(InitFuncName, FuncTy);
   Function * F = dyn_cast<Function>(FC.getCallee());
   assert(F != nullptr && "Init function has wrong type!");
+  RNG = createRandezvousRNG(RandezvousShadowStackSeed,
+                            getPassName() + "-stride", *F);
   MachineModuleInfo & MMI = getAnalysis<MachineModuleInfoWrapperPass>().getMMI();
   MachineFunction & MF = MMI.getOrCreateMachineFunction(*F);
 
@@ -173,11 +251,70 @@ ARMRandezvousShadowStack::createInitFunction(Module & M, GlobalVariable & SS) {
 
     // Build machine IR basic block(s)
     const TargetInstrInfo * TII = MF.getSubtarget().getInstrInfo();
+    MachineBasicBlock * CheckMBB = nullptr;
+    MachineBasicBlock * TrapMBB = nullptr;
+    if (!RandezvousShadowStackEnd.empty()) {
+      GlobalVariable * SSEnd = declareLinkerSymbol(M, RandezvousShadowStackEnd,
+                                                   Type::getInt8Ty(Ctx));
+      CheckMBB = MF.CreateMachineBasicBlock(BB);
+      TrapMBB = MF.CreateMachineBasicBlock(BB);
+      MF.push_back(CheckMBB);
+      CheckMBB->addSuccessor(TrapMBB);
+      // MOVi16 R0, @SSEnd_lo
+      BuildMI(CheckMBB, DebugLoc(), TII->get(ARM::t2MOVi16), ARM::R0)
+      .addGlobalAddress(SSEnd, 0, ARMII::MO_LO16)
+      .add(predOps(ARMCC::AL));
+      // MOVTi16 R0, @SSEnd_hi
+      BuildMI(CheckMBB, DebugLoc(), TII->get(ARM::t2MOVTi16), ARM::R0)
+      .addReg(ARM::R0)
+      .addGlobalAddress(SSEnd, 0, ARMII::MO_HI16)
+      .add(predOps(ARMCC::AL));
+      // MOVi16 R1, @SS_lo
+      BuildMI(CheckMBB, DebugLoc(), TII->get(ARM::t2MOVi16), ARM::R1)
+      .addGlobalAddress(&SS, 0, ARMII::MO_LO16)
+      .add(predOps(ARMCC::AL));
+      // MOVTi16 R1, @SS_hi
+      BuildMI(CheckMBB, DebugLoc(), TII->get(ARM::t2MOVTi16), ARM::R1)
+      .addReg(ARM::R1)
+      .addGlobalAddress(&SS, 0, ARMII::MO_HI16)
+      .add(predOps(ARMCC::AL));
+      // SUBrr R0, R0, R1
+      BuildMI(CheckMBB, DebugLoc(), TII->get(ARM::t2SUBrr), ARM::R0)
+      .addReg(ARM::R0)
+      .addReg(ARM::R1)
+      .add(predOps(ARMCC::AL))
+      .add(condCodeOp()); // No 'S' bit
+      // MOVi16 R1, #SSSize_lo
+      BuildMI(CheckMBB, DebugLoc(), TII->get(ARM::t2MOVi16), ARM::R1)
+      .addImm(RandezvousShadowStackSize & 0xffff)
+      .add(predOps(ARMCC::AL));
+      // MOVTi16 R1, #SSSize_hi
+      BuildMI(CheckMBB, DebugLoc(), TII->get(ARM::t2MOVTi16), ARM::R1)
+      .addReg(ARM::R1)
+      .addImm((RandezvousShadowStackSize >> 16) & 0xffff)
+      .add(predOps(ARMCC::AL));
+      // CMPrr R0, R1
+      BuildMI(CheckMBB, DebugLoc(), TII->get(ARM::t2CMPrr))
+      .addReg(ARM::R0)
+      .addReg(ARM::R1)
+      .add(predOps(ARMCC::AL));
+      // BLO TrapMBB
+      BuildMI(CheckMBB, DebugLoc(), TII->get(ARM::t2Bcc))
+      .addMBB(TrapMBB)
+      .addImm(ARMCC::LO)
+      .addReg(ARM::CPSR, RegState::Kill);
+      // UDF #0
+      BuildMI(TrapMBB, DebugLoc(), TII->get(ARM::t2UDF_ga))
+      .addImm(0);
+    }
     MachineBasicBlock * MBB = MF.CreateMachineBasicBlock(BB);
     MachineBasicBlock * MBB2 = nullptr;
     MachineBasicBlock * MBB3 = nullptr;
     MachineBasicBlock * RetMBB = MBB;
     MF.push_back(MBB);
+    if (CheckMBB != nullptr) {
+      CheckMBB->addSuccessor(MBB);
+    }
     // MOVi16 SSPtrReg, @SS_lo
     BuildMI(MBB, DebugLoc(), TII->get(ARM::t2MOVi16), ShadowStackPtrReg)
     .addGlobalAddress(&SS, 0, ARMII::MO_LO16)
@@ -267,6 +404,11 @@ ARMRandezvousShadowStack::createInitFunction(Module & M, GlobalVariable & SS) {
     // BX_RET
     BuildMI(RetMBB, DebugLoc(), TII->get(ARM::tBX_RET))
     .add(predOps(ARMCC::AL));
+
+    // Place the trap block out of the way
+    if (TrapMBB != nullptr) {
+      MF.push_back(TrapMBB);
+    }
   }
 
   // Add the init function to @llvm.used
@@ -276,24 +418,85 @@ ARMRandezvousShadowStack::createInitFunction(Module & M, GlobalVariable & SS) {
 }
 
 //
-// Method: pushToShadowStack()
+// Function: markLinkRegisterRestored()
 //
 // Description:
-//   This method modifies a PUSH instruction to not save LR to the stack and
-//   inserts new instructions that save LR to the shadow stack.
+//   This function marks LR as restored in the callee-saved information of a
+//   MachineFunction, so that LR is considered live out of returns once a
+//   return instruction reads the return address from LR.
 //
-// Inputs:
-//   MI     - A reference to a PUSH instruction that saves LR to the stack.
-//   LR     - A reference to the LR operand of the PUSH.
-//   Stride - A static stride to use.
+// Input:
+//   MF - A reference to the MachineFunction.
 //
-// Return value:
-//   true - The machine code was modified.
+static void
+markLinkRegisterRestored(MachineFunction & MF) {
+  MachineFrameInfo & MFI = MF.getFrameInfo();
+  if (MFI.isCalleeSavedInfoValid()) {
+    for (CalleeSavedInfo & CSI : MFI.getCalleeSavedInfo()) {
+      if (CSI.getReg() == ARM::LR) {
+        CSI.setRestored(true);
+        break;
+      }
+    }
+  }
+}
+
 //
-bool
-ARMRandezvousShadowStack::pushToShadowStack(MachineInstr & MI,
-                                            MachineOperand & LR,
-                                            uint32_t Stride) {
+// Function: addLinkRegisterLiveIns()
+//
+// Description:
+//   This function adds LR to the live-ins of every reachable basic block of a
+//   MachineFunction on whose entry LR is live, i.e., on whose entry LR still
+//   holds a return address that is read later on or that a return needs.  LR
+//   is never removed from any live-ins, so the result is conservative.
+//
+// Input:
+//   MF - A reference to the MachineFunction.
+//
+static void
+addLinkRegisterLiveIns(MachineFunction & MF) {
+  const TargetRegisterInfo * TRI = MF.getSubtarget().getRegisterInfo();
+
+  // Iterate backward until nothing changes
+  bool Changed;
+  do {
+    Changed = false;
+    for (MachineBasicBlock * MBB : post_order(&MF)) {
+      bool Live = MBB->isReturnBlock();
+      for (MachineBasicBlock * Succ : MBB->successors()) {
+        Live |= Succ->isLiveIn(ARM::LR);
+      }
+      for (MachineInstr & MI : make_range(MBB->rbegin(), MBB->rend())) {
+        Register PredReg;
+        if (MI.modifiesRegister(ARM::LR, TRI) &&
+            getInstrPredicate(MI, PredReg) == ARMCC::AL) {
+          Live = false;
+        }
+        if (MI.readsRegister(ARM::LR, TRI)) {
+          Live = true;
+        }
+      }
+      if (Live && !MBB->isLiveIn(ARM::LR)) {
+        MBB->addLiveIn(ARM::LR);
+        Changed = true;
+      }
+    }
+  } while (Changed);
+}
+
+//
+// Method: removeFromPush()
+//
+// Description:
+//   This method modifies a PUSH instruction to not save LR to the stack.
+//
+// Inputs:
+//   MI - A reference to a PUSH instruction that saves LR to the stack.
+//   LR - A reference to the LR operand of the PUSH.
+//
+void
+ARMRandezvousShadowStack::removeFromPush(MachineInstr & MI,
+                                         MachineOperand & LR) {
   MachineFunction & MF = *MI.getMF();
   const TargetInstrInfo * TII = MF.getSubtarget().getInstrInfo();
   const DebugLoc & DL = MI.getDebugLoc();
@@ -301,27 +504,6 @@ ARMRandezvousShadowStack::pushToShadowStack(MachineInstr & MI,
   Register PredReg;
   ARMCC::CondCodes Pred = getInstrPredicate(MI, PredReg);
 
-  // Build the following instruction sequence
-  //
-  // STR_POST LR, [SSPtrReg], #Stride
-  // ADDrr    SSPtrReg, SSPtrReg, SSStrideReg
-  std::vector<MachineInstr *> NewInsts;
-  NewInsts.push_back(BuildMI(MF, DL, TII->get(ARM::t2STR_POST), ShadowStackPtrReg)
-                     .addReg(ARM::LR)
-                     .addReg(ShadowStackPtrReg)
-                     .addImm(Stride)
-                     .add(predOps(Pred, PredReg)));
-  NewInsts.push_back(BuildMI(MF, DL, TII->get(ARM::t2ADDrr), ShadowStackPtrReg)
-                     .addReg(ShadowStackPtrReg)
-                     .addReg(ShadowStackStrideReg)
-                     .add(predOps(Pred, PredReg))
-                     .add(condCodeOp()));
-
-  // Now insert these new instructions into the basic block
-  insertInstsBefore(MI, NewInsts);
-
-  // At last, replace the old PUSH with a new one that doesn't push LR to the
-  // stack
   switch (MI.getOpcode()) {
   case ARM::t2STMDB_UPD:
     // STMDB_UPD should store at least two registers; if it happens to be two,
@@ -359,31 +541,32 @@ ARMRandezvousShadowStack::pushToShadowStack(MachineInstr & MI,
     removeInst(MI);
     break;
   }
-
-  ++NumPrologues;
-  return true;
 }
 
 //
-// Method: popFromShadowStack()
+// Method: pushToShadowStack()
 //
 // Description:
-//   This method modifies a POP instruction to not write to PC/LR and inserts
-//   new instructions that load the return address from the shadow stack into
-//   PC/LR.
+//   This method modifies a PUSH instruction to not save LR to the stack and
+//   inserts new instructions that save LR to the shadow stack, either right
+//   before the PUSH or at the beginning of a given basic block that the PUSH
+//   dominates.
 //
 // Inputs:
-//   MI     - A reference to a POP instruction that writes to LR or PC.
-//   PCLR   - A reference to the PC or LR operand of the POP.
-//   Stride - A static stride to use.
+//   MI      - A reference to a PUSH instruction that saves LR to the stack.
+//   LR      - A reference to the LR operand of the PUSH.
+//   Stride  - A static stride to use.
+//   SaveMBB - A pointer to the basic block at which to save LR, or nullptr to
+//             save LR right before the PUSH.
 //
 // Return value:
 //   true - The machine code was modified.
 //
 bool
-ARMRandezvousShadowStack::popFromShadowStack(MachineInstr & MI,
-                                             MachineOperand & PCLR,
-                                             uint32_t Stride) {
+ARMRandezvousShadowStack::pushToShadowStack(MachineInstr & MI,
+                                            MachineOperand & LR,
+                                            uint32_t Stride,
+                                            MachineBasicBlock * SaveMBB) {
   MachineFunction & MF = *MI.getMF();
   const TargetInstrInfo * TII = MF.getSubtarget().getInstrInfo();
   const DebugLoc & DL = MI.getDebugLoc();
@@ -393,31 +576,65 @@ ARMRandezvousShadowStack::popFromShadowStack(MachineInstr & MI,
 
   // Build the following instruction sequence
   //
-  // SUBrr    SSPtrReg, SSPtrReg, SSStrideReg
-  // LDR_PRE  PC/LR, [SSPtrReg, #-Stride]!
+  // STR_POST LR, [SSPtrReg], #Stride
+  // ADDrr    SSPtrReg, SSPtrReg, SSStrideReg
   std::vector<MachineInstr *> NewInsts;
-  NewInsts.push_back(BuildMI(MF, DL, TII->get(ARM::t2SUBrr), ShadowStackPtrReg)
+  NewInsts.push_back(BuildMI(MF, DL, TII->get(ARM::t2STR_POST), ShadowStackPtrReg)
+                     .addReg(ARM::LR)
+                     .addReg(ShadowStackPtrReg)
+                     .addImm(Stride)
+                     .add(predOps(Pred, PredReg)));
+  NewInsts.push_back(BuildMI(MF, DL, TII->get(ARM::t2ADDrr), ShadowStackPtrReg)
                      .addReg(ShadowStackPtrReg)
                      .addReg(ShadowStackStrideReg)
                      .add(predOps(Pred, PredReg))
                      .add(condCodeOp()));
-  NewInsts.push_back(BuildMI(MF, DL, TII->get(PCLR.getReg() == ARM::PC ?
-                                              ARM::t2LDR_PRE_RET :
-                                              ARM::t2LDR_PRE),
-                             PCLR.getReg())
-                     .addReg(ShadowStackPtrReg, RegState::Define)
-                     .addReg(ShadowStackPtrReg)
-                     .addImm(-Stride)
-                     .add(predOps(Pred, PredReg)));
 
   // Now insert these new instructions into the basic block
-  insertInstsAfter(MI, NewInsts);
+  if (SaveMBB != nullptr) {
+    assert(!SaveMBB->empty() && "Empty save block!");
+    insertInstsBefore(SaveMBB->front(), NewInsts);
+  } else {
+    insertInstsBefore(MI, NewInsts);
+  }
+
+  // At last, replace the old PUSH with a new one that doesn't push LR to the
+  // stack
+  removeFromPush(MI, LR);
+
+  ++NumPrologues;
+  return true;
+}
+
+//
+// Method: removeFromPop()
+//
+// Description:
+//   This method modifies a POP instruction to not write to PC/LR.
+//
+// Inputs:
+//   MI   - A reference to a POP instruction that writes to LR or PC.
+//   PCLR - A reference to the PC or LR operand of the POP.
+//   Ret  - A pointer to the instruction that returns in place of the POP if
+//          the POP writes to PC, or nullptr otherwise.
+//
+void
+ARMRandezvousShadowStack::removeFromPop(MachineInstr & MI,
+                                        MachineOperand & PCLR,
+                                        MachineInstr * Ret) {
+  MachineFunction & MF = *MI.getMF();
+  const TargetInstrInfo * TII = MF.getSubtarget().getInstrInfo();
+  const DebugLoc & DL = MI.getDebugLoc();
+
+  Register PredReg;
+  ARMCC::CondCodes Pred = getInstrPredicate(MI, PredReg);
 
-  // Replace the old POP with a new one that doesn't write to PC/LR
   switch (MI.getOpcode()) {
   case ARM::t2LDMIA_RET:
     MI.setDesc(TII->get(ARM::t2LDMIA_UPD));
-    NewInsts[1]->copyImplicitOps(MF, MI);
+    if (Ret != nullptr) {
+      Ret->copyImplicitOps(MF, MI);
+    }
     for (unsigned i = MI.getNumOperands() - 1, e = MI.getNumExplicitOperands();
          i >= e; --i) {
       MI.RemoveOperand(i);
@@ -445,7 +662,9 @@ ARMRandezvousShadowStack::popFromShadowStack(MachineInstr & MI,
 
   case ARM::tPOP_RET:
     MI.setDesc(TII->get(ARM::tPOP));
-    NewInsts[1]->copyImplicitOps(MF, MI);
+    if (Ret != nullptr) {
+      Ret->copyImplicitOps(MF, MI);
+    }
     for (unsigned i = MI.getNumOperands() - 1, e = MI.getNumExplicitOperands();
          i >= e; --i) {
       MI.RemoveOperand(i);
@@ -468,6 +687,171 @@ ARMRandezvousShadowStack::popFromShadowStack(MachineInstr & MI,
     removeInst(MI);
     break;
   }
+}
+
+//
+// Method: popFromShadowStack()
+//
+// Description:
+//   This method modifies a POP instruction to not write to PC/LR and inserts
+//   new instructions that load the return address from the shadow stack into
+//   PC/LR.
+//
+// Inputs:
+//   MI     - A reference to a POP instruction that writes to LR or PC.
+//   PCLR   - A reference to the PC or LR operand of the POP.
+//   Stride - A static stride to use.
+//
+// Return value:
+//   true - The machine code was modified.
+//
+bool
+ARMRandezvousShadowStack::popFromShadowStack(MachineInstr & MI,
+                                             MachineOperand & PCLR,
+                                             uint32_t Stride) {
+  MachineFunction & MF = *MI.getMF();
+  const TargetInstrInfo * TII = MF.getSubtarget().getInstrInfo();
+  const DebugLoc & DL = MI.getDebugLoc();
+
+  Register PredReg;
+  ARMCC::CondCodes Pred = getInstrPredicate(MI, PredReg);
+
+  // Build the following instruction sequence
+  //
+  // SUBrr    SSPtrReg, SSPtrReg, SSStrideReg
+  // LDR_PRE  PC/LR, [SSPtrReg, #-Stride]!
+  std::vector<MachineInstr *> NewInsts;
+  NewInsts.push_back(BuildMI(MF, DL, TII->get(ARM::t2SUBrr), ShadowStackPtrReg)
+                     .addReg(ShadowStackPtrReg)
+                     .addReg(ShadowStackStrideReg)
+                     .add(predOps(Pred, PredReg))
+                     .add(condCodeOp()));
+  NewInsts.push_back(BuildMI(MF, DL, TII->get(PCLR.getReg() == ARM::PC ?
+                                              ARM::t2LDR_PRE_RET :
+                                              ARM::t2LDR_PRE),
+                             PCLR.getReg())
+                     .addReg(ShadowStackPtrReg, RegState::Define)
+                     .addReg(ShadowStackPtrReg)
+                     .addImm(-Stride)
+                     .add(predOps(Pred, PredReg)));
+
+  // Now insert these new instructions into the basic block
+  insertInstsAfter(MI, NewInsts);
+
+  // Replace the old POP with a new one that doesn't write to PC/LR
+  removeFromPop(MI, PCLR, NewInsts[1]);
+
+  if (EnableRandezvousRAN) {
+    // Nullify the return address in the shadow stack
+    nullifyReturnAddress(*NewInsts[1], NewInsts[1]->getOperand(0));
+  }
+
+  ++NumEpilogues;
+  return true;
+}
+
+//
+// Method: returnThroughLinkRegister()
+//
+// Description:
+//   This method modifies a POP instruction to not write to PC/LR, leaving the
+//   return address in LR, and inserts a BX_RET after it if it used to return.
+//   It is used when LR has been restored from the shadow stack before the
+//   epilogue and has not been touched since.
+//
+// Inputs:
+//   MI   - A reference to a POP instruction that writes to LR or PC.
+//   PCLR - A reference to the PC or LR operand of the POP.
+//
+// Return value:
+//   true - The machine code was modified.
+//
+bool
+ARMRandezvousShadowStack::returnThroughLinkRegister(MachineInstr & MI,
+                                                    MachineOperand & PCLR) {
+  MachineFunction & MF = *MI.getMF();
+  const TargetInstrInfo * TII = MF.getSubtarget().getInstrInfo();
+  const DebugLoc & DL = MI.getDebugLoc();
+
+  Register PredReg;
+  ARMCC::CondCodes Pred = getInstrPredicate(MI, PredReg);
+
+  // Return through LR if the POP used to return
+  MachineInstr * Ret = nullptr;
+  if (PCLR.getReg() == ARM::PC) {
+    Ret = BuildMI(MF, DL, TII->get(ARM::tBX_RET)).add(predOps(Pred, PredReg));
+    insertInstAfter(MI, Ret);
+  }
+
+  // Replace the old POP with a new one that doesn't write to PC/LR
+  removeFromPop(MI, PCLR, Ret);
+
+  // LR holds the return address at each return now
+  markLinkRegisterRestored(MF);
+  return true;
+}
+
+//
+// Method: restoreFromShadowStack()
+//
+// Description:
+//   This method inserts new instructions that load the return address from
+//   the shadow stack into LR after the last call of a given basic block, or
+//   at its beginning if it has no call.  This must be the last step of
+//   shrink-wrapping the shadow stack accesses of a function, as it brings the
+//   live-ins of LR up to date before nullifying the return address.
+//
+// Inputs:
+//   MBB    - A reference to the basic block at which to restore LR.
+//   Stride - A static stride to use.
+//
+// Return value:
+//   true - The machine code was modified.
+//
+bool
+ARMRandezvousShadowStack::restoreFromShadowStack(MachineBasicBlock & MBB,
+                                                 uint32_t Stride) {
+  MachineFunction & MF = *MBB.getParent();
+  const TargetInstrInfo * TII = MF.getSubtarget().getInstrInfo();
+
+  // Find the last call of MBB, if any
+  MachineInstr * LastCall = nullptr;
+  for (MachineInstr & MI : MBB) {
+    if (MI.isCall() && !MI.isReturn()) {
+      LastCall = &MI;
+    }
+  }
+  assert((LastCall != nullptr || !MBB.empty()) && "Empty restore block!");
+  const DebugLoc & DL = LastCall != nullptr ? LastCall->getDebugLoc()
+                                            : MBB.front().getDebugLoc();
+
+  // Build the following instruction sequence
+  //
+  // SUBrr    SSPtrReg, SSPtrReg, SSStrideReg
+  // LDR_PRE  LR, [SSPtrReg, #-Stride]!
+  std::vector<MachineInstr *> NewInsts;
+  NewInsts.push_back(BuildMI(MF, DL, TII->get(ARM::t2SUBrr), ShadowStackPtrReg)
+                     .addReg(ShadowStackPtrReg)
+                     .addReg(ShadowStackStrideReg)
+                     .add(predOps(ARMCC::AL))
+                     .add(condCodeOp()));
+  NewInsts.push_back(BuildMI(MF, DL, TII->get(ARM::t2LDR_PRE), ARM::LR)
+                     .addReg(ShadowStackPtrReg, RegState::Define)
+                     .addReg(ShadowStackPtrReg)
+                     .addImm(-Stride)
+                     .add(predOps(ARMCC::AL)));
+
+  // Now insert these new instructions into the basic block
+  if (LastCall != nullptr) {
+    insertInstsAfter(*LastCall, NewInsts);
+  } else {
+    insertInstsBefore(MBB.front(), NewInsts);
+  }
+
+  // LR now carries the return address from both the function entry and the
+  // restore to the returns; let the live-ins and the cached liveness know
+  addLinkRegisterLiveIns(MF);
+  invalidateCache();
 
   if (EnableRandezvousRAN) {
     // Nullify the return address in the shadow stack
@@ -505,15 +889,7 @@ ARMRandezvousShadowStack::nullifyReturnAddress(MachineInstr & MI,
 
   // Mark LR as restored since we're going to use LR to hold the return address
   // in all the cases
-  MachineFrameInfo & MFI = MF.getFrameInfo();
-  if (MFI.isCalleeSavedInfoValid()) {
-    for (CalleeSavedInfo & CSI : MFI.getCalleeSavedInfo()) {
-      if (CSI.getReg() == ARM::LR) {
-        CSI.setRestored(true);
-        break;
-      }
-    }
-  }
+  markLinkRegisterRestored(MF);
 
   // We need to use a scratch register as the source register of a store.  If
   // no free register is around, spill and use R4.
@@ -642,16 +1018,19 @@ ARMRandezvousShadowStack::nullifyReturnAddress(MachineInstr & MI,
     }
     if (EnableRandezvousDecoyPointers) {
       if (!TrapBlocks.empty()) {
-        // Use the address of a trap block as the null value
-        uint64_t Idx = (*RNG)() % TrapBlocks.size();
-        const BasicBlock * BB = TrapBlocks[Idx]->getBasicBlock();
+        // Use the address of a trap instruction as the null value
+        uint64_t Idx = (*RNG)() % TrapInstEnds.back();
+        uint64_t Offset;
+        MachineBasicBlock * TrapBlock = findTrapInst(TrapBlocks, TrapInstEnds,
+                                                     Idx, Offset);
+        const BasicBlock * BB = TrapBlock->getBasicBlock();
         BlockAddress * BA = BlockAddress::get(const_cast<BasicBlock *>(BB));
         NewInsts.push_back(BuildMI(MF, DL, TII->get(ARM::t2MOVi16), FreeReg)
-                           .addBlockAddress(BA, 0, ARMII::MO_LO16)
+                           .addBlockAddress(BA, Offset, ARMII::MO_LO16)
                            .add(predOps(Pred, PredReg)));
         NewInsts.push_back(BuildMI(MF, DL, TII->get(ARM::t2MOVTi16), FreeReg)
                            .addReg(FreeReg)
-                           .addBlockAddress(BA, 0, ARMII::MO_HI16)
+                           .addBlockAddress(BA, Offset, ARMII::MO_HI16)
                            .add(predOps(Pred, PredReg)));
       } else {
         // Use a random value with the LSB set as the null value
@@ -694,6 +1073,153 @@ ARMRandezvousShadowStack::nullifyReturnAddress(MachineInstr & MI,
   return true;
 }
 
+//
+// Function: findShadowStackRegion()
+//
+// Description:
+//   This function shrink-wraps the shadow stack accesses of a function that
+//   saves LR in its prologue: it finds a basic block at which to save LR to
+//   the shadow stack and a basic block at which to restore LR from the shadow
+//   stack, so that only paths making calls pay for the shadow stack.  LR
+//   keeps the return address on all the other paths, and the epilogues
+//   return through LR.  This only works if nothing but the prologue, the
+//   epilogues, calls, and returns touch LR, so that LR still holds the return
+//   address wherever no call has clobbered it.
+//
+//   The save block is the nearest common dominator of all the basic blocks
+//   with calls and the restore block is their nearest common post-dominator.
+//   The save block must dominate and be post-dominated by the restore block,
+//   and neither of them may be in a loop, so that each path from the entry
+//   to a return goes through both of them exactly once or through neither of
+//   them.
+//
+// Inputs:
+//   MF   - A reference to the MachineFunction.
+//   Push - A reference to the PUSH instruction that saves LR.
+//   Pops - All the POP instructions that restore LR or PC.
+//
+// Outputs:
+//   SaveMBB    - The basic block at which to save LR.
+//   RestoreMBB - The basic block at which to restore LR.
+//
+// Return value:
+//   true  - The shadow stack accesses can be shrink-wrapped.
+//   false - The shadow stack accesses cannot be shrink-wrapped.
+//
+static bool
+findShadowStackRegion(MachineFunction & MF, MachineInstr & Push,
+                      ArrayRef<std::pair<MachineInstr *, MachineOperand *> > Pops,
+                      MachineBasicBlock *& SaveMBB,
+                      MachineBasicBlock *& RestoreMBB) {
+  const TargetRegisterInfo * TRI = MF.getSubtarget().getRegisterInfo();
+  MachineDominatorTree MDT(MF);
+
+  SmallPtrSet<const MachineInstr *, 8> FrameInsts;
+  FrameInsts.insert(&Push);
+  for (auto & MIMO : Pops) {
+    FrameInsts.insert(MIMO.first);
+  }
+
+  // Find out all reachable basic blocks with calls (other than tail calls),
+  // and make sure that nothing else touches LR
+  std::vector<MachineBasicBlock *> CallBlocks;
+  for (MachineBasicBlock & MBB : MF) {
+    if (!MDT.isReachableFromEntry(&MBB)) {
+      continue;
+    }
+    if (MBB.isEHPad()) {
+      return false;
+    }
+
+    bool HasCall = false;
+    for (MachineInstr & MI : MBB) {
+      if (MI.isCall() && !MI.isReturn()) {
+        HasCall = true;
+        continue;
+      }
+      if (MI.isReturn() || MI.isDebugInstr() || FrameInsts.count(&MI)) {
+        continue;
+      }
+      if (MI.readsRegister(ARM::LR, TRI) || MI.modifiesRegister(ARM::LR, TRI)) {
+        return false;
+      }
+    }
+    if (HasCall) {
+      CallBlocks.push_back(&MBB);
+    }
+  }
+
+  // Functions without calls have nothing to shrink-wrap around
+  if (CallBlocks.empty()) {
+    return false;
+  }
+
+  MachinePostDominatorTree MPDT;
+  MPDT.runOnMachineFunction(MF);
+  MachineLoopInfo MLI(MDT);
+
+  SaveMBB = CallBlocks[0];
+  for (MachineBasicBlock * MBB : CallBlocks) {
+    SaveMBB = MDT.findNearestCommonDominator(SaveMBB, MBB);
+  }
+  RestoreMBB = MPDT.findNearestCommonDominator(CallBlocks);
+  if (SaveMBB == nullptr || RestoreMBB == nullptr) {
+    return false;
+  }
+
+  // Nothing is gained if LR would be saved where it is saved already
+  MachineBasicBlock * PushMBB = Push.getParent();
+  if (SaveMBB == PushMBB || SaveMBB->empty()) {
+    return false;
+  }
+  if (!MDT.dominates(PushMBB, SaveMBB) ||
+      !MDT.dominates(SaveMBB, RestoreMBB) ||
+      !MPDT.dominates(RestoreMBB, SaveMBB)) {
+    return false;
+  }
+  if (MLI.getLoopFor(SaveMBB) != nullptr ||
+      MLI.getLoopFor(RestoreMBB) != nullptr) {
+    return false;
+  }
+
+  // Don't restore LR after a conditional call
+  for (MachineInstr & MI : make_range(RestoreMBB->rbegin(),
+                                      RestoreMBB->rend())) {
+    if (MI.isCall() && !MI.isReturn()) {
+      Register PredReg;
+      if (getInstrPredicate(MI, PredReg) != ARMCC::AL) {
+        return false;
+      }
+      break;
+    }
+  }
+  if (RestoreMBB->empty()) {
+    return false;
+  }
+
+  return true;
+}
+
+//
+// Function: getNumInstrsAdded()
+//
+// Description:
+//   This function computes how many instructions have been added to a
+//   MachineBasicBlock since it had a given number of instructions.
+//
+// Inputs:
+//   MBB     - A const reference to the MachineBasicBlock.
+//   OldSize - The number of instructions that the MachineBasicBlock had.
+//
+// Return value:
+//   The number of instructions added, or 0 if the MachineBasicBlock has
+//   shrunk.
+//
+static uint64_t
+getNumInstrsAdded(const MachineBasicBlock & MBB, uint64_t OldSize) {
+  return MBB.size() > OldSize ? MBB.size() - OldSize : 0;
+}
+
 //
 // Method: runOnModule()
 //
@@ -726,8 +1252,12 @@ ARMRandezvousShadowStack::runOnModule(Module & M) {
   }
 
   MachineModuleInfo & MMI = getAnalysis<MachineModuleInfoWrapperPass>().getMMI();
-  Twine RNGName = getPassName() + "-" + Twine(RandezvousShadowStackSeed);
-  RNG = M.createRNG(RNGName.str());
+  ProfileSummaryInfo * PSI =
+    &getAnalysis<ProfileSummaryInfoWrapperPass>().getPSI();
+  ARMRandezvousLeakability * LA =
+    getAnalysisIfAvailable<ARMRandezvousLeakability>();
+  RandezvousPassReport Report("shadow-stack");
+  Report.beginModule(M, MMI);
 
   // Find trap blocks inserted by CLR
   for (Function & F : M) {
@@ -735,7 +1265,9 @@ ARMRandezvousShadowStack::runOnModule(Module & M) {
     if (MF != nullptr) {
       for (MachineBasicBlock & MBB : *MF) {
         if (MBB.isRandezvousTrapBlock()) {
+          uint64_t NumTrapInsts = TrapInstEnds.empty() ? 0 : TrapInstEnds.back();
           TrapBlocks.push_back(&MBB);
+          TrapInstEnds.push_back(NumTrapInsts + MBB.size());
         }
       }
     }
@@ -753,7 +1285,17 @@ ARMRandezvousShadowStack::runOnModule(Module & M) {
     //   register, and
     // * generates a random stride (either dynamic or static) to the shadow
     //   stack stride register
-    createInitFunction(M, *SS);
+    Function * InitFunc = createInitFunction(M, *SS);
+
+    // A linker-provided shadow stack cannot be initialized with decoys
+    if (!RandezvousShadowStackBase.empty() && EnableRandezvousDecoyPointers) {
+      M.getContext().diagnose(
+        DiagnosticInfoUnsupported(*InitFunc,
+                                  "decoy pointers not placed in "
+                                  "linker-provided shadow stack @" +
+                                  RandezvousShadowStackBase,
+                                  DiagnosticLocation(), DS_Warning));
+    }
   }
 
   // Instrument pushes and pops in each function
@@ -763,6 +1305,8 @@ ARMRandezvousShadowStack::runOnModule(Module & M) {
     if (MF == nullptr) {
       continue;
     }
+    RNG = createRandezvousRNG(RandezvousShadowStackSeed,
+                              getPassName() + "-instrument", F);
 
     // Find out all pushes that write LR to the stack and all pops that read a
     // return address from the stack to LR or PC
@@ -823,8 +1367,32 @@ ARMRandezvousShadowStack::runOnModule(Module & M) {
       }
     }
 
-    // Instrument each push and pop
-    if (EnableRandezvousShadowStack) {
+    // Choose how to protect the return address; functions that opt out get
+    // neither the shadow stack nor RAN, and functions in the reduced tier use
+    // RAN instead of the shadow stack and need neither if LR never goes to
+    // memory; frame lowering has already made the choice for the shadow stack
+    RandezvousTier Tier = getRandezvousTier(F, PSI);
+    ARMFunctionInfo * AFI = MF->getInfo<ARMFunctionInfo>();
+    bool UseShadowStack = AFI->usesRandezvousShadowStack();
+    bool UseRAN = EnableRandezvousRAN;
+    if (hasRandezvousOption(F, "no-shadow-stack")) {
+      UseShadowStack = UseRAN = false;
+    } else if (Tier == RandezvousTier::Reduced) {
+      UseRAN |= EnableRandezvousShadowStack;
+      if (LA != nullptr && !LA->canSpillLinkRegister(F)) {
+        UseRAN = false;
+      }
+    }
+
+    // Instrument each push and pop; a single invocation goes through all the
+    // pushes in the prologue but only one of the epilogues, so the estimated
+    // overhead counts the costliest pop
+    uint64_t PushCost = 0;
+    uint64_t PopCost = 0;
+    uint64_t NumSites = 0;
+    if (UseShadowStack) {
+      NumSites = Pushes.size() + Pops.size();
+
       // Generate a per-function static stride
       uint32_t Stride = (*RNG)();
       Stride &= (1ul << (RandezvousShadowStackStrideLength - 1)) - 1;
@@ -839,18 +1407,63 @@ ARMRandezvousShadowStack::runOnModule(Module & M) {
         Stride = 4u;
       }
 
-      for (auto & MIMO : Pushes) {
-        changed |= pushToShadowStack(*MIMO.first, *MIMO.second, Stride);
-      }
-      for (auto & MIMO : Pops) {
-        changed |= popFromShadowStack(*MIMO.first, *MIMO.second, Stride);
+      // Save and restore LR only around the calls if possible
+      MachineBasicBlock * SaveMBB = nullptr;
+      MachineBasicBlock * RestoreMBB = nullptr;
+      if (EnableRandezvousShadowStackOpt && Pushes.size() == 1 &&
+          findShadowStackRegion(*MF, *Pushes[0].first, Pops, SaveMBB,
+                                RestoreMBB)) {
+        for (auto & MIMO : Pops) {
+          MachineBasicBlock & MBB = *MIMO.first->getParent();
+          uint64_t OldSize = MBB.size();
+          changed |= returnThroughLinkRegister(*MIMO.first, *MIMO.second);
+          PopCost = std::max(PopCost, getNumInstrsAdded(MBB, OldSize));
+        }
+        uint64_t OldSize = SaveMBB->size();
+        changed |= pushToShadowStack(*Pushes[0].first, *Pushes[0].second,
+                                     Stride, SaveMBB);
+        PushCost += getNumInstrsAdded(*SaveMBB, OldSize);
+        OldSize = RestoreMBB->size();
+        changed |= restoreFromShadowStack(*RestoreMBB, Stride);
+        PopCost += getNumInstrsAdded(*RestoreMBB, OldSize);
+        ++NumShrinkWrapped;
+      } else {
+        for (auto & MIMO : Pushes) {
+          MachineBasicBlock & MBB = *MIMO.first->getParent();
+          uint64_t OldSize = MBB.size();
+          changed |= pushToShadowStack(*MIMO.first, *MIMO.second, Stride);
+          PushCost += getNumInstrsAdded(MBB, OldSize);
+        }
+        for (auto & MIMO : Pops) {
+          MachineBasicBlock & MBB = *MIMO.first->getParent();
+          uint64_t OldSize = MBB.size();
+          changed |= popFromShadowStack(*MIMO.first, *MIMO.second, Stride);
+          PopCost = std::max(PopCost, getNumInstrsAdded(MBB, OldSize));
+        }
       }
-    } else if (EnableRandezvousRAN) {
+    } else if (UseRAN) {
+      NumSites = Pops.size();
       for (auto & MIMO : Pops) {
+        MachineBasicBlock & MBB = *MIMO.first->getParent();
+        uint64_t OldSize = MBB.size();
         changed |= nullifyReturnAddress(*MIMO.first, *MIMO.second);
+        PopCost = std::max(PopCost, getNumInstrsAdded(MBB, OldSize));
       }
     }
+    if (EnableRandezvousShadowStack || EnableRandezvousRAN) {
+      StringRef Protection = UseShadowStack ? "shadow-stack" :
+                             UseRAN ? "ran" : "none";
+      uint64_t Overhead = getRandezvousDynamicCount(F, PushCost + PopCost);
+      recordRandezvousOverhead(Report, F, Tier, Protection, Overhead);
+    }
+    Report.addCounter(F, "sites", NumSites);
+
+    // Drop cached liveness and IT index of MF before moving on to the next
+    // function
+    invalidateCache();
   }
+  Report.endModule(M, MMI);
+  Report.write(M);
 
   return changed;
 }
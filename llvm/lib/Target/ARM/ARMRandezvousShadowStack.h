@@ -18,7 +18,6 @@
 
 #include "ARMRandezvousInstrumentor.h"
 #include "llvm/Pass.h"
-#include "llvm/Support/RandomNumberGenerator.h"
 
 namespace llvm {
   struct ARMRandezvousShadowStack : public ModulePass, ARMRandezvousInstrumentor {
@@ -37,15 +36,22 @@ namespace llvm {
     virtual bool runOnModule(Module & M) override;
 
   private:
-    std::unique_ptr<RandomNumberGenerator> RNG;
+    std::unique_ptr<RandezvousRNG> RNG;
     std::vector<MachineBasicBlock *> TrapBlocks;
+    std::vector<uint64_t> TrapInstEnds;
 
     GlobalVariable * createShadowStack(Module & M);
     Function * createInitFunction(Module & M, GlobalVariable & SS);
+    void removeFromPush(MachineInstr & MI, MachineOperand & LR);
+    void removeFromPop(MachineInstr & MI, MachineOperand & PCLR,
+                       MachineInstr * Ret);
     bool pushToShadowStack(MachineInstr & MI, MachineOperand & LR,
-                           uint32_t Stride);
+                           uint32_t Stride,
+                           MachineBasicBlock * SaveMBB = nullptr);
     bool popFromShadowStack(MachineInstr & MI, MachineOperand & PCLR,
                             uint32_t Stride);
+    bool returnThroughLinkRegister(MachineInstr & MI, MachineOperand & PCLR);
+    bool restoreFromShadowStack(MachineBasicBlock & MBB, uint32_t Stride);
     bool nullifyReturnAddress(MachineInstr & MI, MachineOperand & PCLR);
   };
 
@@ -0,0 +1,219 @@
+//===- ARMRandezvousTiering.cpp - ARM Randezvous Protection Tiering -------===//
+//
+// Copyright (c) 2021-2022, University of Rochester
+//
+// Part of the Randezvous Project, under the Apache License v2.0 with
+// LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+// information.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains the implementation of the functions that choose how much
+// protection each function gets from Randezvous passes.
+//
+// Without tiering, every function gets all the protections that are enabled.
+// With tiering and a profile (either sampled or instrumented), functions whose
+// entry count is hot according to the profile summary get a reduced tier:
+//
+// * CLR keeps hot fall-through edges (as profile-guided BBLR does) instead of
+//   breaking up every fall-through edge with BBLR, so hot loops are not
+//   scattered;
+//
+// * the shadow stack pass nullifies return addresses instead of moving them
+//   to the shadow stack, and leaves alone functions that cannot spill LR at
+//   all according to the leakability analysis;
+//
+// * the indirect call limiter leaves register allocation alone.
+//
+// Independently of tiering, a function can carry a "randezvous" attribute
+// (e.g., from __attribute__((randezvous(...))) or #pragma clang randezvous in
+// clang) holding a comma-separated list of options:
+//
+// * "no-layout" keeps CLR from reordering its basic blocks or inserting trap
+//   instructions between them;
+//
+// * "no-shadow-stack" keeps the shadow stack pass from instrumenting it with
+//   either the shadow stack or RAN;
+//
+// * "no-icall-limiter" keeps the indirect call limiter away from it;
+//
+// * "full" keeps it in the full tier and makes CLR use plain BBLR on it even
+//   if profile-guided BBLR is requested.
+//
+// Each pass can add the protection it applied to each function and the
+// estimated dynamic overhead of it to its report (see
+// ARMRandezvousReport.cpp) as a "tiering" record.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ARMRandezvousOptions.h"
+#include "ARMRandezvousReport.h"
+#include "ARMRandezvousTiering.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MathExtras.h"
+
+using namespace llvm;
+
+//
+// Function: getTierName()
+//
+// Description:
+//   This function returns the name of a tier as used in reports.
+//
+static StringRef
+getTierName(RandezvousTier Tier) {
+  switch (Tier) {
+  case RandezvousTier::Full:    return "full";
+  case RandezvousTier::Reduced: return "reduced";
+  }
+  llvm_unreachable("Invalid tier!");
+}
+
+//
+// Function: hasRandezvousOption()
+//
+// Description:
+//   This function checks if a Function's "randezvous" attribute lists a given
+//   option.
+//
+// Inputs:
+//   F      - A const reference to the Function.
+//   Option - The option of interest.
+//
+// Return value:
+//   true  - The Function has the option.
+//   false - The Function does not have the option.
+//
+bool
+llvm::hasRandezvousOption(const Function & F, StringRef Option) {
+  if (!F.hasFnAttribute("randezvous")) {
+    return false;
+  }
+
+  SmallVector<StringRef, 4> Options;
+  F.getFnAttribute("randezvous").getValueAsString().split(Options, ',', -1,
+                                                           false);
+  for (StringRef Opt : Options) {
+    if (Opt.trim() == Option) {
+      return true;
+    }
+  }
+  return false;
+}
+
+//
+// Function: getRandezvousTier()
+//
+// Description:
+//   This function chooses the protection tier of a Function.  A Function gets
+//   the reduced tier only if tiering is enabled, the Module has a profile
+//   summary, the Function's entry count is hot, and the Function does not
+//   ask for full protection.
+//
+// Inputs:
+//   F   - A const reference to the Function.
+//   PSI - A pointer to the profile summary info, or nullptr if unavailable.
+//
+// Return value:
+//   The protection tier of the Function.
+//
+RandezvousTier
+llvm::getRandezvousTier(const Function & F, ProfileSummaryInfo * PSI) {
+  if (!EnableRandezvousTiering || PSI == nullptr ||
+      !PSI->hasProfileSummary()) {
+    return RandezvousTier::Full;
+  }
+
+  if (PSI->isFunctionEntryHot(&F) && !hasRandezvousOption(F, "full")) {
+    return RandezvousTier::Reduced;
+  }
+  return RandezvousTier::Full;
+}
+
+//
+// Function: usesRandezvousShadowStack()
+//
+// Description:
+//   This function decides if the return address of a Function is saved to the
+//   shadow stack.  The shadow stack selector makes this decision before frame
+//   lowering, as LR gets no stack slot if it goes to the shadow stack.
+//
+// Inputs:
+//   F   - A const reference to the Function.
+//   PSI - A pointer to the profile summary info, or nullptr if unavailable.
+//
+// Return value:
+//   true  - The Function uses the shadow stack.
+//   false - The Function does not use the shadow stack.
+//
+bool
+llvm::usesRandezvousShadowStack(const Function & F, ProfileSummaryInfo * PSI) {
+  if (!EnableRandezvousShadowStack || hasRandezvousOption(F, "no-shadow-stack")) {
+    return false;
+  }
+  return getRandezvousTier(F, PSI) == RandezvousTier::Full;
+}
+
+//
+// Function: getRandezvousDynamicCount()
+//
+// Description:
+//   This function scales how many times something happens per invocation of
+//   a Function to the whole profiled run, if the Function has an entry count.
+//
+// Inputs:
+//   F                - A const reference to the Function.
+//   NumPerInvocation - How many times it happens per invocation.
+//
+// Return value:
+//   How many times it happens during the whole profiled run (saturating at
+//   the maximum uint64_t), or per invocation if the Function has no entry
+//   count.
+//
+uint64_t
+llvm::getRandezvousDynamicCount(const Function & F, uint64_t NumPerInvocation) {
+  if (Optional<Function::ProfileCount> Count = F.getEntryCount()) {
+    return SaturatingMultiply(NumPerInvocation, Count->getCount());
+  }
+  return NumPerInvocation;
+}
+
+//
+// Function: recordRandezvousOverhead()
+//
+// Description:
+//   This function adds the protection that a pass applied to a Function and
+//   its estimated dynamic overhead to the report of the pass, if a report
+//   file is requested.
+//
+// Inputs:
+//   Report     - A reference to the report of the pass.
+//   F          - A const reference to the Function.
+//   Tier       - The protection tier of the Function.
+//   Protection - The protection that the pass applied.
+//   Overhead   - The estimated number of dynamic instructions added, for the
+//                whole profiled run if the Function has an entry count and
+//                for a single invocation otherwise.
+//
+void
+llvm::recordRandezvousOverhead(RandezvousPassReport & Report,
+                               const Function & F, RandezvousTier Tier,
+                               StringRef Protection, uint64_t Overhead) {
+  if (!Report.isEnabled()) {
+    return;
+  }
+
+  json::Value EntryCount = nullptr;
+  if (Optional<Function::ProfileCount> Count = F.getEntryCount()) {
+    EntryCount = static_cast<int64_t>(Count->getCount());
+  }
+
+  Report.addRecord("tiering", json::Object {
+    { "function", F.getName() },
+    { "tier", getTierName(Tier) },
+    { "protection", Protection },
+    { "entry-count", std::move(EntryCount) },
+    { "overhead", static_cast<int64_t>(Overhead) },
+  });
+}
@@ -0,0 +1,50 @@
+//===- ARMRandezvousTiering.h - ARM Randezvous Protection Tiering ---------===//
+//
+// Copyright (c) 2021-2022, University of Rochester
+//
+// Part of the Randezvous Project, under the Apache License v2.0 with
+// LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+// information.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the functions that choose how much protection each
+// function gets from Randezvous passes and that report the estimated dynamic
+// overhead of the chosen protection.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef ARM_RANDEZVOUS_TIERING
+#define ARM_RANDEZVOUS_TIERING
+
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/IR/Function.h"
+
+namespace llvm {
+  class RandezvousPassReport;
+
+  enum class RandezvousTier {
+    // All enabled protections
+    Full,
+
+    // Cheaper protections for hot functions
+    Reduced,
+  };
+
+  bool hasRandezvousOption(const Function & F, StringRef Option);
+
+  RandezvousTier getRandezvousTier(const Function & F,
+                                   ProfileSummaryInfo * PSI);
+
+  bool usesRandezvousShadowStack(const Function & F,
+                                 ProfileSummaryInfo * PSI);
+
+  uint64_t getRandezvousDynamicCount(const Function & F,
+                                     uint64_t NumPerInvocation);
+
+  void recordRandezvousOverhead(RandezvousPassReport & Report,
+                                const Function & F, RandezvousTier Tier,
+                                StringRef Protection, uint64_t Overhead);
+}
+
+#endif
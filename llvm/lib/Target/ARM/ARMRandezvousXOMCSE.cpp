@@ -0,0 +1,410 @@
+//===- ARMRandezvousXOMCSE.cpp - ARM Randezvous Materialization CSE -------===//
+//
+// Copyright (c) 2021-2022, University of Rochester
+//
+// Part of the Randezvous Project, under the Apache License v2.0 with
+// LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+// information.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains the implementation of a pass that reuses and hoists
+// repeated 32-bit constant and address materializations in ARM machine code.
+//
+// With execute-only code (as PicoXOM forces), every 32-bit constant and
+// global address that cannot be encoded as an immediate is materialized by a
+// MOVW/MOVT pair (the t2MOVi32imm pseudo) instead of a literal pool load.
+// Instruction selection already shares such values across a function, but
+// register allocation freely rematerializes t2MOVi32imm, so the same value
+// is often materialized again and again, including in loop bodies.  This
+// pass runs after register allocation and before t2MOVi32imm is expanded:
+//
+// * It replaces a materialization with a 16-bit register move (or nothing) if
+//   another register still holds the same value in the same extended basic
+//   block;
+//
+// * It hoists a materialization out of a loop into the loop preheader if its
+//   destination register is free in the whole loop.
+//
+// The pass only sees materializations from instruction selection (e.g., of
+// global addresses and of constants).  The MOVW/MOVT pairs that the
+// Randezvous code generation passes add later (shadow stack pointers, decoy
+// return addresses, and the global guard) are left as they are: they run
+// after this pass, mostly materialize a different value each time, and CLR
+// fills the text section up to its budget right after them, so any code
+// removed then would only be replaced by trap instructions.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ARMBaseInstrInfo.h"
+#include "ARMRandezvousOptions.h"
+#include "ARMRandezvousReport.h"
+#include "ARMRandezvousXOMCSE.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+
+#define DEBUG_TYPE "arm-randezvous-xom-cse"
+
+using namespace llvm;
+
+STATISTIC(NumReused, "Number of materializations replaced by register moves");
+STATISTIC(NumRemoved, "Number of redundant materializations removed");
+STATISTIC(NumHoisted, "Number of materializations hoisted out of loops");
+STATISTIC(NumBytesSaved, "Total size of code saved by materialization CSE");
+
+char ARMRandezvousXOMCSE::ID = 0;
+
+ARMRandezvousXOMCSE::ARMRandezvousXOMCSE()
+    : MachineFunctionPass(ID), Report("xom-cse") {
+}
+
+StringRef
+ARMRandezvousXOMCSE::getPassName() const {
+  return "ARM Randezvous Materialization CSE Pass";
+}
+
+void
+ARMRandezvousXOMCSE::getAnalysisUsage(AnalysisUsage & AU) const {
+  // We need this to find loops to hoist materializations out of
+  AU.addRequired<MachineLoopInfo>();
+  AU.addPreserved<MachineLoopInfo>();
+
+  AU.setPreservesCFG();
+  MachineFunctionPass::getAnalysisUsage(AU);
+}
+
+//
+// Function: isMaterialization()
+//
+// Description:
+//   This function checks if an instruction materializes a 32-bit value that
+//   does not depend on any register.
+//
+static bool
+isMaterialization(const MachineInstr & MI) {
+  return MI.getOpcode() == ARM::t2MOVi32imm;
+}
+
+//
+// Method: extendLiveRange()
+//
+// Description:
+//   This method extends the live range of a register from an instruction
+//   that writes to it to a later instruction in the same extended basic
+//   block, by clearing kill flags in between and adding the register to the
+//   live-ins of the basic blocks in between.
+//
+// Inputs:
+//   Def - A reference to the instruction that writes to the register.
+//   MI  - A reference to the later instruction that reads the register.
+//   Reg - The register.
+//
+void
+ARMRandezvousXOMCSE::extendLiveRange(MachineInstr & Def, MachineInstr & MI,
+                                     Register Reg) {
+  const TargetRegisterInfo * TRI = MI.getMF()->getSubtarget().getRegisterInfo();
+
+  MachineBasicBlock * MBB = MI.getParent();
+  MachineBasicBlock::reverse_iterator I(MI);
+  while (true) {
+    for (MachineInstr & Inst : make_range(I, MBB->rend())) {
+      if (&Inst == &Def) {
+        for (MachineOperand & MO : Def.defs()) {
+          if (MO.isReg() && TRI->regsOverlap(MO.getReg(), Reg)) {
+            MO.setIsDead(false);
+          }
+        }
+        return;
+      }
+      Inst.clearRegisterKills(Reg, TRI);
+    }
+
+    // Move on to the only predecessor in the extended basic block
+    if (!MBB->isLiveIn(Reg)) {
+      MBB->addLiveIn(Reg);
+    }
+    assert(MBB->pred_size() == 1 && "Not an extended basic block!");
+    MBB = *MBB->pred_begin();
+    I = MBB->rbegin();
+  }
+}
+
+//
+// Method: reuseMaterializations()
+//
+// Description:
+//   This method replaces each materialization of a value that another
+//   register still holds with a register move, or removes it if its
+//   destination register holds the value already.  Values are tracked
+//   through extended basic blocks, i.e., a basic block with a single
+//   predecessor starts with the values available at the end of the
+//   predecessor.
+//
+// Input:
+//   MF - A reference to the MachineFunction to transform.
+//
+// Return value:
+//   true  - The MachineFunction was transformed.
+//   false - The MachineFunction was not transformed.
+//
+bool
+ARMRandezvousXOMCSE::reuseMaterializations(MachineFunction & MF) {
+  const TargetInstrInfo * TII = MF.getSubtarget().getInstrInfo();
+  const TargetRegisterInfo * TRI = MF.getSubtarget().getRegisterInfo();
+
+  bool changed = false;
+  DenseMap<const MachineBasicBlock *, std::vector<Available> > AvailOut;
+  ReversePostOrderTraversal<MachineFunction *> RPOT(&MF);
+  for (MachineBasicBlock * MBB : RPOT) {
+    std::vector<Available> Avail;
+    if (MBB->pred_size() == 1 && !MBB->isEHPad()) {
+      auto It = AvailOut.find(*MBB->pred_begin());
+      if (It != AvailOut.end()) {
+        Avail = It->second;
+      }
+    }
+
+    for (MachineInstr & MI : make_early_inc_range(*MBB)) {
+      MachineInstr * NewMI = &MI;
+      const MachineOperand * Value = nullptr;
+      if (isMaterialization(MI)) {
+        Register Dst = MI.getOperand(0).getReg();
+        Value = &MI.getOperand(1);
+        auto It = llvm::find_if(Avail, [&](const Available & A) {
+          return A.Value->isIdenticalTo(*Value);
+        });
+        if (It != Avail.end()) {
+          Value = It->Value;
+          if (It->Reg == Dst) {
+            // The destination register holds the value already
+            extendLiveRange(*It->Def, MI, Dst);
+            MI.eraseFromParent();
+            ++NumRemoved;
+            NumBytesSaved += 8;
+            changed = true;
+            continue;
+          }
+
+          // Copy the value from the register holding it:
+          //
+          // MOVr Dst, Reg
+          extendLiveRange(*It->Def, MI, It->Reg);
+          NewMI = BuildMI(*MBB, MI, MI.getDebugLoc(), TII->get(ARM::tMOVr),
+                          Dst)
+                  .addReg(It->Reg)
+                  .add(predOps(ARMCC::AL));
+          MI.eraseFromParent();
+          ++NumReused;
+          NumBytesSaved += 6;
+          changed = true;
+        }
+      }
+
+      // Forget values held by registers that the instruction clobbers
+      llvm::erase_if(Avail, [&](const Available & A) {
+        return NewMI->modifiesRegister(A.Reg, TRI);
+      });
+
+      // Remember the value that the instruction materializes
+      if (Value != nullptr) {
+        Avail.push_back({Value, NewMI->getOperand(0).getReg(), NewMI});
+      }
+    }
+
+    AvailOut[MBB] = std::move(Avail);
+  }
+
+  return changed;
+}
+
+//
+// Method: hoistMaterializations()
+//
+// Description:
+//   This method hoists materializations out of a loop (and its inner loops)
+//   into the loop preheader.  A materialization is hoisted only if no other
+//   instruction in the loop writes to its destination register and the
+//   register is not live on entry to the loop, so that the register is free
+//   to hold the value in the whole loop.
+//
+// Input:
+//   L - A reference to the loop.
+//
+// Return value:
+//   true  - The loop was transformed.
+//   false - The loop was not transformed.
+//
+bool
+ARMRandezvousXOMCSE::hoistMaterializations(MachineLoop & L) {
+  bool changed = false;
+  for (MachineLoop * SubLoop : L) {
+    changed |= hoistMaterializations(*SubLoop);
+  }
+
+  MachineBasicBlock * Preheader = L.getLoopPreheader();
+  if (Preheader == nullptr) {
+    return changed;
+  }
+  MachineBasicBlock * Header = L.getHeader();
+  const TargetRegisterInfo * TRI =
+    Header->getParent()->getSubtarget().getRegisterInfo();
+
+  // Collect materializations in the loop
+  std::vector<MachineInstr *> Candidates;
+  for (MachineBasicBlock * MBB : L.blocks()) {
+    for (MachineInstr & MI : *MBB) {
+      if (isMaterialization(MI)) {
+        Candidates.push_back(&MI);
+      }
+    }
+  }
+  if (Candidates.empty()) {
+    return changed;
+  }
+
+  // Count how many instructions in the loop write to the destination
+  // register of each materialization
+  DenseMap<unsigned, unsigned> NumDefs;
+  for (MachineInstr * MI : Candidates) {
+    NumDefs[MI->getOperand(0).getReg()] = 0;
+  }
+  for (MachineBasicBlock * MBB : L.blocks()) {
+    for (MachineInstr & MI : *MBB) {
+      for (auto & Entry : NumDefs) {
+        if (MI.modifiesRegister(Entry.first, TRI)) {
+          ++Entry.second;
+        }
+      }
+    }
+  }
+
+  for (MachineInstr * MI : Candidates) {
+    Register Dst = MI->getOperand(0).getReg();
+    if (NumDefs[Dst] != 1) {
+      continue;
+    }
+
+    bool LiveIn = false;
+    for (MCRegAliasIterator AI(Dst, TRI, true); AI.isValid(); ++AI) {
+      LiveIn |= Header->isLiveIn(*AI);
+    }
+    if (LiveIn) {
+      continue;
+    }
+
+    MachineBasicBlock::iterator InsertPt = Preheader->getFirstTerminator();
+    bool TerminatorReads = false;
+    for (MachineInstr & Term : make_range(InsertPt, Preheader->end())) {
+      TerminatorReads |= Term.readsRegister(Dst, TRI);
+    }
+    if (TerminatorReads) {
+      continue;
+    }
+
+    // Move the materialization and keep the value alive in the whole loop;
+    // the value may have been dead at its old place but is now used by the
+    // loop on every iteration
+    Preheader->splice(InsertPt, MI->getParent(), MI);
+    MI->getOperand(0).setIsDead(false);
+    for (MachineBasicBlock * MBB : L.blocks()) {
+      for (MachineInstr & Inst : *MBB) {
+        Inst.clearRegisterKills(Dst, TRI);
+      }
+      if (!MBB->isLiveIn(Dst)) {
+        MBB->addLiveIn(Dst);
+      }
+    }
+    ++NumHoisted;
+    changed = true;
+  }
+
+  return changed;
+}
+
+//
+// Method: doInitialization()
+//
+// Description:
+//   This method is called before the pass runs on any function of a Module.
+//   This method stops the timer of the report until a function is
+//   transformed.
+//
+// Input:
+//   M - A reference to the Module.
+//
+// Return value:
+//   false - The Module was not transformed.
+//
+bool
+ARMRandezvousXOMCSE::doInitialization(Module & M) {
+  Report.pauseTimer();
+  return MachineFunctionPass::doInitialization(M);
+}
+
+//
+// Method: runOnMachineFunction()
+//
+// Description:
+//   This method is called when the PassManager wants this pass to transform
+//   the specified MachineFunction.  This method first reuses materialized
+//   values within extended basic blocks and then hoists the remaining
+//   materializations out of loops.
+//
+// Input:
+//   MF - A reference to the MachineFunction to transform.
+//
+// Output:
+//   MF - The transformed MachineFunction.
+//
+// Return value:
+//   true  - The MachineFunction was transformed.
+//   false - The MachineFunction was not transformed.
+//
+bool
+ARMRandezvousXOMCSE::runOnMachineFunction(MachineFunction & MF) {
+  if (!EnableRandezvousXOMCSE) {
+    return false;
+  }
+
+  Report.resumeTimer();
+  Report.beginFunction(MF);
+
+  bool changed = reuseMaterializations(MF);
+
+  MachineLoopInfo & MLI = getAnalysis<MachineLoopInfo>();
+  for (MachineLoop * L : MLI) {
+    changed |= hoistMaterializations(*L);
+  }
+
+  Report.endFunction(MF);
+  Report.pauseTimer();
+
+  return changed;
+}
+
+//
+// Method: doFinalization()
+//
+// Description:
+//   This method is called after the pass has run on every function of a
+//   Module.  This method writes the report of the whole Module.
+//
+// Input:
+//   M - A reference to the Module.
+//
+// Return value:
+//   false - The Module was not transformed.
+//
+bool
+ARMRandezvousXOMCSE::doFinalization(Module & M) {
+  if (EnableRandezvousXOMCSE) {
+    Report.write(M);
+  }
+  return false;
+}
+
+FunctionPass *
+llvm::createARMRandezvousXOMCSE(void) {
+  return new ARMRandezvousXOMCSE();
+}
@@ -0,0 +1,57 @@
+//===- ARMRandezvousXOMCSE.h - ARM Randezvous Materialization CSE ---------===//
+//
+// Copyright (c) 2021-2022, University of Rochester
+//
+// Part of the Randezvous Project, under the Apache License v2.0 with
+// LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+// information.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the interfaces of a pass that reuses and hoists repeated
+// 32-bit constant and address materializations in ARM machine code.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef ARM_RANDEZVOUS_XOM_CSE
+#define ARM_RANDEZVOUS_XOM_CSE
+
+#include "ARMRandezvousReport.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
+
+namespace llvm {
+  struct ARMRandezvousXOMCSE : public MachineFunctionPass {
+    // Pass Identifier
+    static char ID;
+
+    ARMRandezvousXOMCSE();
+    virtual StringRef getPassName() const override;
+    void getAnalysisUsage(AnalysisUsage & AU) const override;
+    virtual bool doInitialization(Module & M) override;
+    virtual bool runOnMachineFunction(MachineFunction & MF) override;
+    virtual bool doFinalization(Module & M) override;
+
+  private:
+    // Report of the whole module, written once the module is finalized
+    RandezvousPassReport Report;
+
+    // A register known to hold a materialized value
+    struct Available {
+      // The operand naming the value (immediate, global address, etc.)
+      const MachineOperand * Value;
+      // The register holding the value
+      Register Reg;
+      // The instruction that last wrote the value to the register
+      MachineInstr * Def;
+    };
+
+    void extendLiveRange(MachineInstr & Def, MachineInstr & MI, Register Reg);
+    bool reuseMaterializations(MachineFunction & MF);
+    bool hoistMaterializations(MachineLoop & L);
+  };
+
+  FunctionPass * createARMRandezvousXOMCSE(void);
+}
+
+#endif
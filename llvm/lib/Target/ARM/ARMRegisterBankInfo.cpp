@@ -163,6 +163,10 @@ ARMRegisterBankInfo::ARMRegisterBankInfo(const TargetRegisterInfo &TRI)
            "Subclass not added?");
     assert(RBGPR.covers(*TRI.getRegClass(ARM::tGPROdd_and_tcGPRRegClassID)) &&
            "Subclass not added?");
+    assert(RBGPR.covers(*TRI.getRegClass(ARM::hGPRRegClassID)) &&
+           "Subclass not added?");
+    assert(RBGPR.covers(*TRI.getRegClass(ARM::GPRlrRegClassID)) &&
+           "Subclass not added?");
     assert(RBGPR.getSize() == 32 && "GPRs should hold up to 32-bit");
 
 #ifndef NDEBUG
@@ -195,12 +199,21 @@ ARMRegisterBankInfo::getRegBankFromRegClass(const TargetRegisterClass &RC,
   case tGPREven_and_tcGPRRegClassID:
   case tGPREven_and_tGPR_and_tcGPRRegClassID:
   case tGPROdd_and_tcGPRRegClassID:
+  case tGPRwithpcRegClassID:
+  case hGPRRegClassID:
+  case GPRnopc_and_hGPRRegClassID:
+  case hGPR_and_tGPREvenRegClassID:
+  case hGPR_and_tGPROddRegClassID:
+  case hGPR_and_tGPRwithpcRegClassID:
+  case hGPR_and_tcGPRRegClassID:
+  case GPRlrRegClassID:
     return getRegBank(ARM::GPRRegBankID);
   case HPRRegClassID:
   case SPR_8RegClassID:
   case SPRRegClassID:
   case DPR_8RegClassID:
   case DPRRegClassID:
+  case DPR_VFP2RegClassID:
   case QPRRegClassID:
     return getRegBank(ARM::FPRRegBankID);
   default:
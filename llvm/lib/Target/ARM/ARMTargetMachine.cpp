@@ -16,9 +16,12 @@
 #include "ARMRandezvousCLR.h"
 #include "ARMRandezvousGDLR.h"
 #include "ARMRandezvousICallLimiter.h"
+#include "ARMRandezvousICallPromote.h"
 #include "ARMRandezvousLGPromote.h"
 #include "ARMRandezvousPicoXOM.h"
+#include "ARMRandezvousSSSelector.h"
 #include "ARMRandezvousShadowStack.h"
+#include "ARMRandezvousXOMCSE.h"
 #include "ARMSubtarget.h"
 #include "ARMTargetObjectFile.h"
 #include "ARMTargetTransformInfo.h"
@@ -82,6 +85,12 @@ static cl::opt<cl::boolOrDefault>
 EnableGlobalMerge("arm-global-merge", cl::Hidden,
                   cl::desc("Enable the global merge pass"));
 
+static cl::opt<int>
+EnableGlobalISelAtO("arm-enable-global-isel-at-O", cl::Hidden,
+                    cl::desc("Enable GlobalISel for Thumb2 M-profile targets "
+                             "at or below an opt level (-1 to disable)"),
+                    cl::init(-1));
+
 namespace llvm {
   void initializeARMExecutionDomainFixPass(PassRegistry&);
 }
@@ -107,6 +116,7 @@ extern "C" LLVM_EXTERNAL_VISIBILITY void LLVMInitializeARMTarget() {
   initializeMVETailPredicationPass(Registry);
   initializeARMLowOverheadLoopsPass(Registry);
   initializeMVEGatherScatterLoweringPass(Registry);
+  initializeARMRandezvousLeakabilityPass(Registry);
 }
 
 static std::unique_ptr<TargetLoweringObjectFile> createTLOF(const Triple &TT) {
@@ -193,6 +203,17 @@ static std::string computeDataLayout(const Triple &TT, StringRef CPU,
   return Ret;
 }
 
+// GlobalISel handles Thumb2 but not Thumb1, so only M-profile architectures
+// with Thumb2 (v7-M and v8-M Mainline and later) can use it.
+static bool isThumb2MClass(const Triple &TT) {
+  if (!TT.isThumb())
+    return false;
+  StringRef ArchName = TT.getArchName();
+  ARM::ArchKind AK = ARM::parseArch(ArchName);
+  return ARM::parseArchProfile(ArchName) == ARM::ProfileKind::M &&
+         AK != ARM::ArchKind::ARMV6M && AK != ARM::ArchKind::ARMV8MBaseline;
+}
+
 static Reloc::Model getEffectiveRelocModel(const Triple &TT,
                                            Optional<Reloc::Model> RM) {
   if (!RM.hasValue())
@@ -254,6 +275,13 @@ ARMBaseTargetMachine::ARMBaseTargetMachine(const Target &T, const Triple &TT,
   // ARM supports the debug entry values.
   setSupportsDebugEntryValues(true);
 
+  // Enable GlobalISel at or below EnableGlobalISelAtO for Thumb2 M-profile
+  // targets, falling back to SelectionDAG for functions it cannot handle.
+  if (getOptLevel() <= EnableGlobalISelAtO && isThumb2MClass(TT)) {
+    setGlobalISel(true);
+    setGlobalISelAbort(GlobalISelAbortMode::Disable);
+  }
+
   initAsmInfo();
 
   // ARM supports the MachineOutliner.
@@ -438,6 +466,7 @@ void ARMPassConfig::addIRPasses() {
     addPass(createCFGuardCheckPass());
 
   // Add Randezvous IR passes
+  addPass(createARMRandezvousICallPromote());
   addPass(createARMRandezvousLGPromote());
   addPass(createARMRandezvousPicoXOM());
 }
@@ -515,6 +544,7 @@ void ARMPassConfig::addPreRegAlloc() {
   }
 
   // Add Randezvous PreRegAlloc passes
+  addPass(createARMRandezvousSSSelector());
   addPass(createARMRandezvousICallLimiter());
 }
 
@@ -525,6 +555,7 @@ void ARMPassConfig::addPreSched2() {
 
     addPass(new ARMExecutionDomainFix());
     addPass(createBreakFalseDeps());
+    addPass(createARMRandezvousXOMCSE());
   }
 
   // Expand some pseudo instructions into multiple instructions to allow
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2021-2022, University of Rochester
+#
+# Part of the Randezvous Project, under the Apache License v2.0 with
+# LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+# information.
+#
+# This is a compile-time benchmark of the ARM constant island pass on large
+# Thumb2 functions.  It generates state machines with many large blocks that
+# load their constants from literal pools, compiles them with llc with and
+# without cached offsets in the constant island pass (optionally with CLR
+# filling the text section with trap instructions), and reports the time
+# spent in the pass.  It also checks that both builds produce the same code.
+
+import argparse
+import os
+import random
+import re
+import subprocess
+import sys
+import tempfile
+
+PASS_NAME = 'ARM constant island placement and branch shortening pass'
+
+def run(cmd):
+  result = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                          universal_newlines=True)
+  if result.returncode != 0:
+    sys.exit('error: {} failed:\n{}'.format(' '.join(cmd), result.stderr))
+  return result
+
+# Generate a function that dispatches on a state to one of many blocks, each
+# of which does a chain of arithmetic with constants that do not fit in an
+# immediate field
+def generate_function(name, states, ops, rng):
+  lines = ['define void @{}(i32* %io, i32 %n) {{'.format(name),
+           'entry:',
+           '  br label %loop',
+           'loop:',
+           '  %i = phi i32 [ 0, %entry ], [ %next, %latch ]',
+           '  %p = getelementptr i32, i32* %io, i32 %i',
+           '  %s = load volatile i32, i32* %p',
+           '  switch i32 %s, label %latch [']
+  lines += ['    i32 {0}, label %state{0}'.format(s) for s in range(states)]
+  lines.append('  ]')
+  for s in range(states):
+    lines.append('state{}:'.format(s))
+    lines.append('  %v{}.0 = load volatile i32, i32* %io'.format(s))
+    for k in range(ops):
+      op = ('xor', 'add', 'mul')[k % 3]
+      lines.append('  %v{0}.{1} = {2} i32 %v{0}.{3}, {4}'.format(
+        s, k + 1, op, k, rng.randrange(1 << 16, 1 << 31)))
+    lines.append('  store volatile i32 %v{}.{}, i32* %io'.format(s, ops))
+    lines.append('  br label %latch')
+  lines += ['latch:',
+            '  %next = add i32 %i, 1',
+            '  %c = icmp ult i32 %next, %n',
+            '  br i1 %c, label %loop, label %exit',
+            'exit:',
+            '  ret void',
+            '}',
+            '']
+  return '\n'.join(lines)
+
+def pass_time(stderr):
+  # -time-passes prints the wall time as the last column before the name
+  for line in stderr.splitlines():
+    if line.rstrip().endswith(PASS_NAME):
+      times = re.findall(r'([0-9.]+) \(\s*[0-9.]+%\)', line)
+      if times:
+        return float(times[-1]) * 1000.0
+  return 0.0
+
+def main():
+  parser = argparse.ArgumentParser(
+    description='Measure the ARM constant island pass on large functions.')
+  parser.add_argument('--llc', default='llc', help='path to llc')
+  parser.add_argument('--cpu', default='cortex-m4',
+                      help='target CPU (default: cortex-m4)')
+  parser.add_argument('--functions', type=int, default=4,
+                      help='number of functions (default: 4)')
+  parser.add_argument('--states', type=int, default=400,
+                      help='number of states per function (default: 400)')
+  parser.add_argument('--ops', type=int, default=12,
+                      help='number of operations per state (default: 12)')
+  parser.add_argument('--clr', action='store_true',
+                      help='fill the text section with CLR trap instructions')
+  parser.add_argument('--max-text-size', type=int, default=0x100000,
+                      help='text size that CLR fills up to')
+  parser.add_argument('--repeat', type=int, default=3,
+                      help='number of llc runs per configuration (default: 3)')
+  parser.add_argument('--seed', type=int, default=1,
+                      help='seed for the generated constants (default: 1)')
+  args = parser.parse_args()
+
+  rng = random.Random(args.seed)
+  with tempfile.TemporaryDirectory() as out_dir:
+    ir = os.path.join(out_dir, 'machines.ll')
+    with open(ir, 'w') as f:
+      for i in range(args.functions):
+        f.write(generate_function('machine{}'.format(i), args.states,
+                                  args.ops, rng))
+
+    # Without MOVW/MOVT, every constant comes from a literal pool
+    llc = [args.llc, '-mtriple=thumbv7em-none-eabi', '-mcpu=' + args.cpu,
+           '-mattr=+no-movt', '-O2', '-time-passes']
+    if args.clr:
+      llc += ['-arm-randezvous-clr', '-arm-randezvous-clr-seed=1',
+              '-arm-randezvous-max-text-size=' + str(args.max_text_size)]
+
+    results = {}
+    outputs = {}
+    for cache in ('false', 'true'):
+      asm = os.path.join(out_dir, 'machines.' + cache + '.s')
+      best = None
+      for _ in range(args.repeat):
+        result = run(llc + ['-arm-constant-island-cache-offsets=' + cache,
+                            ir, '-o', asm])
+        elapsed = pass_time(result.stderr)
+        best = elapsed if best is None else min(best, elapsed)
+      results[cache] = best
+      with open(asm) as f:
+        outputs[cache] = f.read()
+
+  print('constant island pass without cached offsets: {:.1f} ms'.format(
+    results['false']))
+  print('constant island pass with cached offsets:    {:.1f} ms'.format(
+    results['true']))
+  if results['true']:
+    print('speedup: {:.2f}x'.format(results['false'] / results['true']))
+  if outputs['false'] != outputs['true']:
+    print('error: cached offsets changed the generated code', file=sys.stderr)
+    return 1
+  return 0
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2021-2022, University of Rochester
+#
+# Part of the Randezvous Project, under the Apache License v2.0 with
+# LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+# information.
+#
+# This is a compile-time benchmark of instruction selection for Thumb2
+# M-profile targets.  It compiles a corpus of C or LLVM IR files with llc once
+# with FastISel and once with GlobalISel (falling back to SelectionDAG for
+# functions that GlobalISel cannot handle), and reports the compile time, the
+# object size, and the number of functions that fell back for each file.
+#
+# Compile times are the fastest of several runs of llc, so that they are not
+# skewed by a busy host.  Directories given on the command line are searched
+# for .c and .ll files recursively, so that a whole firmware tree can be used
+# as the corpus.
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+def run(cmd):
+  result = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                          universal_newlines=True)
+  if result.returncode != 0:
+    sys.exit('error: {} failed:\n{}'.format(' '.join(cmd), result.stderr))
+  return result
+
+def find_tool(args, name):
+  path = getattr(args, name.replace('-', '_'))
+  if path:
+    return path
+  if args.bin_dir:
+    return os.path.join(args.bin_dir, name)
+  return name
+
+def find_sources(paths):
+  sources = []
+  for path in paths:
+    if not os.path.isdir(path):
+      sources.append(path)
+      continue
+    for root, _, files in os.walk(path):
+      sources += [os.path.join(root, f) for f in files
+                  if f.endswith('.c') or f.endswith('.ll')]
+  return sorted(sources)
+
+def compile_to_ir(args, source, out_dir):
+  if source.endswith('.ll'):
+    return source
+  ir = os.path.join(out_dir, os.path.basename(source) + '.ll')
+  cmd = [find_tool(args, 'clang'), '--target=' + args.triple,
+         '-mcpu=' + args.cpu, '-mthumb', '-O' + args.opt, '-ffreestanding',
+         '-S', '-emit-llvm', source, '-o', ir]
+  if args.debug_info:
+    cmd.append('-g')
+  run(cmd)
+  return ir
+
+def measure(args, ir, isel, out_dir):
+  obj = os.path.join(out_dir, os.path.basename(ir) + '.' + isel + '.o')
+  llc = [find_tool(args, 'llc'), '-mtriple=' + args.triple,
+         '-mcpu=' + args.cpu, '-O' + args.llc_opt, '-filetype=obj']
+  if isel == 'fast-isel':
+    llc += ['-fast-isel']
+  else:
+    llc += ['-global-isel', '-global-isel-abort=2']
+  llc += [ir, '-o', obj]
+
+  best = None
+  for _ in range(args.repeat):
+    start = time.perf_counter()
+    result = run(llc)
+    elapsed = time.perf_counter() - start
+    best = elapsed if best is None else min(best, elapsed)
+
+  # With -global-isel-abort=2, llc warns once for each function that falls
+  # back to SelectionDAG
+  fallbacks = result.stderr.count('fallback path')
+  return {
+    'time-ms': best * 1000.0,
+    'size': os.path.getsize(obj),
+    'fallbacks': fallbacks,
+  }
+
+def main():
+  parser = argparse.ArgumentParser(
+    description='Compare the compile time of GlobalISel and FastISel.')
+  parser.add_argument('sources', nargs='*',
+                      help='C or LLVM IR files, or directories containing '
+                           'them (default: the bundled corpus)')
+  parser.add_argument('--bin-dir', help='directory containing LLVM tools')
+  parser.add_argument('--clang', help='path to clang')
+  parser.add_argument('--llc', help='path to llc')
+  parser.add_argument('--triple', default='thumbv7em-none-eabi',
+                      help='target triple (default: thumbv7em-none-eabi)')
+  parser.add_argument('--cpu', default='cortex-m4',
+                      help='target CPU (default: cortex-m4)')
+  parser.add_argument('--opt', default='0',
+                      help='clang optimization level (default: 0)')
+  parser.add_argument('--llc-opt', default='0',
+                      help='llc optimization level (default: 0)')
+  parser.add_argument('-g', '--debug-info', action='store_true',
+                      help='compile with debug information')
+  parser.add_argument('--repeat', type=int, default=5,
+                      help='number of llc runs per file (default: 5)')
+  parser.add_argument('--json', help='file to which to write the results')
+  args = parser.parse_args()
+
+  paths = args.sources
+  if not paths:
+    paths = [os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                          'kernels')]
+  sources = find_sources(paths)
+
+  results = {}
+  total = {'fast-isel': 0.0, 'global-isel': 0.0}
+  with tempfile.TemporaryDirectory() as out_dir:
+    for source in sources:
+      ir = compile_to_ir(args, source, out_dir)
+      name = os.path.relpath(source)
+      results[name] = {}
+      for isel in ('fast-isel', 'global-isel'):
+        results[name][isel] = measure(args, ir, isel, out_dir)
+        total[isel] += results[name][isel]['time-ms']
+
+  print('{:<32} {:>10} {:>10} {:>8} {:>8} {:>8} {:>9}'.format(
+    'file', 'fast-ms', 'gisel-ms', 'ratio', 'fast-sz', 'gisel-sz',
+    'fallbacks'))
+  for name, by_isel in results.items():
+    fast = by_isel['fast-isel']
+    gisel = by_isel['global-isel']
+    ratio = gisel['time-ms'] / fast['time-ms'] if fast['time-ms'] else 0.0
+    print('{:<32} {:>10.1f} {:>10.1f} {:>7.2f}x {:>8} {:>8} {:>9}'.format(
+      name[-32:], fast['time-ms'], gisel['time-ms'], ratio, fast['size'],
+      gisel['size'], gisel['fallbacks']))
+  if total['fast-isel']:
+    print('total: fast-isel {:.1f} ms, global-isel {:.1f} ms ({:.2f}x)'.format(
+      total['fast-isel'], total['global-isel'],
+      total['global-isel'] / total['fast-isel']))
+
+  if args.json:
+    with open(args.json, 'w') as f:
+      json.dump(results, f, indent=2, sort_keys=True)
+  return 0
+
+if __name__ == '__main__':
+  sys.exit(main())
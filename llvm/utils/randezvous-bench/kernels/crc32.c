@@ -0,0 +1,30 @@
+//===- crc32.c - Table-driven CRC-32 kernel -------------------------------===//
+//
+// Part of the Randezvous Project, under the Apache License v2.0 with
+// LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+// information.
+//
+//===----------------------------------------------------------------------===//
+
+#include <stddef.h>
+#include <stdint.h>
+
+static uint32_t Table[256];
+
+void crc32_init(void) {
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; ++k) {
+      c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+    }
+    Table[i] = c;
+  }
+}
+
+uint32_t crc32(const uint8_t * buf, size_t len) {
+  uint32_t c = 0xffffffffu;
+  for (size_t i = 0; i < len; ++i) {
+    c = Table[(c ^ buf[i]) & 0xff] ^ (c >> 8);
+  }
+  return c ^ 0xffffffffu;
+}
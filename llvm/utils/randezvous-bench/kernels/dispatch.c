@@ -0,0 +1,28 @@
+//===- dispatch.c - Event dispatch kernel with function pointers ----------===//
+//
+// Part of the Randezvous Project, under the Apache License v2.0 with
+// LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+// information.
+//
+//===----------------------------------------------------------------------===//
+
+#include <stdint.h>
+
+typedef int32_t (*handler_t)(int32_t state, int32_t arg);
+
+static int32_t on_reset(int32_t state, int32_t arg) { return 0; }
+static int32_t on_add(int32_t state, int32_t arg) { return state + arg; }
+static int32_t on_scale(int32_t state, int32_t arg) { return state * arg; }
+static int32_t on_clamp(int32_t state, int32_t arg) {
+  return state > arg ? arg : state;
+}
+
+static handler_t Handlers[] = { on_reset, on_add, on_scale, on_clamp };
+
+int32_t dispatch(const uint8_t * events, const int32_t * args, unsigned len) {
+  int32_t state = 0;
+  for (unsigned i = 0; i < len; ++i) {
+    state = Handlers[events[i] & 3](state, args[i]);
+  }
+  return state;
+}
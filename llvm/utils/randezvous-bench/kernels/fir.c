@@ -0,0 +1,34 @@
+//===- fir.c - Fixed-point FIR filter kernel ------------------------------===//
+//
+// Part of the Randezvous Project, under the Apache License v2.0 with
+// LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+// information.
+//
+//===----------------------------------------------------------------------===//
+
+#include <stdint.h>
+
+#define NUM_TAPS 32
+
+static const int16_t Coeffs[NUM_TAPS] = {
+  -12, -25, -31, -18, 19, 77, 133, 150, 93, -46, -241, -415, -468, -302,
+  141, 840, 1680, 2480, 3050, 3260, 3050, 2480, 1680, 840, 141, -302, -468,
+  -415, -241, -46, 93, 150,
+};
+
+static int16_t History[NUM_TAPS];
+
+void fir(const int16_t * in, int16_t * out, unsigned len) {
+  for (unsigned n = 0; n < len; ++n) {
+    for (unsigned k = NUM_TAPS - 1; k > 0; --k) {
+      History[k] = History[k - 1];
+    }
+    History[0] = in[n];
+
+    int32_t acc = 0;
+    for (unsigned k = 0; k < NUM_TAPS; ++k) {
+      acc += (int32_t)History[k] * Coeffs[k];
+    }
+    out[n] = (int16_t)(acc >> 15);
+  }
+}
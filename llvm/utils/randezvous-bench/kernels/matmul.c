@@ -0,0 +1,23 @@
+//===- matmul.c - Integer matrix multiplication kernel --------------------===//
+//
+// Part of the Randezvous Project, under the Apache License v2.0 with
+// LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+// information.
+//
+//===----------------------------------------------------------------------===//
+
+#include <stdint.h>
+
+#define N 16
+
+void matmul(const int32_t A[N][N], const int32_t B[N][N], int32_t C[N][N]) {
+  for (int i = 0; i < N; ++i) {
+    for (int j = 0; j < N; ++j) {
+      int32_t sum = 0;
+      for (int k = 0; k < N; ++k) {
+        sum += A[i][k] * B[k][j];
+      }
+      C[i][j] = sum;
+    }
+  }
+}
@@ -0,0 +1,40 @@
+//===- qsort.c - Recursive quicksort kernel -------------------------------===//
+//
+// Part of the Randezvous Project, under the Apache License v2.0 with
+// LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+// information.
+//
+//===----------------------------------------------------------------------===//
+
+#include <stdint.h>
+
+static void swap(int32_t * a, int32_t * b) {
+  int32_t t = *a;
+  *a = *b;
+  *b = t;
+}
+
+static int partition(int32_t * v, int lo, int hi) {
+  int32_t pivot = v[hi];
+  int i = lo;
+  for (int j = lo; j < hi; ++j) {
+    if (v[j] < pivot) {
+      swap(&v[i++], &v[j]);
+    }
+  }
+  swap(&v[i], &v[hi]);
+  return i;
+}
+
+void quicksort(int32_t * v, int lo, int hi) {
+  while (lo < hi) {
+    int p = partition(v, lo, hi);
+    if (p - lo < hi - p) {
+      quicksort(v, lo, p - 1);
+      lo = p + 1;
+    } else {
+      quicksort(v, p + 1, hi);
+      hi = p - 1;
+    }
+  }
+}
@@ -0,0 +1,246 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2021-2022, University of Rochester
+#
+# Part of the Randezvous Project, under the Apache License v2.0 with
+# LLVM Exceptions.  See LICENSE.txt in the llvm directory for license
+# information.
+#
+# This is a static benchmark harness for Randezvous.  It compiles a corpus of
+# embedded kernels under each Randezvous configuration, estimates the cycles
+# of each function with llvm-mca using the Cortex-M4 scheduling model, and
+# reports the code size and cycle overhead of each configuration relative to
+# a build without Randezvous.  It needs no board, so it can run on any host
+# as a regression check for Randezvous passes.
+#
+# Cycle estimates are per function: llvm-mca runs once over the instructions
+# of each function in layout order (i.e., as if every block is on the path),
+# with trap instructions removed as they never execute.  Code sizes are the
+# sizes of function symbols minus the trap instructions that CLR inserts,
+# which are reported separately.
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+TRIPLE = 'thumbv7em-none-eabi'
+CPU = 'cortex-m4'
+
+# Randezvous configurations and the llc options that enable them
+CONFIGS = [
+  ('baseline', []),
+  ('clr', ['-arm-randezvous-clr']),
+  ('bblr', ['-arm-randezvous-clr', '-arm-randezvous-bblr']),
+  ('bbclr', ['-arm-randezvous-clr', '-arm-randezvous-bbclr']),
+  ('gdlr', ['-arm-randezvous-gdlr']),
+  ('shadow-stack', ['-arm-randezvous-shadow-stack']),
+  ('ran', ['-arm-randezvous-ran']),
+  ('picoxom', ['-arm-randezvous-picoxom']),
+  ('icall-limiter', ['-arm-randezvous-icall-limiter']),
+]
+
+# Fixed seeds so that every run produces the same code
+SEEDS = [
+  '-arm-randezvous-clr-seed=1',
+  '-arm-randezvous-gdlr-seed=1',
+  '-arm-randezvous-shadow-stack-seed=1',
+]
+
+def run(cmd):
+  result = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                          universal_newlines=True)
+  if result.returncode != 0:
+    sys.exit('error: {} failed:\n{}'.format(' '.join(cmd), result.stderr))
+  return result.stdout
+
+def find_tool(args, name):
+  path = getattr(args, name.replace('-', '_'))
+  if path:
+    return path
+  if args.bin_dir:
+    return os.path.join(args.bin_dir, name)
+  return name
+
+def compile_to_ir(args, kernel, out_dir):
+  ir = os.path.join(out_dir, os.path.basename(kernel) + '.ll')
+  run([find_tool(args, 'clang'), '--target=' + TRIPLE, '-mcpu=' + CPU,
+       '-mthumb', '-O2', '-ffreestanding', '-fno-builtin', '-S',
+       '-emit-llvm', kernel, '-o', ir])
+  return ir
+
+# Split assembly into the bodies of each function
+def split_functions(asm):
+  functions = {}
+  name = None
+  body = []
+  for line in asm.splitlines():
+    match = re.match(r'\s*\.type\s+([^,]+),\s*%function', line)
+    if match:
+      name = match.group(1)
+      body = []
+      continue
+    if name is None:
+      continue
+    if re.match(r'\s*\.size\s+' + re.escape(name) + r'\s*,', line):
+      functions[name] = body
+      name = None
+      continue
+    body.append(line)
+  return functions
+
+def estimate_cycles(args, body, out_dir):
+  # Keep instructions and labels only; trap instructions never execute
+  lines = []
+  for line in body:
+    stripped = line.split('@')[0].strip()
+    if not stripped or stripped.startswith('.'):
+      continue
+    if re.match(r'udf(\.w)?\b', stripped):
+      continue
+    lines.append(stripped)
+  if not lines:
+    return 0
+
+  path = os.path.join(out_dir, 'mca.s')
+  with open(path, 'w') as f:
+    f.write('\t.syntax unified\n\t.thumb\n')
+    f.write('\n'.join(lines) + '\n')
+  output = run([find_tool(args, 'llvm-mca'), '-mtriple=' + TRIPLE,
+                '-mcpu=' + CPU, '-iterations=1', path])
+  match = re.search(r'Total Cycles:\s+(\d+)', output)
+  return int(match.group(1)) if match else 0
+
+def function_sizes(args, obj):
+  sizes = {}
+  output = run([find_tool(args, 'llvm-nm'), '--print-size', '--defined-only',
+                obj])
+  for line in output.splitlines():
+    fields = line.split()
+    if len(fields) == 4 and fields[2] in ('t', 'T'):
+      sizes[fields[3]] = int(fields[1], 16)
+  return sizes
+
+def trap_bytes(report):
+  total = 0
+  if not os.path.exists(report):
+    return total
+  with open(report) as f:
+    for line in f:
+      record = json.loads(line)
+      if (record.get('kind') == 'section' and record.get('section') == 'text'
+          and record.get('filler') == 'trap'):
+        total += record.get('filler-bytes', 0)
+  return total
+
+def measure(args, ir, config, options, out_dir):
+  base = os.path.join(out_dir, os.path.basename(ir) + '.' + config)
+  report = base + '.jsonl'
+  if os.path.exists(report):
+    os.remove(report)
+  llc = [find_tool(args, 'llc'), '-mtriple=' + TRIPLE, '-mcpu=' + CPU, '-O2',
+         '-arm-randezvous-max-text-size=' + str(args.max_text_size),
+         '-arm-randezvous-report-jsonl=' + report] + SEEDS + options
+  run(llc + [ir, '-o', base + '.s'])
+  run([find_tool(args, 'llvm-mc'), '-triple=' + TRIPLE, '-mcpu=' + CPU,
+       '-filetype=obj', base + '.s', '-o', base + '.o'])
+
+  with open(base + '.s') as f:
+    functions = split_functions(f.read())
+  sizes = function_sizes(args, base + '.o')
+  traps = trap_bytes(report)
+
+  cycles = 0
+  for name in sorted(functions):
+    cycles += estimate_cycles(args, functions[name], out_dir)
+  return {
+    'size': sum(sizes.values()) - traps,
+    'trap-bytes': traps,
+    'cycles': cycles,
+  }
+
+def overhead(value, base):
+  if base == 0:
+    return 0.0
+  return (value - base) * 100.0 / base
+
+def main():
+  parser = argparse.ArgumentParser(
+    description='Estimate the static overhead of Randezvous configurations.')
+  parser.add_argument('kernels', nargs='*',
+                      help='C files to compile (default: the bundled corpus)')
+  parser.add_argument('--bin-dir', help='directory containing LLVM tools')
+  parser.add_argument('--clang', help='path to clang')
+  parser.add_argument('--llc', help='path to llc')
+  parser.add_argument('--llvm-mc', help='path to llvm-mc')
+  parser.add_argument('--llvm-mca', help='path to llvm-mca')
+  parser.add_argument('--llvm-nm', help='path to llvm-nm')
+  parser.add_argument('--configs', default=','.join(c for c, _ in CONFIGS),
+                      help='comma-separated configurations to measure')
+  parser.add_argument('--max-text-size', type=int, default=0x10000,
+                      help='text size that CLR fills up to')
+  parser.add_argument('--json', help='file to which to write the results')
+  parser.add_argument('--baseline',
+                      help='results of an earlier run to compare against')
+  parser.add_argument('--threshold', type=float, default=1.0,
+                      help='overhead increase (in percentage points) over '
+                           'the earlier run that counts as a regression')
+  args = parser.parse_args()
+
+  kernels = args.kernels
+  if not kernels:
+    corpus = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                          'kernels')
+    kernels = sorted(os.path.join(corpus, k) for k in os.listdir(corpus)
+                     if k.endswith('.c'))
+  configs = [c for c in CONFIGS if c[0] in args.configs.split(',')]
+  if configs[0][0] != 'baseline':
+    configs.insert(0, CONFIGS[0])
+
+  results = {}
+  with tempfile.TemporaryDirectory() as out_dir:
+    for kernel in kernels:
+      ir = compile_to_ir(args, kernel, out_dir)
+      name = os.path.basename(kernel)
+      results[name] = {}
+      for config, options in configs:
+        results[name][config] = measure(args, ir, config, options, out_dir)
+
+  print('{:<16} {:<14} {:>8} {:>9} {:>8} {:>9} {:>8}'.format(
+    'kernel', 'config', 'size', 'size+%', 'cycles', 'cycles+%', 'traps'))
+  for name, by_config in results.items():
+    base = by_config['baseline']
+    for config, result in by_config.items():
+      result['size-overhead'] = overhead(result['size'], base['size'])
+      result['cycle-overhead'] = overhead(result['cycles'], base['cycles'])
+      print('{:<16} {:<14} {:>8} {:>8.1f}% {:>8} {:>8.1f}% {:>8}'.format(
+        name, config, result['size'], result['size-overhead'],
+        result['cycles'], result['cycle-overhead'], result['trap-bytes']))
+
+  if args.json:
+    with open(args.json, 'w') as f:
+      json.dump(results, f, indent=2, sort_keys=True)
+
+  # Compare the overheads against an earlier run
+  regressions = []
+  if args.baseline:
+    with open(args.baseline) as f:
+      earlier = json.load(f)
+    for name, by_config in results.items():
+      for config, result in by_config.items():
+        old = earlier.get(name, {}).get(config)
+        if old is None:
+          continue
+        for key in ('size-overhead', 'cycle-overhead'):
+          if result[key] - old[key] > args.threshold:
+            regressions.append('{} {}: {} {:.1f}% -> {:.1f}%'.format(
+              name, config, key, old[key], result[key]))
+  for regression in regressions:
+    print('regression: ' + regression, file=sys.stderr)
+  return 1 if regressions else 0
+
+if __name__ == '__main__':
+  sys.exit(main())